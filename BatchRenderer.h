@@ -0,0 +1,342 @@
+#ifndef BatchRenderer_h
+#define BatchRenderer_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "GeometryAllocator.h"
+#include "GpuResource.h"
+#include "Hash.h"
+#include "Mesh.h"
+#include "Shader.h"
+
+// standard library
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// MARK: - GL 4.3
+// ------------------
+// glad is generated for 3.3 core, the indirect path loads what it needs itself
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+typedef void (*PFNBATCHMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// MARK: - Structure
+// ------------------
+// per-instance draw index of the indirect path, location matches BatchVertexShader.glsl
+#define BATCH_DRAW_ID_LOCATION 14
+// shader storage binding of the DrawRecord array, matches BatchVertexShader.glsl
+#define BATCH_DRAW_RECORD_BINDING 0
+
+// layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;                  // in indices from the start of the arena's index buffer
+    GLint baseVertex;
+    GLuint baseInstance;                // the DrawRecord, read back as the draw id
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand is read by the GPU");
+
+// per-draw data of one mesh placement, std430 in BatchVertexShader.glsl
+struct DrawRecord {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];          // columns of the mat3, padded to vec4 by std430
+    glm::vec4 positionOffset;           // dequantization of packed positions, w = 1 for packed vertices
+    glm::vec4 positionScale;
+    uint32_t materialIndex;             // the bucket (material) the record is drawn in
+    uint32_t padding[3];
+};
+static_assert(sizeof(DrawRecord) == 160, "DrawRecord must match the std430 layout of BatchVertexShader.glsl");
+
+// what the last flush submitted
+struct BatchStatistics {
+    bool indirect = false;
+    size_t records = 0;
+    size_t draws = 0;                   // indirect commands (index ranges)
+    size_t buckets = 0;
+    size_t drawCalls = 0;               // GL draw calls issued
+    double submitMs = 0.0;              // CPU time of the flush: uploads and draw calls
+};
+
+// MARK: - Class
+// ------------------
+// collects the visible mesh draws of a frame and submits them per vertex format, index type and material:
+// GL 4.3 draws every bucket with one glMultiDrawElementsIndirect and reads the per-draw data from a shader storage buffer,
+// older contexts (3.3, macOS 4.1) fall back to one glMultiDrawElementsBaseVertex per record with uniforms
+// GL thread only
+class BatchRenderer {
+public:
+    // Functions
+    // ----------
+    static BatchRenderer& shared();
+
+    // load is the loader glad was given; picks the indirect path when the context is 4.3 or newer
+    bool initialize(GLADloadproc load);
+    bool isIndirect() const { return indirect; }
+
+    // starts collecting the draws of a frame
+    void begin();
+    // one placement of mesh, returns the record its draws reference
+    unsigned int addRecord(const Mesh &mesh, const glm::mat4 &world, const glm::mat3 &normalMatrix);
+    // indexCount indices from firstIndex (counted from the mesh's first index) with the record's transform
+    void addDraw(const Mesh &mesh, unsigned int record, unsigned int firstIndex, unsigned int indexCount);
+    // uploads and draws every bucket with the shader in use: BatchVertexShader.glsl on the indirect path,
+    // VertexShader.glsl on the fallback
+    void flush(Shader &shader);
+
+    const BatchStatistics& getStatistics() const { return statistics; }
+    void printStatistics() const;
+
+private:
+    // Structure
+    // ----------
+    struct Bucket {
+        const Mesh *material;           // first mesh drawn in it, binds the material of the bucket
+        GLenum indexType;
+        vector<DrawElementsIndirectCommand> commands;
+    };
+
+    // Properties
+    // ----------
+    bool indirect = false;
+    PFNBATCHMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+    vector<DrawRecord> records;
+    vector<Bucket> buckets;             // the first bucketCount are in use, the rest keep their memory
+    size_t bucketCount = 0;
+    unordered_multimap<uint64_t, size_t> bucketLookup;     // material hash -> bucket
+    GpuBuffer recordBuffer;
+    GpuBuffer commandBuffer;
+    GpuBuffer drawIDBuffer;             // 0, 1, 2, ... read per instance from baseInstance
+    size_t drawIDCapacity = 0;
+    vector<DrawElementsIndirectCommand> commandStaging;
+    vector<GLsizei> drawCounts;         // fallback multi-draw scratch
+    vector<const void*> drawOffsets;
+    vector<GLint> drawBaseVertices;
+    BatchStatistics statistics;
+
+    BatchRenderer() {}
+    size_t bucketFor(const Mesh &mesh);
+    static uint64_t materialHash(const Mesh &mesh);
+    static bool sameMaterial(const Mesh &a, const Mesh &b);
+    void reserveDrawIDs(size_t count);
+    void flushIndirect(Shader &shader);
+    void flushFallback(Shader &shader);
+};
+
+// MARK: - Function realization
+// --------------------
+BatchRenderer& BatchRenderer::shared(){
+    static BatchRenderer batchRenderer;
+    return batchRenderer;
+}
+
+bool BatchRenderer::initialize(GLADloadproc load){
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    multiDrawElementsIndirect = nullptr;
+    if(major > 4 || (major == 4 && minor >= 3))
+        multiDrawElementsIndirect = (PFNBATCHMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    indirect = multiDrawElementsIndirect != nullptr;
+    if(!indirect)
+        cout << "WARNING::BATCH::NO_MULTI_DRAW_INDIRECT::GL " << major << "." << minor << ", drawing per record" << endl;
+    return indirect;
+}
+
+void BatchRenderer::begin(){
+    records.clear();
+    for(size_t i = 0; i < bucketCount; i++)
+        buckets[i].commands.clear();
+    bucketCount = 0;
+    bucketLookup.clear();
+}
+
+uint64_t BatchRenderer::materialHash(const Mesh &mesh){
+    // FNV-1a over what selects the VAO, the index type and the material (shared, so compared by address)
+    uint64_t key[3] = { (uint64_t)(uintptr_t)mesh.layout, mesh.indexType, (uint64_t)(uintptr_t)mesh.material.get() };
+    return hashBytes(key, sizeof(key));
+}
+
+bool BatchRenderer::sameMaterial(const Mesh &a, const Mesh &b){
+    return a.layout == b.layout && a.indexType == b.indexType && a.material == b.material;
+}
+
+size_t BatchRenderer::bucketFor(const Mesh &mesh){
+    uint64_t hash = materialHash(mesh);
+    auto range = bucketLookup.equal_range(hash);
+    for(auto found = range.first; found != range.second; ++found)
+        if(sameMaterial(*buckets[found->second].material, mesh))
+            return found->second;
+
+    if(bucketCount == buckets.size())
+        buckets.push_back(Bucket());
+    Bucket &bucket = buckets[bucketCount];
+    bucket.material = &mesh;
+    bucket.indexType = mesh.indexType;
+    bucketLookup.emplace(hash, bucketCount);
+    return bucketCount++;
+}
+
+unsigned int BatchRenderer::addRecord(const Mesh &mesh, const glm::mat4 &world, const glm::mat3 &normalMatrix){
+    DrawRecord record;
+    record.model = world;
+    for(int column = 0; column < 3; column++)
+        record.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+    record.positionOffset = glm::vec4(mesh.getPositionOffset(), mesh.layout->packed ? 1.0f : 0.0f);
+    record.positionScale = glm::vec4(mesh.getPositionScale(), 0.0f);
+    record.materialIndex = 0;
+    record.padding[0] = record.padding[1] = record.padding[2] = 0;
+    records.push_back(record);
+    return (unsigned int)records.size() - 1;
+}
+
+void BatchRenderer::addDraw(const Mesh &mesh, unsigned int record, unsigned int firstIndex, unsigned int indexCount){
+    if(indexCount == 0 || record >= records.size() || !mesh.isResident())
+        return;
+    size_t bucket = bucketFor(mesh);
+    records[record].materialIndex = (uint32_t)bucket;
+
+    DrawElementsIndirectCommand command;
+    command.count = indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = (GLuint)(mesh.geometry->indexOffset / indexTypeSize(mesh.indexType)) + firstIndex;
+    command.baseVertex = (GLint)mesh.geometry->baseVertex;
+    command.baseInstance = record;
+    buckets[bucket].commands.push_back(command);
+}
+
+void BatchRenderer::reserveDrawIDs(size_t count){
+    if(count <= drawIDCapacity)
+        return;
+    // the contents never change, so the buffer is only respecified (same name, the VAOs keep it) when it grows
+    drawIDCapacity = max(count, drawIDCapacity * 2);
+    vector<GLuint> ids(drawIDCapacity);
+    for(size_t i = 0; i < ids.size(); i++)
+        ids[i] = (GLuint)i;
+    if(!drawIDBuffer)
+        drawIDBuffer = GpuBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer.get());
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BatchRenderer::flush(Shader &shader){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    statistics = BatchStatistics();
+    statistics.indirect = indirect;
+    statistics.records = records.size();
+    statistics.buckets = bucketCount;
+    for(size_t i = 0; i < bucketCount; i++)
+        statistics.draws += buckets[i].commands.size();
+
+    if(statistics.draws > 0){
+        GeometryAllocator::instance().invalidateBinding();
+        if(indirect)
+            flushIndirect(shader);
+        else
+            flushFallback(shader);
+        glBindVertexArray(0);
+        GeometryAllocator::instance().invalidateBinding();
+        glActiveTexture(GL_TEXTURE0);
+    }
+    statistics.submitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void BatchRenderer::flushIndirect(Shader &shader){
+    // 1. every bucket's commands back to back in one indirect buffer, the records in one storage buffer
+    commandStaging.clear();
+    for(size_t i = 0; i < bucketCount; i++)
+        commandStaging.insert(commandStaging.end(), buckets[i].commands.begin(), buckets[i].commands.end());
+    if(!commandBuffer){
+        commandBuffer = GpuBuffer::create();
+        recordBuffer = GpuBuffer::create();
+    }
+    // new storage every frame (orphaning) like the InstanceBuffer, the previous frame may still be reading
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.get());
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commandStaging.size() * sizeof(DrawElementsIndirectCommand), commandStaging.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer.get());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(DrawRecord), records.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_RECORD_BINDING, recordBuffer.get());
+    reserveDrawIDs(records.size());
+
+    // 2. one multi-draw per bucket, the draw id comes from baseInstance through the per-instance attribute
+    size_t offset = 0;
+    for(size_t i = 0; i < bucketCount; i++){
+        Bucket &bucket = buckets[i];
+        if(bucket.commands.empty())
+            continue;
+        const Mesh &material = *bucket.material;
+        GeometryAllocator::instance().attachDrawIDBuffer(*material.layout, drawIDBuffer.get(), BATCH_DRAW_ID_LOCATION);
+        material.bindMaterial(shader);
+        multiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType, (const void*)(offset * sizeof(DrawElementsIndirectCommand)),
+                                  (GLsizei)bucket.commands.size(), 0);
+        offset += bucket.commands.size();
+        statistics.drawCalls++;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void BatchRenderer::flushFallback(Shader &shader){
+    // the same buckets, the uniforms change per record and the ranges of one record share a multi-draw
+    for(size_t i = 0; i < bucketCount; i++){
+        Bucket &bucket = buckets[i];
+        if(bucket.commands.empty())
+            continue;
+        const Mesh &material = *bucket.material;
+        material.bindMaterial(shader);
+        GeometryAllocator::instance().bindVertexArray(*material.layout);
+        size_t elementSize = indexTypeSize(bucket.indexType);
+
+        for(size_t first = 0; first < bucket.commands.size(); ){
+            GLuint recordIndex = bucket.commands[first].baseInstance;
+            const DrawRecord &record = records[recordIndex];
+            shader.setMat4("model"_u, record.model);
+            shader.setMat3("normalMatrix"_u, glm::mat3(glm::vec3(record.normalMatrix[0]), glm::vec3(record.normalMatrix[1]), glm::vec3(record.normalMatrix[2])));
+            shader.setBool("packedVertex"_u, record.positionOffset.w > 0.0f);
+            shader.setVec3("positionOffset"_u, glm::vec3(record.positionOffset));
+            shader.setVec3("positionScale"_u, glm::vec3(record.positionScale));
+
+            drawCounts.clear();
+            drawOffsets.clear();
+            drawBaseVertices.clear();
+            size_t last = first;
+            for(; last < bucket.commands.size() && bucket.commands[last].baseInstance == recordIndex; last++){
+                const DrawElementsIndirectCommand &command = bucket.commands[last];
+                drawCounts.push_back((GLsizei)command.count);
+                drawOffsets.push_back((const void*)((size_t)command.firstIndex * elementSize));
+                drawBaseVertices.push_back(command.baseVertex);
+            }
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), bucket.indexType, drawOffsets.data(), (GLsizei)drawCounts.size(), drawBaseVertices.data());
+            statistics.drawCalls++;
+            first = last;
+        }
+    }
+}
+
+void BatchRenderer::printStatistics() const{
+    cout << "BATCH::RENDERER::" << (statistics.indirect ? "INDIRECT" : "FALLBACK") << endl
+         << "    records:    " << statistics.records << endl
+         << "    draws:      " << statistics.draws << " in " << statistics.buckets << " buckets" << endl
+         << "    draw calls: " << statistics.drawCalls << endl
+         << "    submit:     " << statistics.submitMs << " ms CPU" << endl;
+}
+
+#endif /* BatchRenderer_h */
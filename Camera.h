@@ -63,7 +63,7 @@ public:
     }
 
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 getViewMatrix()
+    glm::mat4 getViewMatrix() const
     {
         return lookAtMatrix(Position, Position + Front, Up);
     }
@@ -74,7 +74,7 @@ public:
 
 private:
     void updateCameraVectors();
-	glm::mat4 lookAtMatrix(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp);
+	glm::mat4 lookAtMatrix(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp) const;
 };
 
 #ifndef FUNCTION_REALIZATION
@@ -143,7 +143,7 @@ void Camera::updateCameraVectors()
 }
 
 // calculates the lookAt matrix
-glm::mat4 Camera::lookAtMatrix(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp) {
+glm::mat4 Camera::lookAtMatrix(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp) const {
     // 1. Position = known
    // 2. Calculate cameraDirection
     glm::vec3 zaxis = glm::normalize(position - target);
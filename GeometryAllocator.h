@@ -0,0 +1,343 @@
+#ifndef GeometryAllocator_h
+#define GeometryAllocator_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "GpuResource.h"
+#include "InstanceBuffer.h"
+#include "VertexFormat.h"
+
+// standard library
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// where one mesh lives inside the shared buffers, drawn with glDrawElementsBaseVertex
+struct GeometryAllocation {
+    const VertexLayout *layout = nullptr;   // selects the arena, nullptr when nothing is allocated
+    unsigned int baseVertex = 0;            // first vertex in the arena's vertex buffer
+    unsigned int vertexCount = 0;
+    size_t indexOffset = 0;                 // bytes into the arena's index buffer, 4-byte aligned
+    size_t indexBytes = 0;
+
+    bool valid() const { return layout != nullptr; }
+};
+
+// MARK: - Class
+// ------------------
+// process-wide suballocator of vertex and index memory: one arena per VertexLayout with a single VAO,
+// a growing vertex buffer and a growing index buffer (16- and 32-bit indices side by side), freed ranges are reused
+// GL thread only
+class GeometryAllocator {
+public:
+    // Functions
+    // ----------
+    static GeometryAllocator& instance();
+
+    // copies vertexCount vertices in layout and indexBytes of indices into the arena of layout, grows it if needed
+    // vertexData may be nullptr to only reserve the vertices and fill them with writeVertices
+    GeometryAllocation allocate(const VertexLayout &layout, const void *vertexData, size_t vertexCount, const void *indexData, size_t indexBytes);
+    void writeVertices(const GeometryAllocation &allocation, size_t firstVertex, const void *vertexData, size_t vertexCount);
+    // returns the ranges to the free lists once the GPU is done with them (GpuDeletionQueue) and clears the allocation
+    void release(GeometryAllocation &allocation);
+
+    // binds the arena's VAO unless it is the last one bound through here
+    void bindVertexArray(const VertexLayout &layout);
+    // call after binding a VAO directly (Model::draw does), so the next bindVertexArray really binds
+    void invalidateBinding() { boundVertexArray = 0; }
+    // adds the instance attributes to the arena's VAO once, leaves it bound
+    void attachInstanceBuffer(const VertexLayout &layout, const InstanceBuffer &instances);
+    // adds one unsigned int per instance at location to the arena's VAO once (the BatchRenderer's draw ids), leaves it bound
+    void attachDrawIDBuffer(const VertexLayout &layout, GLuint buffer, GLuint location);
+
+    size_t getArenaCount() const { return arenas.size(); }
+    void printStatistics() const;
+
+private:
+    // Structure
+    // ----------
+    // first-fit free list over [0, capacity), units are vertices or bytes
+    struct RangeAllocator {
+        size_t capacity = 0;
+        size_t used = 0;
+        map<size_t, size_t> freeRanges;     // offset -> size, never adjacent
+
+        bool allocate(size_t size, size_t alignment, size_t &offset);
+        void release(size_t offset, size_t size);
+        void grow(size_t newCapacity);
+        size_t largestFreeTail() const;     // free space at the end, what growing extends
+    };
+
+    struct Arena {
+        VertexArray vertexArray;
+        GpuBuffer vertexBuffer;
+        GpuBuffer indexBuffer;
+        RangeAllocator vertices;            // in vertices of layout->stride
+        RangeAllocator indices;             // in bytes
+        GLuint instanceBuffer = 0;          // attached InstanceBuffer, 0 before the first instanced draw
+        GLuint drawIDBuffer = 0;            // attached draw id buffer, 0 before the first batched draw
+    };
+
+    // Properties
+    // ----------
+    unordered_map<const VertexLayout*, Arena> arenas;
+    GLuint boundVertexArray = 0;
+
+    GeometryAllocator() {}
+    Arena& arenaFor(const VertexLayout &layout);
+    // replaces buffer with one of newBytes holding the first usedBytes of the old one
+    static void resizeBuffer(GpuBuffer &buffer, size_t usedBytes, size_t newBytes);
+};
+
+// move-only owner of a GeometryAllocation, gives the ranges back when destroyed
+class GeometryHandle {
+public:
+    // Functions
+    // ----------
+    GeometryHandle() {}
+    explicit GeometryHandle(const GeometryAllocation &allocation) : allocation(allocation) {}
+    ~GeometryHandle() { GeometryAllocator::instance().release(allocation); }
+    GeometryHandle(const GeometryHandle&) = delete;
+    GeometryHandle& operator=(const GeometryHandle&) = delete;
+    GeometryHandle(GeometryHandle &&other) noexcept : allocation(other.allocation) { other.allocation = GeometryAllocation(); }
+    GeometryHandle& operator=(GeometryHandle &&other) noexcept;
+
+    const GeometryAllocation& get() const { return allocation; }
+    const GeometryAllocation* operator->() const { return &allocation; }
+    bool valid() const { return allocation.valid(); }
+
+private:
+    // Properties
+    // ----------
+    GeometryAllocation allocation;
+};
+
+// MARK: - Function realization
+// --------------------
+GeometryAllocator& GeometryAllocator::instance(){
+    static GeometryAllocator allocator;
+    return allocator;
+}
+
+bool GeometryAllocator::RangeAllocator::allocate(size_t size, size_t alignment, size_t &offset){
+    for(map<size_t, size_t>::iterator range = freeRanges.begin(); range != freeRanges.end(); ++range){
+        size_t aligned = (range->first + alignment - 1) / alignment * alignment;
+        if(aligned + size > range->first + range->second)
+            continue;
+
+        // split the range around [aligned, aligned + size)
+        size_t start = range->first, end = range->first + range->second;
+        freeRanges.erase(range);
+        if(aligned > start)
+            freeRanges[start] = aligned - start;
+        if(end > aligned + size)
+            freeRanges[aligned + size] = end - (aligned + size);
+        offset = aligned;
+        used += size;
+        return true;
+    }
+    return false;
+}
+
+void GeometryAllocator::RangeAllocator::release(size_t offset, size_t size){
+    if(size == 0)
+        return;
+    used -= size;
+    // merge with the neighbours
+    map<size_t, size_t>::iterator next = freeRanges.lower_bound(offset);
+    if(next != freeRanges.end() && offset + size == next->first){
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if(next != freeRanges.begin()){
+        map<size_t, size_t>::iterator previous = prev(next);
+        if(previous->first + previous->second == offset){
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+void GeometryAllocator::RangeAllocator::grow(size_t newCapacity){
+    if(newCapacity <= capacity)
+        return;
+    size_t oldCapacity = capacity;
+    capacity = newCapacity;
+    used += newCapacity - oldCapacity;      // release() takes it back off
+    release(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t GeometryAllocator::RangeAllocator::largestFreeTail() const{
+    if(freeRanges.empty())
+        return 0;
+    map<size_t, size_t>::const_reverse_iterator last = freeRanges.rbegin();
+    return last->first + last->second == capacity ? last->second : 0;
+}
+
+void GeometryAllocator::resizeBuffer(GpuBuffer &buffer, size_t usedBytes, size_t newBytes){
+    GpuBuffer resized = GpuBuffer::create();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, resized.get());
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+    if(buffer && usedBytes > 0){
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer.get());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    // the old buffer may still be read by queued draws, the move hands it to the deletion queue
+    buffer = move(resized);
+}
+
+GeometryAllocator::Arena& GeometryAllocator::arenaFor(const VertexLayout &layout){
+    unordered_map<const VertexLayout*, Arena>::iterator found = arenas.find(&layout);
+    if(found != arenas.end())
+        return found->second;
+
+    Arena &arena = arenas[&layout];
+    arena.vertexArray = VertexArray::create();
+    return arena;
+}
+
+GeometryAllocation GeometryAllocator::allocate(const VertexLayout &layout, const void *vertexData, size_t vertexCount, const void *indexData, size_t indexBytes){
+    const size_t initialBytes = 8 << 20;
+    Arena &arena = arenaFor(layout);
+    GeometryAllocation allocation;
+    size_t vertexOffset = 0, indexOffset = 0;
+
+    // 1. vertices, the buffer at least doubles so a model's meshes cause few copies
+    if(!arena.vertices.allocate(vertexCount, 1, vertexOffset)){
+        size_t capacity = max(arena.vertices.capacity * 2, initialBytes / layout.stride);
+        while(capacity - arena.vertices.capacity + arena.vertices.largestFreeTail() < vertexCount)
+            capacity *= 2;
+        resizeBuffer(arena.vertexBuffer, arena.vertices.capacity * layout.stride, capacity * layout.stride);
+        arena.vertices.grow(capacity);
+        arena.vertices.allocate(vertexCount, 1, vertexOffset);
+
+        // the VAO keeps the old buffer in its attribute pointers
+        glBindVertexArray(arena.vertexArray.get());
+        boundVertexArray = arena.vertexArray.get();
+        glBindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer.get());
+        layout.setupAttributes();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // 2. indices, 4-byte aligned so 32-bit ones can follow 16-bit ones
+    if(!arena.indices.allocate(indexBytes, 4, indexOffset)){
+        size_t capacity = max(arena.indices.capacity * 2, initialBytes / 2);
+        while(capacity - arena.indices.capacity + arena.indices.largestFreeTail() < indexBytes + 4)
+            capacity *= 2;
+        resizeBuffer(arena.indexBuffer, arena.indices.capacity, capacity);
+        arena.indices.grow(capacity);
+        arena.indices.allocate(indexBytes, 4, indexOffset);
+
+        // the element buffer binding is VAO state
+        glBindVertexArray(arena.vertexArray.get());
+        boundVertexArray = arena.vertexArray.get();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer.get());
+    }
+
+    // 3. upload through the copy target, which leaves every VAO alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer.get());
+    if(vertexData)
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * layout.stride, vertexCount * layout.stride, vertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer.get());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    allocation.layout = &layout;
+    allocation.baseVertex = (unsigned int)vertexOffset;
+    allocation.vertexCount = (unsigned int)vertexCount;
+    allocation.indexOffset = indexOffset;
+    allocation.indexBytes = indexBytes;
+    return allocation;
+}
+
+void GeometryAllocator::writeVertices(const GeometryAllocation &allocation, size_t firstVertex, const void *vertexData, size_t vertexCount){
+    if(!allocation.valid() || firstVertex + vertexCount > allocation.vertexCount)
+        return;
+    const VertexLayout &layout = *allocation.layout;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arenaFor(layout).vertexBuffer.get());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (allocation.baseVertex + firstVertex) * layout.stride, vertexCount * layout.stride, vertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryAllocator::release(GeometryAllocation &allocation){
+    if(!allocation.valid())
+        return;
+    // a draw issued this frame may still read the ranges, so they are not reused before the GPU is done
+    GeometryAllocation released = allocation;
+    GpuDeletionQueue::instance().enqueue([this, released](){
+        unordered_map<const VertexLayout*, Arena>::iterator found = arenas.find(released.layout);
+        if(found != arenas.end()){
+            found->second.vertices.release(released.baseVertex, released.vertexCount);
+            found->second.indices.release(released.indexOffset, released.indexBytes);
+        }
+    });
+    allocation = GeometryAllocation();
+}
+
+GeometryHandle& GeometryHandle::operator=(GeometryHandle &&other) noexcept{
+    if(this != &other){
+        GeometryAllocator::instance().release(allocation);
+        allocation = other.allocation;
+        other.allocation = GeometryAllocation();
+    }
+    return *this;
+}
+
+void GeometryAllocator::bindVertexArray(const VertexLayout &layout){
+    GLuint vertexArray = arenaFor(layout).vertexArray.get();
+    if(vertexArray == boundVertexArray)
+        return;
+    glBindVertexArray(vertexArray);
+    boundVertexArray = vertexArray;
+}
+
+void GeometryAllocator::attachInstanceBuffer(const VertexLayout &layout, const InstanceBuffer &instances){
+    Arena &arena = arenaFor(layout);
+    bindVertexArray(layout);
+    if(arena.instanceBuffer == instances.get())
+        return;
+    instances.setupAttributes();
+    arena.instanceBuffer = instances.get();
+}
+
+void GeometryAllocator::attachDrawIDBuffer(const VertexLayout &layout, GLuint buffer, GLuint location){
+    Arena &arena = arenaFor(layout);
+    bindVertexArray(layout);
+    if(arena.drawIDBuffer == buffer)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(location);
+    glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(location, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    arena.drawIDBuffer = buffer;
+}
+
+void GeometryAllocator::printStatistics() const{
+    size_t vertexBytes = 0, vertexCapacity = 0, indexBytes = 0, indexCapacity = 0;
+    for(const pair<const VertexLayout* const, Arena> &arena : arenas){
+        vertexBytes += arena.second.vertices.used * arena.first->stride;
+        vertexCapacity += arena.second.vertices.capacity * arena.first->stride;
+        indexBytes += arena.second.indices.used;
+        indexCapacity += arena.second.indices.capacity;
+    }
+    cout << "GEOMETRY::ALLOCATOR" << endl
+         << "    arenas:   " << arenas.size() << " (one VAO per vertex format)" << endl
+         << "    vertices: " << vertexBytes / (1024.0 * 1024.0) << " of " << vertexCapacity / (1024.0 * 1024.0) << " MiB" << endl
+         << "    indices:  " << indexBytes / (1024.0 * 1024.0) << " of " << indexCapacity / (1024.0 * 1024.0) << " MiB" << endl;
+}
+
+#endif /* GeometryAllocator_h */
@@ -0,0 +1,180 @@
+#ifndef GpuResource_h
+#define GpuResource_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// standard library
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+enum GpuResourceType {
+    GPU_RESOURCE_BUFFER,
+    GPU_RESOURCE_VERTEX_ARRAY,
+    GPU_RESOURCE_TEXTURE
+};
+
+// MARK: - Functions
+// -----------------
+// Material::bind remembers which texture every unit holds while this stays the same; whatever binds or deletes
+// textures behind its back (uploads, eviction, deletion, a direct glBindTexture) calls invalidateTextureBindings
+inline uint64_t& textureBindingEpoch(){
+    static uint64_t epoch = 0;
+    return epoch;
+}
+inline void invalidateTextureBindings() { textureBindingEpoch()++; }
+
+// MARK: - Class
+// ------------------
+// GL objects and buffer ranges released while the GPU may still read them (a model unloaded mid-frame)
+// are only deleted framesInFlight frames later, GL thread only
+class GpuDeletionQueue {
+public:
+    // Properties
+    // ----------
+    unsigned int framesInFlight = 2;
+
+    // Functions
+    // ----------
+    static GpuDeletionQueue& instance();
+
+    void enqueue(GpuResourceType type, GLuint id);
+    // for releases that are not a GL object, e.g. a GeometryAllocator range that must not be reused yet
+    void enqueue(function<void()> release);
+    // call once per frame after swapping buffers
+    void advanceFrame();
+    // deletes everything now, e.g. before the context goes away
+    void flush();
+    size_t getPendingCount() const { return entries.size(); }
+
+private:
+    // Structure
+    // ----------
+    struct Entry {
+        uint64_t frame;
+        GpuResourceType type;
+        GLuint id;                      // 0 for a release function
+        function<void()> release;
+    };
+
+    // Properties
+    // ----------
+    deque<Entry> entries;               // in frame order
+    uint64_t frame = 0;
+
+    GpuDeletionQueue() {}
+    static void destroy(Entry &entry);
+};
+
+// move-only owner of one GL object name, the object goes through the GpuDeletionQueue when the handle dies
+template<GpuResourceType Type>
+class GpuHandle {
+public:
+    // Functions
+    // ----------
+    GpuHandle() : id(0) {}
+    explicit GpuHandle(GLuint id) : id(id) {}
+    ~GpuHandle() { reset(); }
+    GpuHandle(const GpuHandle&) = delete;
+    GpuHandle& operator=(const GpuHandle&) = delete;
+    GpuHandle(GpuHandle &&other) noexcept : id(other.id) { other.id = 0; }
+    GpuHandle& operator=(GpuHandle &&other) noexcept;
+
+    // glGen* one new object
+    static GpuHandle create();
+
+    GLuint get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+    // queues the current object for deletion and takes id (0 for none)
+    void reset(GLuint newID = 0);
+
+private:
+    // Properties
+    // ----------
+    GLuint id;
+};
+
+typedef GpuHandle<GPU_RESOURCE_BUFFER> GpuBuffer;
+typedef GpuHandle<GPU_RESOURCE_VERTEX_ARRAY> VertexArray;
+typedef GpuHandle<GPU_RESOURCE_TEXTURE> GpuTexture;
+
+// MARK: - Function realization
+// --------------------
+GpuDeletionQueue& GpuDeletionQueue::instance(){
+    // never destroyed: handles in other singletons may still enqueue during static destruction
+    static GpuDeletionQueue *queue = new GpuDeletionQueue();
+    return *queue;
+}
+
+void GpuDeletionQueue::enqueue(GpuResourceType type, GLuint id){
+    if(id != 0)
+        entries.push_back(Entry{ frame, type, id, nullptr });
+}
+
+void GpuDeletionQueue::enqueue(function<void()> release){
+    if(release)
+        entries.push_back(Entry{ frame, GPU_RESOURCE_BUFFER, 0, move(release) });
+}
+
+void GpuDeletionQueue::advanceFrame(){
+    frame++;
+    while(!entries.empty() && entries.front().frame + framesInFlight <= frame){
+        destroy(entries.front());
+        entries.pop_front();
+    }
+}
+
+void GpuDeletionQueue::flush(){
+    while(!entries.empty()){
+        destroy(entries.front());
+        entries.pop_front();
+    }
+}
+
+void GpuDeletionQueue::destroy(Entry &entry){
+    if(entry.release){
+        entry.release();
+        return;
+    }
+    switch(entry.type){
+        case GPU_RESOURCE_BUFFER:       glDeleteBuffers(1, &entry.id); break;
+        case GPU_RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &entry.id); break;
+        case GPU_RESOURCE_TEXTURE:      glDeleteTextures(1, &entry.id); invalidateTextureBindings(); break;
+    }
+}
+
+template<GpuResourceType Type>
+GpuHandle<Type>& GpuHandle<Type>::operator=(GpuHandle &&other) noexcept{
+    if(this != &other){
+        reset(other.id);
+        other.id = 0;
+    }
+    return *this;
+}
+
+template<GpuResourceType Type>
+GpuHandle<Type> GpuHandle<Type>::create(){
+    GLuint id = 0;
+    switch(Type){
+        case GPU_RESOURCE_BUFFER:       glGenBuffers(1, &id); break;
+        case GPU_RESOURCE_VERTEX_ARRAY: glGenVertexArrays(1, &id); break;
+        case GPU_RESOURCE_TEXTURE:      glGenTextures(1, &id); break;
+    }
+    return GpuHandle(id);
+}
+
+template<GpuResourceType Type>
+void GpuHandle<Type>::reset(GLuint newID){
+    if(id != 0 && id != newID)
+        GpuDeletionQueue::instance().enqueue(Type, id);
+    id = newID;
+}
+
+#endif /* GpuResource_h */
@@ -0,0 +1,38 @@
+#ifndef Hash_h
+#define Hash_h
+
+// MARK: - Library
+// -----------------
+// standard library
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// 64-bit FNV-1a
+#define HASH_SEED 14695981039346656037ull
+#define HASH_PRIME 1099511628211ull
+
+// MARK: - Functions
+// -----------------
+// FNV-1a over size bytes, continues seed so parts hashed one after another hash like their concatenation
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = HASH_SEED){
+    const unsigned char *bytes = (const unsigned char*)data;
+    for(size_t i = 0; i < size; i++)
+        seed = (seed ^ bytes[i]) * HASH_PRIME;
+    return seed;
+}
+
+// one FNV step over a whole word and the murmur3 finalizer, so every bit of the result depends on every bit of value;
+// for keys hashed per vertex where the byte loop costs too much
+inline uint64_t hashWord(uint64_t value, uint64_t seed = HASH_SEED){
+    uint64_t hash = (seed ^ value) * HASH_PRIME;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+#endif /* Hash_h */
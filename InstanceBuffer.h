@@ -0,0 +1,103 @@
+#ifndef InstanceBuffer_h
+#define InstanceBuffer_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "GpuResource.h"
+
+// standard library
+#include <algorithm>
+#include <cstddef>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// per-instance vertex attributes, locations match VertexShader.glsl (instanced)
+#define INSTANCE_MODEL_LOCATION 7       // 4 columns, 7-10
+#define INSTANCE_NORMAL_LOCATION 11     // 3 columns, 11-13
+
+struct InstanceData {
+    glm::mat4 model;                    // applied on top of the node's world matrix
+    glm::mat3 normalMatrix;             // transpose(inverse(mat3(model)))
+};
+static_assert(sizeof(InstanceData) == 100, "InstanceData is read as 7 tightly packed vertex attributes");
+
+// MARK: - Class
+// ------------------
+// one stream buffer of InstanceData shared by every instanced draw, refilled (orphaned) per draw
+// its name never changes, so a VAO set up once keeps pointing at it while it grows
+// GL thread only
+class InstanceBuffer {
+public:
+    // Functions
+    // ----------
+    static InstanceBuffer& shared();
+    // InstanceData from world matrices, computes the normal matrices
+    static InstanceData makeInstance(const glm::mat4 &model);
+
+    void upload(const InstanceData *instances, size_t instanceCount);
+    // points the instance locations of the bound VAO at the buffer, advancing once per instance
+    void setupAttributes() const;
+    GLuint get() const { return buffer.get(); }
+    size_t getCapacity() const { return capacity; }
+
+private:
+    // Properties
+    // ----------
+    GpuBuffer buffer;
+    size_t capacity = 0;                // in instances
+
+    InstanceBuffer() {}
+};
+
+// MARK: - Function realization
+// --------------------
+InstanceBuffer& InstanceBuffer::shared(){
+    static InstanceBuffer instanceBuffer;
+    return instanceBuffer;
+}
+
+InstanceData InstanceBuffer::makeInstance(const glm::mat4 &model){
+    InstanceData instance;
+    instance.model = model;
+    instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    return instance;
+}
+
+void InstanceBuffer::upload(const InstanceData *instances, size_t instanceCount){
+    if(!buffer)
+        buffer = GpuBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.get());
+    // new storage every time (orphaning): the draws still reading the old contents never stall this upload
+    capacity = max(capacity, instanceCount);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(InstanceData), instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::setupAttributes() const{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.get());
+    for(GLuint column = 0; column < 4; column++){
+        GLuint location = INSTANCE_MODEL_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    for(GLuint column = 0; column < 3; column++){
+        GLuint location = INSTANCE_NORMAL_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif /* InstanceBuffer_h */
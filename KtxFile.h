@@ -0,0 +1,233 @@
+#ifndef KtxFile_h
+#define KtxFile_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "GpuResource.h"
+
+// standard library
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// block-compressed formats missing from the core 3.3 headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// MARK: - Structure
+// ------------------
+// in-memory KTX 1.1 texture: a single 2D image with its whole mip chain, ready for glCompressedTexImage2D / glTexImage2D
+struct KtxImage {
+    uint32_t glType = 0;                // 0 for compressed formats
+    uint32_t glTypeSize = 1;
+    uint32_t glFormat = 0;              // 0 for compressed formats
+    uint32_t glInternalFormat = 0;
+    uint32_t glBaseInternalFormat = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    vector<vector<unsigned char>> levels;   // level 0 first, uncompressed rows are padded to 4 bytes
+    string buildKey;                    // "build" key/value pair, the settings the file was made with (see textureBuildKey)
+
+    bool isCompressed() const { return glType == 0; }
+    bool empty() const { return levels.empty(); }
+    int componentCount() const;         // channels of glBaseInternalFormat, 0 if unknown
+    size_t byteSize() const;
+};
+
+// MARK: - Functions
+// -----------------
+bool readKtx(const string &path, KtxImage &image);
+bool writeKtx(const string &path, const KtxImage &image);
+// GL thread only, returns 0 if the image is empty, respecifies textureID instead of creating one when given
+unsigned int uploadKtx(const KtxImage &image, unsigned int textureID = 0);
+
+// MARK: - Function realization
+// --------------------
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const char KTX_BUILD_KEY[] = "build";
+
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+size_t KtxImage::byteSize() const{
+    size_t bytes = 0;
+    for(const vector<unsigned char> &level : levels)
+        bytes += level.size();
+    return bytes;
+}
+
+int KtxImage::componentCount() const{
+    switch(glBaseInternalFormat){
+        case GL_RED:  return 1;
+        case GL_RG:   return 2;
+        case GL_RGB:  return 3;
+        case GL_RGBA: return 4;
+        default:      return 0;
+    }
+}
+
+bool readKtx(const string &path, KtxImage &image){
+    ifstream file(path, ios::binary);
+    if(!file)
+        return false;
+
+    KtxHeader header;
+    if(!file.read((char*)&header, sizeof(header)) || memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 ||
+       header.endianness != 0x04030201 || header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.numberOfFaces != 1 ||
+       header.pixelWidth == 0 || header.pixelHeight == 0 || header.numberOfMipmapLevels > 32)
+        return false;
+
+    // key/value pairs: byte size, null-terminated key, value, padding to 4 bytes
+    if(header.bytesOfKeyValueData > (1u << 16))
+        return false;
+    vector<char> keyValueData(header.bytesOfKeyValueData);
+    if(!file.read(keyValueData.data(), keyValueData.size()))
+        return false;
+    image.buildKey.clear();
+    for(size_t offset = 0; offset + sizeof(uint32_t) <= keyValueData.size(); ){
+        uint32_t pairSize;
+        memcpy(&pairSize, &keyValueData[offset], sizeof(pairSize));
+        offset += sizeof(pairSize);
+        if(pairSize > keyValueData.size() - offset)
+            break;
+        string pair(&keyValueData[offset], pairSize);
+        size_t keyEnd = pair.find('\0');
+        if(keyEnd != string::npos && pair.compare(0, keyEnd, KTX_BUILD_KEY) == 0)
+            image.buildKey = pair.substr(keyEnd + 1, pair.find('\0', keyEnd + 1) - keyEnd - 1);
+        offset += (pairSize + 3) & ~3u;
+    }
+
+    image.glType = header.glType;
+    image.glTypeSize = header.glTypeSize;
+    image.glFormat = header.glFormat;
+    image.glInternalFormat = header.glInternalFormat;
+    image.glBaseInternalFormat = header.glBaseInternalFormat;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.levels.assign(max(header.numberOfMipmapLevels, 1u), vector<unsigned char>());
+
+    for(vector<unsigned char> &level : image.levels){
+        uint32_t imageSize = 0;
+        if(!file.read((char*)&imageSize, sizeof(imageSize)) || imageSize > (1u << 30))
+            return false;
+        level.resize(imageSize);
+        if(!file.read((char*)level.data(), imageSize))
+            return false;
+        file.seekg((4 - imageSize % 4) % 4, ios::cur);  // mipPadding
+    }
+    return true;
+}
+
+// writes to a temporary file first, so a concurrent reader never sees a partial texture
+bool writeKtx(const string &path, const KtxImage &image){
+    if(image.empty())
+        return false;
+
+    KtxHeader header;
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = 0x04030201;
+    header.glType = image.glType;
+    header.glTypeSize = image.glTypeSize;
+    header.glFormat = image.glFormat;
+    header.glInternalFormat = image.glInternalFormat;
+    header.glBaseInternalFormat = image.glBaseInternalFormat;
+    header.pixelWidth = image.width;
+    header.pixelHeight = image.height;
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)image.levels.size();
+    string keyValue;
+    if(!image.buildKey.empty()){
+        string pair = string(KTX_BUILD_KEY) + '\0' + image.buildKey + '\0';
+        uint32_t pairSize = (uint32_t)pair.size();
+        keyValue.append((const char*)&pairSize, sizeof(pairSize));
+        keyValue.append(pair);
+        keyValue.append((4 - pairSize % 4) % 4, '\0');
+    }
+    header.bytesOfKeyValueData = (uint32_t)keyValue.size();
+
+    string tempPath = path + ".tmp";
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    if(!file)
+        return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write(keyValue.data(), keyValue.size());
+    const char padding[4] = {0};
+    for(const vector<unsigned char> &level : image.levels){
+        uint32_t imageSize = (uint32_t)level.size();
+        file.write((const char*)&imageSize, sizeof(imageSize));
+        file.write((const char*)level.data(), imageSize);
+        file.write(padding, (4 - imageSize % 4) % 4);
+    }
+    file.close();
+
+    if(!file){
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+unsigned int uploadKtx(const KtxImage &image, unsigned int textureID){
+    if(image.empty())
+        return textureID;
+
+    if(textureID == 0)
+        glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    invalidateTextureBindings();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);      // KTX pads uncompressed rows to 4 bytes
+
+    for(size_t level = 0; level < image.levels.size(); level++){
+        GLsizei width = max(1u, image.width >> level);
+        GLsizei height = max(1u, image.height >> level);
+        if(image.isCompressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.glInternalFormat, width, height, 0, (GLsizei)image.levels[level].size(), image.levels[level].data());
+        else
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, image.glInternalFormat, width, height, 0, image.glFormat, image.glType, image.levels[level].data());
+    }
+
+    // precomputed chain, no glGenerateMipmap
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+#endif /* KtxFile_h */
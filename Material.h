@@ -0,0 +1,329 @@
+#ifndef Material_h
+#define Material_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "GpuResource.h"
+#include "Hash.h"
+#include "Shader.h"
+#include "ShaderUniform.h"
+#include "UniformBlocks.h"
+
+// standard library
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// texture units a material binds, GL 3.3 guarantees 16 per fragment shader
+#define MATERIAL_MAX_TEXTURE_UNITS 16
+
+// MARK: - Structure
+// ------------------
+struct Texture {
+    unsigned int id;
+    string type;
+
+    string path;
+    GLenum target = GL_TEXTURE_2D;      // GL_TEXTURE_2D_ARRAY once the model packed it (TextureArray.h), id is then the array
+    int layer = -1;                     // layer in that array
+};
+
+// MARK: - Class
+// ------------------
+// the textures and constants of a surface with everything binding needs worked out once: 2D textures take units 0 and up
+// with the sampler texture_typeN (numbered per type in order, like the original Mesh::draw), array layers take the units
+// from TEXTURE_ARRAY_UNIT_BASE with the sampler texture_type_array and their layer in the Material block, the constants fill the rest
+// binding skips what is already in place: sampler uniforms per program, textures per unit, the whole bind when nothing changed
+// GL thread only
+class Material {
+public:
+    // Functions
+    // ----------
+    Material(vector<Texture> textures, const MaterialBlock &constants);
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+
+    // binds the textures and the Material block for shader, a no-op when this material is still bound
+    void bind(Shader &shader) const;
+
+    const vector<Texture>& getTextures() const { return textures; }
+    const MaterialBlock& getConstants() const { return constants; }
+    uint64_t getHash() const { return hash; }
+    bool sameAs(const vector<Texture> &otherTextures, const MaterialBlock &otherConstants) const;
+    static uint64_t hashOf(const vector<Texture> &textures, const MaterialBlock &constants);
+    // constants with diffuseLayer / specularLayer taken from the textures, what a material of them holds
+    static MaterialBlock withLayers(const vector<Texture> &textures, MaterialBlock constants);
+    // glBindTexture calls bind issues for these materials in this order, starting from empty units (for reports, no GL)
+    static size_t countTextureBinds(const vector<const Material*> &sequence);
+
+private:
+    // Structure
+    // ----------
+    // what bind leaves behind, shared by every material
+    struct BindingState {
+        uint64_t material = 0;          // serial of the material bound last, 0 for none
+        uint64_t epoch = 0;             // textureBindingEpoch the units were recorded in
+        GLuint units[MATERIAL_MAX_TEXTURE_UNITS] = {};
+    };
+
+    struct Binding {
+        UniformID sampler;              // texture_typeN or texture_type_array, hashed once
+        GLuint unit;
+        GLenum target;
+        GLuint texture;
+    };
+
+    struct ProgramSamplers {
+        GLuint program;
+        vector<GLint> locations;        // per binding, -1 where the program has no such sampler
+    };
+
+    // Properties
+    // ----------
+    vector<Texture> textures;
+    vector<Binding> bindings;           // the textures that got a unit
+    uint64_t samplerLayout;             // hash of the sampler names and units, programs already set to it are skipped
+    MaterialBlock constants;
+    uint64_t hash;
+    uint64_t serial;                    // unique per material, addresses are reused
+    mutable vector<ProgramSamplers> programs;
+
+    // Functions
+    // ----------
+    static BindingState& bindingState();
+    const vector<GLint>& samplerLocations(const Shader &shader) const;
+};
+
+// process-wide table of the live materials, meshes with equal textures and constants share one Material
+// entries are weak, a material goes away with the last mesh using it
+// GL thread only
+class MaterialLibrary {
+public:
+    // Functions
+    // ----------
+    static MaterialLibrary& shared();
+
+    shared_ptr<const Material> acquire(const vector<Texture> &textures, const MaterialBlock &constants);
+    size_t size();
+
+private:
+    // Properties
+    // ----------
+    unordered_multimap<uint64_t, weak_ptr<const Material>> materials;
+    size_t sweepSize = 64;              // expired entries are dropped whenever the table grows past this
+
+    MaterialLibrary() {}
+    void sweep();
+};
+
+// MARK: - Function realization
+// --------------------
+Material::Material(vector<Texture> materialTextures, const MaterialBlock &materialConstants) : textures(move(materialTextures)), constants(withLayers(textures, materialConstants)){
+    static uint64_t serials = 0;
+    serial = ++serials;
+    hash = hashOf(textures, constants);
+
+    // texture_categoryN (e.g. texture_diffuse1) or texture_category_array, hashed in place
+    unsigned int diffuseNr = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr   = 1;
+    unsigned int heightNr   = 1;
+    GLuint planeUnit = 0, arrayUnit = TEXTURE_ARRAY_UNIT_BASE;
+    size_t unbound = 0;
+    samplerLayout = UNIFORM_HASH_SEED;
+    for(const Texture &texture : textures){
+        const string &name = texture.type;
+        uint32_t samplerHash = hashUniformName(name.data(), name.size());
+        GLuint unit;
+        if(texture.target == GL_TEXTURE_2D_ARRAY){
+            if(arrayUnit == MATERIAL_MAX_TEXTURE_UNITS){
+                unbound++;
+                continue;
+            }
+            unit = arrayUnit++;
+            samplerHash = hashUniformName("_array", 6, samplerHash);
+        }
+        else{
+            if(planeUnit == TEXTURE_ARRAY_UNIT_BASE){
+                unbound++;
+                continue;
+            }
+            unit = planeUnit++;
+            unsigned int number = 0;
+            if(name == "texture_diffuse")
+                number = diffuseNr++;
+            else if(name == "texture_specular")
+                number = specularNr++;
+            else if(name == "texture_normal")
+                number = normalNr++;
+            else if(name == "texture_height")
+                number = heightNr++;
+            char digits[16];
+            to_chars_result written = to_chars(digits, digits + sizeof(digits), number);
+            if(number > 0)
+                samplerHash = hashUniformName(digits, written.ptr - digits, samplerHash);
+        }
+        bindings.push_back(Binding{ UniformID{ samplerHash, nullptr }, unit, texture.target, texture.id });
+        samplerLayout = hashWord(unit, hashWord(samplerHash, samplerLayout));
+    }
+    if(unbound > 0)
+        cout << "WARNING::MATERIAL::TOO_MANY_TEXTURES::" << unbound << " of " << textures.size() << " get no unit (" << TEXTURE_ARRAY_UNIT_BASE
+             << " for 2D textures, " << MATERIAL_MAX_TEXTURE_UNITS - TEXTURE_ARRAY_UNIT_BASE << " for texture arrays)" << endl;
+}
+
+uint64_t Material::hashOf(const vector<Texture> &textures, const MaterialBlock &constants){
+    // FNV-1a over the texture names, types and layers and the constant bytes
+    uint64_t hash = HASH_SEED;
+    for(const Texture &texture : textures){
+        hash = hashBytes(&texture.id, sizeof(texture.id), hash);
+        hash = hashBytes(texture.type.data(), texture.type.size(), hash);
+        hash = hashBytes(&texture.target, sizeof(texture.target), hash);
+        hash = hashBytes(&texture.layer, sizeof(texture.layer), hash);
+    }
+    return hashBytes(&constants, sizeof(MaterialBlock), hash);
+}
+
+bool Material::sameAs(const vector<Texture> &otherTextures, const MaterialBlock &otherConstants) const{
+    if(otherTextures.size() != textures.size() || memcmp(&otherConstants, &constants, sizeof(MaterialBlock)) != 0)
+        return false;
+    for(size_t i = 0; i < textures.size(); i++)
+        if(otherTextures[i].id != textures[i].id || otherTextures[i].type != textures[i].type
+           || otherTextures[i].target != textures[i].target || otherTextures[i].layer != textures[i].layer)
+            return false;
+    return true;
+}
+
+MaterialBlock Material::withLayers(const vector<Texture> &textures, MaterialBlock constants){
+    // the shader samples one texture per type, the first like texture_diffuse1
+    constants.diffuseLayer = constants.specularLayer = -1.0f;
+    bool diffuseSeen = false, specularSeen = false;
+    for(const Texture &texture : textures){
+        bool diffuse = texture.type == "texture_diffuse", specular = texture.type == "texture_specular";
+        float layer = texture.target == GL_TEXTURE_2D_ARRAY ? (float)texture.layer : -1.0f;
+        if(diffuse && !diffuseSeen){
+            constants.diffuseLayer = layer;
+            diffuseSeen = true;
+        }
+        else if(specular && !specularSeen){
+            constants.specularLayer = layer;
+            specularSeen = true;
+        }
+    }
+    return constants;
+}
+
+size_t Material::countTextureBinds(const vector<const Material*> &sequence){
+    BindingState state;
+    memset(state.units, 0xFF, sizeof(state.units));
+    size_t binds = 0;
+    for(const Material *material : sequence){
+        if(material->serial == state.material)
+            continue;
+        for(const Binding &binding : material->bindings){
+            if(state.units[binding.unit] != binding.texture){
+                state.units[binding.unit] = binding.texture;
+                binds++;
+            }
+        }
+        state.material = material->serial;
+    }
+    return binds;
+}
+
+Material::BindingState& Material::bindingState(){
+    static BindingState state;
+    return state;
+}
+
+const vector<GLint>& Material::samplerLocations(const Shader &shader) const{
+    for(const ProgramSamplers &program : programs)
+        if(program.program == shader.ID)
+            return program.locations;
+    ProgramSamplers program{ shader.ID, vector<GLint>() };
+    for(const Binding &binding : bindings)
+        program.locations.push_back(shader.getUniformLocation(binding.sampler));
+    programs.push_back(move(program));
+    return programs.back().locations;
+}
+
+void Material::bind(Shader &shader) const{
+    BindingState &state = bindingState();
+    uint64_t epoch = textureBindingEpoch();
+    if(state.material == serial && state.epoch == epoch && shader.samplerLayout == samplerLayout)
+        return;
+
+    // sampler uniforms are program state, set once per program and layout
+    if(shader.samplerLayout != samplerLayout){
+        const vector<GLint> &locations = samplerLocations(shader);
+        for(size_t i = 0; i < locations.size(); i++)
+            uploadUniform(locations[i], (int)bindings[i].unit);
+        shader.samplerLayout = samplerLayout;
+    }
+
+    // only the units holding another texture, all of them after something else touched the bindings
+    if(state.epoch != epoch){
+        memset(state.units, 0xFF, sizeof(state.units));
+        state.epoch = epoch;
+    }
+    for(const Binding &binding : bindings){
+        if(state.units[binding.unit] == binding.texture)
+            continue;
+        glActiveTexture(GL_TEXTURE0 + binding.unit);
+        glBindTexture(binding.target, binding.texture);
+        state.units[binding.unit] = binding.texture;
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    UniformBlocks::shared().setMaterial(constants);
+    state.material = serial;
+}
+
+MaterialLibrary& MaterialLibrary::shared(){
+    static MaterialLibrary materialLibrary;
+    return materialLibrary;
+}
+
+shared_ptr<const Material> MaterialLibrary::acquire(const vector<Texture> &textures, const MaterialBlock &materialConstants){
+    MaterialBlock constants = Material::withLayers(textures, materialConstants);
+    uint64_t hash = Material::hashOf(textures, constants);
+    auto range = materials.equal_range(hash);
+    for(auto found = range.first; found != range.second; ++found){
+        shared_ptr<const Material> material = found->second.lock();
+        if(material && material->sameAs(textures, constants))
+            return material;
+    }
+
+    shared_ptr<const Material> material = make_shared<const Material>(textures, constants);
+    materials.emplace(hash, material);
+    if(materials.size() >= sweepSize)
+        sweep();
+    return material;
+}
+
+size_t MaterialLibrary::size(){
+    sweep();
+    return materials.size();
+}
+
+void MaterialLibrary::sweep(){
+    for(auto entry = materials.begin(); entry != materials.end(); ){
+        if(entry->second.expired())
+            entry = materials.erase(entry);
+        else
+            ++entry;
+    }
+    sweepSize = max<size_t>(64, materials.size() * 2);
+}
+
+#endif /* Material_h */
@@ -12,15 +12,24 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 // own library
+#include "GeometryAllocator.h"
+#include "Material.h"
 #include "Shader.h"
+#include "VertexFormat.h"
+#include "VertexPacking.h"
 
 // standard library
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
+#define MAX_MESH_LODS 5
 
 // MARK: - Structure
 // ------------------
@@ -36,11 +45,21 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    
-    string path;
+// one level of detail: a range of the index buffer over the shared vertex buffer
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;                        // bound of the deviation from LOD 0, in model units
+};
+
+// a cluster of about 64 vertices and 124 triangles of LOD 0, culled on the CPU before the draw
+struct Meshlet {
+    unsigned int firstIndex;            // range of the index buffer inside LOD 0
+    unsigned int indexCount;
+    glm::vec3 center;                   // bounding sphere in model space
+    float radius;
+    glm::vec3 coneAxis;                 // every triangle faces away from an eye with
+    float coneCutoff;                   // dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius, 1 never culls
 };
 
 // MARK: - Class
@@ -49,126 +68,343 @@ class Mesh {
 public:
     // Mesh properties
     // ----------
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-    unsigned int VAO;
+    vector<Vertex> vertices;            // import copy kept for the mesh cache, empty when uploaded from elsewhere
+    vector<unsigned char> indexData;    // import copy in indexType kept for the mesh cache, empty when uploaded from elsewhere
+    vector<Texture> textures;           // what material was built from, kept for the mesh cache and residency
+    shared_ptr<const Material> material;    // shared with every mesh of equal textures and constants (MaterialLibrary)
+    GeometryHandle geometry;            // range of the shared vertex and index buffers, given back when the mesh dies
+    unsigned int indexCount;            // every level together
+    vector<MeshLod> lods;               // LOD 0 first, always at least one level
+    vector<Meshlet> meshlets;           // empty for meshes drawn as a whole
+    GLenum indexType;                   // GL_UNSIGNED_SHORT whenever every vertex is addressable with 16 bits
+    VertexEncoding encoding;            // may fall back to VERTEX_ENCODING_FULL if the mesh cannot be packed
+    const VertexLayout *layout;         // VertexFormat of the GPU buffer, only the attributes the mesh uses
+    size_t vertexBytes;                 // size of the vertex buffer on the GPU
+    glm::vec3 boundsCenter;             // bounding sphere in model space
+    float boundsRadius;
     
     // Functions
     // ----------
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
-    void draw(Shader &shader);
+    // picks the smallest VertexFormat of the encoding that holds what the vertices use (tangents, bones)
+    // and the narrowest index type, triangles referencing missing vertices are dropped
+    // lods are ranges of indices, empty means the indices are LOD 0, meshlets are ranges inside LOD 0
+    // pass the import data with move(), it is kept without another copy
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexEncoding encoding = VERTEX_ENCODING_FULL,
+         vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>());
+    // uploads straight from external memory (e.g. a mapped mesh cache, already validated), vertices and indexData stay empty
+    Mesh(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, GLenum indexType, vector<Texture> textures,
+         VertexEncoding encoding = VERTEX_ENCODING_FULL, vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>());
+    // uploads vertices already built in a VertexFormat (e.g. procedural geometry), vertices and indexData stay empty
+    template<typename FormatVertex, typename Format = typename FormatVertex::Format>
+    Mesh(const vector<FormatVertex> &formatVertices, const vector<unsigned int> &formatIndices, vector<Texture> textures);
+    // move-only, the GPU ranges have exactly one owner
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+    // drops the import copies once nothing (the mesh cache) needs them anymore
+    void releaseImportData();
+    // residency: eviction gives the GPU ranges back, restoring uploads the same vertices and indexType indices again
+    void evictGeometry() { geometry = GeometryHandle(); }
+    void restoreGeometry(const Vertex *vertexData, size_t vertexCount, const void *indexData);
+    bool isResident() const { return geometry.valid(); }
+    size_t getGpuBytes() const;
+    void draw(Shader &shader, unsigned int lod = 0);
+    // drawCount index ranges in one glMultiDrawElementsBaseVertex, offsets in bytes from the mesh's first index (e.g. the visible meshlets)
+    // both draws leave the arena's VAO bound, see GeometryAllocator::invalidateBinding
+    void draw(Shader &shader, const GLsizei *counts, const void *const *offsets, GLsizei drawCount);
+    // instanceCount copies of one level, the arena's VAO needs the InstanceBuffer attached (Model::drawInstanced does)
+    void drawInstanced(Shader &shader, unsigned int lod, GLsizei instanceCount);
+    // binds the material (nothing when it is still bound) and sets the vertex decoding uniforms, what every draw starts with
+    // (the BatchRenderer binds once per bucket of meshes sharing the material)
+    void bindMaterial(Shader &shader) const;
+    // looks material up again from textures and constants, e.g. once the texture ids are known
+    void setMaterial(const MaterialBlock &constants);
+    const glm::vec3& getPositionOffset() const { return positionOffset; }
+    const glm::vec3& getPositionScale() const { return positionScale; }
     
 private:
     // Mesh properties
     // ----------
-    unsigned int VBO, EBO;
+    vector<const void*> multiDrawOffsets;   // scratch of the multi-draw, reused
+    vector<GLint> multiDrawBaseVertices;
+    glm::vec3 positionOffset;           // dequantization of packed positions: offset + scale * snorm
+    glm::vec3 positionScale;
     
     // Functions
     // ----------
-    void setupMesh();
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount);
+    template<typename Format>
+    void setupMeshAs(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, const VertexEncodeContext &context);
+    void setupBuffers(const VertexLayout &vertexLayout, const void *vertexData, size_t vertexDataSize, const void *indexData, size_t indexCount);
     
 };
 
+// MARK: - Functions
+// -----------------
+size_t indexTypeSize(GLenum indexType);
+GLenum chooseIndexType(size_t vertexCount);
+// narrows to indexType and drops triangles referencing a vertex >= vertexCount, returns the number of dropped triangles
+size_t packIndices(const unsigned int *indices, size_t indexCount, size_t vertexCount, GLenum indexType, vector<unsigned char> &packed);
+
 // MARK: - Function realization
 // --------------------
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures){
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
-    
-    setupMesh();
+size_t indexTypeSize(GLenum indexType){
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
 }
 
-void Mesh::setupMesh(){
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+GLenum chooseIndexType(size_t vertexCount){
+    return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t packIndices(const unsigned int *indices, size_t indexCount, size_t vertexCount, GLenum indexType, vector<unsigned char> &packed){
+    size_t elementSize = indexTypeSize(indexType);
+    size_t dropped = 0;
+    packed.resize(indexCount / 3 * 3 * elementSize);
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    unsigned char *out = packed.data();
+    for(size_t i = 0; i + 2 < indexCount; i += 3){
+        if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount){
+            dropped++;
+            continue;
+        }
+        for(size_t j = 0; j < 3; j++){
+            if(indexType == GL_UNSIGNED_SHORT){
+                uint16_t index = (uint16_t)indices[i + j];
+                memcpy(out, &index, sizeof(index));
+            }
+            else{
+                uint32_t index = indices[i + j];
+                memcpy(out, &index, sizeof(index));
+            }
+            out += elementSize;
+        }
+    }
+    packed.resize(out - packed.data());
+    return dropped;
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexEncoding encoding, vector<MeshLod> lods, vector<Meshlet> meshlets){
+    this->vertices = move(vertices);
+    this->textures = move(textures);
+    setMaterial(MaterialBlock());
+    this->encoding = encoding;
+    this->indexType = chooseIndexType(this->vertices.size());
+    if(lods.empty())
+        lods.push_back(MeshLod{ 0, (unsigned int)indices.size(), 0.0f });
+    // a level reaching past the indices rejects the whole chain: LOD 0 alone is drawn, every index if LOD 0 is the broken one
+    bool chainInRange = true;
+    for(const MeshLod &lod : lods)
+        chainInRange = chainInRange && (size_t)lod.firstIndex + lod.indexCount <= indices.size();
+    if(!chainInRange){
+        cout << "ERROR::MESH::LOD_OUT_OF_RANGE::" << lods.size() << " levels over " << indices.size() << " indices, the chain is dropped" << endl;
+        if((size_t)lods[0].firstIndex + lods[0].indexCount > indices.size()){
+            lods[0] = MeshLod{ 0, (unsigned int)indices.size(), 0.0f };
+            meshlets.clear();               // their ranges are inside the old LOD 0
+        }
+        lods.resize(1);
+    }
     
-    // Vertex Position
-    // ----------
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // every level is packed on its own so dropped triangles shift the ranges after it
+    size_t dropped = 0, elementSize = indexTypeSize(indexType);
+    vector<unsigned char> packed;
+    indexData.reserve(indices.size() * elementSize);
+    for(const MeshLod &lod : lods){
+        dropped += packIndices(indices.data() + lod.firstIndex, lod.indexCount, this->vertices.size(), indexType, packed);
+        this->lods.push_back(MeshLod{ (unsigned int)(indexData.size() / elementSize), (unsigned int)(packed.size() / elementSize), lod.error });
+        indexData.insert(indexData.end(), packed.begin(), packed.end());
+    }
+    if(dropped > 0)
+        cout << "ERROR::MESH::INDEX_OUT_OF_RANGE::" << dropped << " triangles dropped" << endl;
+    // the 32-bit indices are not needed anymore, free them before the upload
+    vector<unsigned int>().swap(indices);
+    vector<unsigned char>().swap(packed);
+    // the meshlet ranges only hold while LOD 0 was packed unchanged
+    if(dropped == 0 && this->lods[0].firstIndex == lods[0].firstIndex)
+        this->meshlets = move(meshlets);
     
-    // Vertex Normal
-    // ----------
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    setupMesh(this->vertices.data(), this->vertices.size(), indexData.data(), indexData.size() / indexTypeSize(indexType));
+}
+
+Mesh::Mesh(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, GLenum indexType, vector<Texture> textures,
+           VertexEncoding encoding, vector<MeshLod> lods, vector<Meshlet> meshlets){
+    this->textures = move(textures);
+    setMaterial(MaterialBlock());
+    this->encoding = encoding;
+    this->indexType = indexType;
+    this->lods = lods.empty() ? vector<MeshLod>(1, MeshLod{ 0, (unsigned int)indexCount, 0.0f }) : move(lods);
+    this->meshlets = move(meshlets);
     
-    // Vertex Texcoord
-    // ----------
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    setupMesh(vertexData, vertexCount, indexData, indexCount);
+}
+
+template<typename FormatVertex, typename Format>
+Mesh::Mesh(const vector<FormatVertex> &formatVertices, const vector<unsigned int> &formatIndices, vector<Texture> textures){
+    this->textures = move(textures);
+    setMaterial(MaterialBlock());
+    this->encoding = Format::packed ? VERTEX_ENCODING_PACKED : VERTEX_ENCODING_FULL;
+    this->indexType = chooseIndexType(formatVertices.size());
+    positionOffset = glm::vec3(0.0f);   // packed positions were encoded with a default VertexEncodeContext
+    positionScale = glm::vec3(1.0f);
+    boundsCenter = glm::vec3(0.0f);     // unknown for an arbitrary format, never selects a coarser level
+    boundsRadius = 0.0f;
     
-    // Vertex Tangent
-    // ----------
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    vector<unsigned char> packed;
+    size_t dropped = packIndices(formatIndices.data(), formatIndices.size(), formatVertices.size(), indexType, packed);
+    if(dropped > 0)
+        cout << "ERROR::MESH::INDEX_OUT_OF_RANGE::" << dropped << " triangles dropped" << endl;
     
-    // Vertex Bitangent
-    // ----------
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    lods.push_back(MeshLod{ 0, (unsigned int)(packed.size() / indexTypeSize(indexType)), 0.0f });
+    setupBuffers(Format::layout(), formatVertices.data(), formatVertices.size() * sizeof(FormatVertex), packed.data(), packed.size() / indexTypeSize(indexType));
+}
+
+void Mesh::setupMesh(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount){
+    // 1. what the vertices actually use
+    glm::vec3 minimum(0.0f), maximum(0.0f);
+    bool hasTangents = false, hasBones = false, bonesFitPacked = true;
+    for(size_t i = 0; i < vertexCount; i++){
+        const Vertex &vertex = vertexData[i];
+        minimum = i == 0 ? vertex.Position : glm::min(minimum, vertex.Position);
+        maximum = i == 0 ? vertex.Position : glm::max(maximum, vertex.Position);
+        hasTangents = hasTangents || glm::dot(vertex.Tangent, vertex.Tangent) > 0.0f;
+        for(int j = 0; j < MAX_BONE_INFLUENCE; j++){
+            if(vertex.m_Weights[j] <= 0.0f)
+                continue;
+            hasBones = true;
+            bonesFitPacked = bonesFitPacked && vertex.m_BoneIDs[j] >= 0 && vertex.m_BoneIDs[j] <= 255;
+        }
+    }
+    boundsCenter = (minimum + maximum) * 0.5f;
+    boundsRadius = 0.0f;
+    for(size_t i = 0; i < vertexCount; i++)
+        boundsRadius = max(boundsRadius, glm::length(vertexData[i].Position - boundsCenter));
+    if(encoding == VERTEX_ENCODING_PACKED && !bonesFitPacked){
+        cout << "WARNING::MESH::PACKED_VERTEX::TOO_MANY_BONES, keeping the full format" << endl;
+        encoding = VERTEX_ENCODING_FULL;
+    }
     
-    // Bone IDs
-    // ----------
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_INT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+    // 2. positions are packed relative to the bounds, a flat axis keeps a unit scale
+    VertexEncodeContext context;
+    positionOffset = glm::vec3(0.0f);
+    positionScale = glm::vec3(1.0f);
+    if(encoding == VERTEX_ENCODING_PACKED){
+        positionOffset = (minimum + maximum) * 0.5f;
+        positionScale = (maximum - minimum) * 0.5f;
+        for(int axis = 0; axis < 3; axis++)
+            if(positionScale[axis] <= 0.0f)
+                positionScale[axis] = 1.0f;
+        context.positionOffset = positionOffset;
+        context.positionScale = positionScale;
+    }
     
-    // Bone weights
-    // ----------
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-    
-    glBindVertexArray(0);
-}
-
-//define texture: texture_categoryN(e.g. texture_diffuse1)
-void Mesh::draw(Shader &shader){
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr   = 1;
-    unsigned int heightNr   = 1;
-    
-    for(unsigned int i = 0; i < textures.size(); i++){
-        //active texture units
-        glActiveTexture(GL_TEXTURE0 + i);
-        
-        //get texture number
-        string number;
-        string name = textures[i].type;
-        
-        if(name == "texture_diffuse"){
-            number = std::to_string(diffuseNr++);
-        }
-        else if(name == "texture_specular"){
-            number = std::to_string(specularNr++);
-        }
-        else if(name == "texture_normal"){
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        }
-        else if(name == "texture_height"){
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-        }
-        
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // 3. the smallest format that holds them
+    if(encoding == VERTEX_ENCODING_PACKED){
+        if(hasBones)
+            setupMeshAs<PackedSkinnedVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
+        else if(hasTangents)
+            setupMeshAs<PackedTangentVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
+        else
+            setupMeshAs<PackedStaticVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
+    }
+    else{
+        if(hasBones)
+            setupMeshAs<SkinnedVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
+        else if(hasTangents)
+            setupMeshAs<TangentVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
+        else
+            setupMeshAs<StaticVertexFormat>(vertexData, vertexCount, indexData, indexCount, context);
     }
+}
+
+template<typename Format>
+void Mesh::setupMeshAs(const Vertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, const VertexEncodeContext &context){
+    // encoded through a small staging block instead of a converted copy of the whole mesh
+    const size_t chunkVertices = 4096;
+    setupBuffers(Format::layout(), nullptr, vertexCount * sizeof(typename Format::Vertex), indexData, indexCount);
+    vector<typename Format::Vertex> converted(min(vertexCount, chunkVertices));
+    for(size_t first = 0; first < vertexCount; first += chunkVertices){
+        size_t count = min(chunkVertices, vertexCount - first);
+        for(size_t i = 0; i < count; i++)
+            Format::encode(vertexData[first + i], context, converted[i]);
+        GeometryAllocator::instance().writeVertices(geometry.get(), first, converted.data(), count);
+    }
+}
+
+void Mesh::setupBuffers(const VertexLayout &vertexLayout, const void *vertexData, size_t vertexDataSize, const void *indexData, size_t indexCount){
+    this->layout = &vertexLayout;
+    this->vertexBytes = vertexDataSize;
+    this->indexCount = (unsigned int)indexCount;
     
+    // suballocated from the arena of the format, which shares one VAO between every mesh using it
+    geometry = GeometryHandle(GeometryAllocator::instance().allocate(vertexLayout, vertexData, vertexDataSize / vertexLayout.stride,
+                                                                     indexData, indexCount * indexTypeSize(indexType)));
+}
+
+void Mesh::releaseImportData(){
+    vector<Vertex>().swap(vertices);
+    vector<unsigned char>().swap(indexData);
+}
+
+size_t Mesh::getGpuBytes() const{
+    return vertexBytes + (size_t)indexCount * indexTypeSize(indexType);
+}
+
+void Mesh::restoreGeometry(const Vertex *vertexData, size_t vertexCount, const void *indexData){
+    if(!isResident())
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+}
+
+void Mesh::draw(Shader &shader, unsigned int lod){
+    bindMaterial(shader);
     
     //draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    const MeshLod &level = lods[min(lod, (unsigned int)lods.size() - 1)];
+    GeometryAllocator::instance().bindVertexArray(*layout);
+    glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType,
+                             (void*)(geometry->indexOffset + (size_t)level.firstIndex * indexTypeSize(indexType)), (GLint)geometry->baseVertex);
     
     glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::draw(Shader &shader, const GLsizei *counts, const void *const *offsets, GLsizei drawCount){
+    if(drawCount <= 0)
+        return;
+    bindMaterial(shader);
+    
+    multiDrawOffsets.resize(drawCount);
+    multiDrawBaseVertices.assign(drawCount, (GLint)geometry->baseVertex);
+    for(GLsizei i = 0; i < drawCount; i++)
+        multiDrawOffsets[i] = (const char*)offsets[i] + geometry->indexOffset;
+    
+    GeometryAllocator::instance().bindVertexArray(*layout);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, indexType, multiDrawOffsets.data(), drawCount, multiDrawBaseVertices.data());
+    
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::drawInstanced(Shader &shader, unsigned int lod, GLsizei instanceCount){
+    bindMaterial(shader);
     
+    const MeshLod &level = lods[min(lod, (unsigned int)lods.size() - 1)];
+    GeometryAllocator::instance().bindVertexArray(*layout);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType,
+                                      (void*)(geometry->indexOffset + (size_t)level.firstIndex * indexTypeSize(indexType)), instanceCount, (GLint)geometry->baseVertex);
+    
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::bindMaterial(Shader &shader) const{
+    material->bind(shader);
+    
+    // vertex decoding
+    shader.setBool("packedVertex"_u, layout->packed);
+    if(layout->packed){
+        shader.setVec3("positionOffset"_u, positionOffset);
+        shader.setVec3("positionScale"_u, positionScale);
+    }
+}
+
+void Mesh::setMaterial(const MaterialBlock &constants){
+    material = MaterialLibrary::shared().acquire(textures, constants);
 }
 #endif /* Mesh_h */
@@ -0,0 +1,241 @@
+#ifndef MeshCache_h
+#define MeshCache_h
+
+// MARK: - Library
+// -----------------
+// own library
+#include "Hash.h"
+
+// standard library
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// platform library
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// bump whenever the file layout or anything baked into it changes, stale caches are re-imported through Assimp
+#define MESH_CACHE_VERSION 7
+#define MESH_CACHE_MAGIC "BMMC"
+#define MESH_CACHE_EXTENSION ".bmcache"
+
+// MeshCacheHeader::importFlags
+#define MESH_CACHE_FLAG_OPTIMIZED 0x1u      // vertex cache, overdraw and fetch order applied at import
+#define MESH_CACHE_FLAG_WELDED 0x2u         // duplicated vertices merged at import (vertexWeldSettings)
+#define MESH_CACHE_FLAG_LODS 0x4u           // simplified levels appended to every index buffer (meshLodSettings)
+#define MESH_CACHE_FLAG_MESHLETS 0x8u       // LOD 0 clustered for culling (meshletSettings)
+
+// MARK: - Structure
+// ------------------
+// A cache file is written next to the source model (e.g. backpack.obj -> backpack.obj.bmcache):
+//   header | mesh records | texture records | node records | LOD records | meshlet records | dependency records | string table | vertex & index blobs
+// every offset is an absolute byte offset into the file and every section starts 8-byte aligned,
+// so the vertex and index arrays can be handed to OpenGL straight from the mapping.
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;        // FNV-1a of the source model file
+    uint64_t fileSize;          // guards against truncated writes
+    uint32_t vertexSize;        // sizeof(Vertex) at the time of writing
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t nodeCount;
+    uint32_t importFlags;       // MESH_CACHE_FLAG_*, must match the loading Model's options
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t dependencyCount;
+    uint64_t meshOffset;
+    uint64_t textureOffset;
+    uint64_t nodeOffset;
+    uint64_t lodOffset;
+    uint64_t meshletOffset;
+    uint64_t dependencyOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+};
+
+struct MeshCacheMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;      // range into the texture records
+    uint32_t textureCount;
+    uint32_t indexSize;         // 2 or 4 bytes per index
+    uint32_t firstLod;          // range into the LOD records, at least LOD 0
+    uint32_t lodCount;
+    uint32_t firstMeshlet;      // range into the meshlet records, empty for meshes drawn as a whole
+    uint32_t meshletCount;
+    float diffuseColor[4];      // MaterialBlock of the mesh's material
+    float specularColor[4];
+    float glossy;
+};
+
+struct MeshCacheLod {
+    uint32_t firstIndex;        // range of the mesh's index blob
+    uint32_t indexCount;
+    float error;
+    uint32_t padding;
+};
+
+struct MeshCacheMeshlet {
+    uint32_t firstIndex;        // range inside LOD 0
+    uint32_t indexCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+struct MeshCacheTexture {
+    uint32_t typeOffset;        // offsets into the string table
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// a file Assimp read besides the source model (.mtl of an OBJ, .bin of a glTF), the cache is stale once its contents change
+struct MeshCacheDependency {
+    uint32_t pathOffset;        // offset into the string table, the path as Assimp opened it
+    uint32_t pathLength;
+    uint64_t hash;              // FNV-1a of the file
+};
+
+struct MeshCacheNode {
+    int32_t parent;             // -1 for the root, parents always precede their children
+    uint32_t firstMesh;         // range into the mesh records
+    uint32_t meshCount;
+    uint32_t padding;
+    float transformation[16];   // column-major local transformation
+};
+
+// MARK: - Class
+// ------------------
+// read-only memory mapping of a whole file, falls back to reading it into memory where mmap is unavailable
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string &path);
+    void close();
+
+    const unsigned char* getData() const { return data; }
+    size_t getSize() const { return size; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    vector<unsigned char> buffer;
+#endif
+};
+
+// a dependency as Model keeps it
+struct MeshCacheSource {
+    string path;
+    uint64_t hash;
+
+    bool operator==(const MeshCacheSource &other) const { return hash == other.hash && path == other.path; }
+};
+
+// MARK: - Functions
+// -----------------
+bool hashFileContents(const string &path, uint64_t &hash);
+uint64_t alignCacheOffset(uint64_t offset);
+// the dependency records of a mapped cache whose header is in range, false if they do not fit the file or the string table
+bool readCacheDependencies(const unsigned char *base, uint64_t size, vector<MeshCacheSource> &dependencies);
+
+// MARK: - Function realization
+// --------------------
+bool MappedFile::open(const string &path){
+    close();
+#ifdef _WIN32
+    ifstream file(path, ios::binary | ios::ate);
+    if(!file)
+        return false;
+    buffer.resize((size_t)file.tellg());
+    file.seekg(0);
+    if(!buffer.empty() && !file.read((char*)buffer.data(), buffer.size()))
+        return false;
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size <= 0){
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // the mapping stays valid after the descriptor is closed
+    if(mapping == MAP_FAILED)
+        return false;
+
+    data = (const unsigned char*)mapping;
+    size = (size_t)info.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::close(){
+#ifdef _WIN32
+    buffer.clear();
+    buffer.shrink_to_fit();
+#else
+    if(data)
+        munmap((void*)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// 64-bit FNV-1a over the whole file, used to detect that a source model changed since the cache was written
+bool hashFileContents(const string &path, uint64_t &hash){
+    MappedFile file;
+    if(!file.open(path))
+        return false;
+    hash = hashBytes(file.getData(), file.getSize());
+    return true;
+}
+
+uint64_t alignCacheOffset(uint64_t offset){
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+bool readCacheDependencies(const unsigned char *base, uint64_t size, vector<MeshCacheSource> &dependencies){
+    const MeshCacheHeader *header = (const MeshCacheHeader*)base;
+    uint64_t bytes = (uint64_t)header->dependencyCount * sizeof(MeshCacheDependency);
+    if(header->dependencyOffset > size || bytes > size - header->dependencyOffset ||
+       header->stringOffset > size || header->stringSize > size - header->stringOffset)
+        return false;
+
+    const MeshCacheDependency *records = (const MeshCacheDependency*)(base + header->dependencyOffset);
+    const char *strings = (const char*)(base + header->stringOffset);
+    dependencies.clear();
+    for(uint32_t i = 0; i < header->dependencyCount; i++){
+        if((uint64_t)records[i].pathOffset + records[i].pathLength > header->stringSize)
+            return false;
+        dependencies.push_back(MeshCacheSource{ string(strings + records[i].pathOffset, records[i].pathLength), records[i].hash });
+    }
+    return true;
+}
+
+#endif /* MeshCache_h */
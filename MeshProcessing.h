@@ -0,0 +1,864 @@
+#ifndef MeshProcessing_h
+#define MeshProcessing_h
+
+// MARK: - Library
+// -----------------
+// own library
+#include "Hash.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// CPU geometry between import and upload, the import-time passes below work on it with 32-bit indices
+struct MeshGeometry {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<MeshLod> lods;               // ranges of indices, empty while the indices are a single level
+    vector<Meshlet> meshlets;           // clusters of LOD 0
+};
+
+// vertices closer than these per component are merged, 0 compares exactly; bone data always compares exactly
+struct VertexWeldSettings {
+    bool enabled = true;
+    float positionEpsilon = 0.0f;
+    float normalEpsilon = 1e-3f;        // normal, tangent and bitangent
+    float texCoordEpsilon = 1e-5f;
+};
+
+// import-time LOD chain and the draw-time selection thresholds
+struct MeshLodSettings {
+    bool enabled = true;
+    unsigned int levels = MAX_MESH_LODS - 1;    // built after LOD 0
+    float reduction = 0.5f;             // triangles of a level relative to the previous one
+    float maxError = 0.05f;             // largest deviation of any level, relative to the bounding radius
+    float pixelError = 1.0f;            // draw the coarsest level whose error projects below this many pixels
+    float hysteresis = 0.25f;           // a coarser level has to project below pixelError * (1 - hysteresis)
+};
+
+// clusters of LOD 0 for per-cluster culling in Model::draw
+struct MeshletSettings {
+    bool enabled = true;
+    unsigned int maxVertices = 64;
+    unsigned int maxTriangles = 124;
+    unsigned int minTriangles = 4096;   // smaller meshes are culled and drawn as a whole
+    bool culling = true;                // frustum and normal cone tests per cluster every draw
+};
+
+// post-transform cache behaviour of an index order on a FIFO cache, summable over meshes
+struct VertexCacheStatistics {
+    size_t triangles = 0;
+    size_t vertices = 0;                // distinct vertices referenced
+    size_t transformed = 0;             // vertex shader invocations (cache misses)
+
+    float acmr() const { return triangles ? (float)transformed / triangles : 0.0f; }     // per triangle, 0.5 is the ideal on large grids
+    float atvr() const { return vertices ? (float)transformed / vertices : 0.0f; }       // per vertex, 1.0 is the ideal
+    VertexCacheStatistics& operator+=(const VertexCacheStatistics &other);
+};
+
+// MARK: - Functions
+// -----------------
+// splits a triangle list into parts of at most maxVertices vertices each (so they fit 16-bit indices), keeping the triangle order
+// consumes geometry: moved as is when it already fits, freed once split
+vector<MeshGeometry> splitMeshGeometry(MeshGeometry &&geometry, size_t maxVertices = 65536);
+
+VertexWeldSettings& vertexWeldSettings();
+// merges duplicated vertices (hashed in parallel), rewrites the indices and keeps vertices in order of first occurrence,
+// returns the number of vertices removed
+size_t weldVertices(MeshGeometry &geometry, const VertexWeldSettings &settings);
+
+VertexCacheStatistics analyzeVertexCache(const MeshGeometry &geometry, unsigned int cacheSize = 16);
+// reorders triangles for the post-transform cache (Forsyth's linear-speed optimizer)
+void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount);
+void optimizeVertexCache(MeshGeometry &geometry);
+// reorders clusters of the cache-optimized order so outward facing ones draw first (Sander et al., Tipsify),
+// the ACMR of a cluster may grow by at most threshold
+void optimizeOverdraw(MeshGeometry &geometry, float threshold = 1.05f);
+// renumbers vertices in order of first use and drops unreferenced ones
+void optimizeVertexFetch(MeshGeometry &geometry);
+// the three passes in order
+void optimizeMeshGeometry(MeshGeometry &geometry);
+
+MeshLodSettings& meshLodSettings();
+// quadric edge collapse on the index buffer, the vertices stay as they are and collapse onto each other;
+// vertices on open borders and attribute seams never move. Stops at targetIndexCount or before a collapse
+// would exceed targetError (model units) and returns the reached error
+vector<unsigned int> simplifyIndices(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t targetIndexCount, float targetError, float &resultError);
+// appends coarser levels of geometry.indices (a single level) and fills geometry.lods, each level is cache optimized
+void buildMeshLods(MeshGeometry &geometry, const MeshLodSettings &settings);
+
+MeshletSettings& meshletSettings();
+// cuts LOD 0 into consecutive clusters in its (cache optimized, hence spatially coherent) triangle order,
+// so every meshlet is a plain index range, and computes their bounding spheres and normal cones
+void buildMeshlets(MeshGeometry &geometry, const MeshletSettings &settings);
+
+// MARK: - Function realization
+// --------------------
+vector<MeshGeometry> splitMeshGeometry(MeshGeometry &&geometry, size_t maxVertices){
+    vector<MeshGeometry> parts;
+    if(geometry.vertices.size() <= maxVertices || maxVertices < 3){
+        parts.push_back(move(geometry));
+        return parts;
+    }
+
+    vector<int> remap(geometry.vertices.size(), -1);     // source vertex -> index in the current part
+    vector<unsigned int> touched;                       // source vertices mapped by the current part, to reset remap
+    parts.push_back(MeshGeometry());
+    for(size_t i = 0; i + 2 < geometry.indices.size(); i += 3){
+        const unsigned int *triangle = &geometry.indices[i];
+        if(triangle[0] >= geometry.vertices.size() || triangle[1] >= geometry.vertices.size() || triangle[2] >= geometry.vertices.size())
+            continue;   // Mesh reports and drops these as well
+
+        size_t added = 0;
+        for(int j = 0; j < 3; j++)
+            if(remap[triangle[j]] < 0 && (j == 0 || triangle[j] != triangle[0]) && (j < 2 || triangle[2] != triangle[1]))
+                added++;
+
+        // start the next part when this triangle would not fit
+        if(parts.back().vertices.size() + added > maxVertices){
+            for(unsigned int vertex : touched)
+                remap[vertex] = -1;
+            touched.clear();
+            parts.push_back(MeshGeometry());
+        }
+
+        MeshGeometry &part = parts.back();
+        for(int j = 0; j < 3; j++){
+            if(remap[triangle[j]] < 0){
+                remap[triangle[j]] = (int)part.vertices.size();
+                part.vertices.push_back(geometry.vertices[triangle[j]]);
+                touched.push_back(triangle[j]);
+            }
+            part.indices.push_back((unsigned int)remap[triangle[j]]);
+        }
+    }
+    geometry = MeshGeometry();
+    return parts;
+}
+
+// MARK: - Welding
+// ----------------
+VertexWeldSettings& vertexWeldSettings(){
+    static VertexWeldSettings settings;
+    return settings;
+}
+
+// a component snapped to its epsilon cell, or its bit pattern when compared exactly (with -0 folded into 0)
+static int64_t quantizeWeldComponent(float value, float epsilon){
+    if(epsilon > 0.0f)
+        return (int64_t)floor((double)value / epsilon + 0.5);
+    if(value == 0.0f)
+        return 0;
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// calls visit for every quantized component, shared by hashing and comparison so both agree
+template<typename Visitor>
+static bool visitWeldKey(const Vertex &vertex, const VertexWeldSettings &settings, Visitor visit){
+    for(int i = 0; i < 3; i++)
+        if(!visit(quantizeWeldComponent(vertex.Position[i], settings.positionEpsilon)))
+            return false;
+    for(int i = 0; i < 3; i++)
+        if(!visit(quantizeWeldComponent(vertex.Normal[i], settings.normalEpsilon)) ||
+           !visit(quantizeWeldComponent(vertex.Tangent[i], settings.normalEpsilon)) ||
+           !visit(quantizeWeldComponent(vertex.Bitangent[i], settings.normalEpsilon)))
+            return false;
+    for(int i = 0; i < 2; i++)
+        if(!visit(quantizeWeldComponent(vertex.TexCoords[i], settings.texCoordEpsilon)))
+            return false;
+    for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        if(!visit(vertex.m_BoneIDs[i]) || !visit(quantizeWeldComponent(vertex.m_Weights[i], 0.0f)))
+            return false;
+    return true;
+}
+
+static uint64_t hashWeldKey(const Vertex &vertex, const VertexWeldSettings &settings){
+    uint64_t hash = HASH_SEED;
+    visitWeldKey(vertex, settings, [&hash](int64_t component){
+        hash = hashWord((uint64_t)component, hash);
+        return true;
+    });
+    // hashWord mixes fully, the top bits used for sharding depend on every component
+    return hash;
+}
+
+static bool equalWeldKeys(const Vertex &a, const Vertex &b, const VertexWeldSettings &settings){
+    int64_t components[3 * 4 + 2 + 2 * MAX_BONE_INFLUENCE];
+    size_t count = 0;
+    visitWeldKey(a, settings, [&](int64_t component){ components[count++] = component; return true; });
+    count = 0;
+    return visitWeldKey(b, settings, [&](int64_t component){ return components[count++] == component; });
+}
+
+size_t weldVertices(MeshGeometry &geometry, const VertexWeldSettings &settings){
+    const vector<Vertex> &vertices = geometry.vertices;
+    size_t vertexCount = vertices.size();
+    if(vertexCount < 2)
+        return 0;
+
+    // 1. hash every vertex
+    vector<uint64_t> hashes(vertexCount);
+    ThreadPool::shared().parallelFor(vertexCount, [&](size_t begin, size_t end){
+        for(size_t v = begin; v < end; v++)
+            hashes[v] = hashWeldKey(vertices[v], settings);
+    }, 4096);
+
+    // 2. bucket the vertices into shards by the top hash bits, keeping them in ascending order
+    const size_t shardCount = 64;
+    vector<size_t> shardOffset(shardCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v++)
+        shardOffset[(hashes[v] >> 58) + 1]++;
+    for(size_t shard = 0; shard < shardCount; shard++)
+        shardOffset[shard + 1] += shardOffset[shard];
+    vector<unsigned int> shardVertices(vertexCount);
+    vector<size_t> fill(shardOffset.begin(), shardOffset.end() - 1);
+    for(size_t v = 0; v < vertexCount; v++)
+        shardVertices[fill[hashes[v] >> 58]++] = (unsigned int)v;
+
+    // 3. every shard maps its vertices to the first equal one, so duplicates always point at a lower index
+    vector<unsigned int> representative(vertexCount);
+    ThreadPool::shared().parallelFor(shardCount, [&](size_t begin, size_t end){
+        for(size_t shard = begin; shard < end; shard++){
+            // open addressing over the shard's distinct vertices, linear probing
+            size_t count = shardOffset[shard + 1] - shardOffset[shard], capacity = 16;
+            while(capacity < count * 2)
+                capacity *= 2;
+            vector<unsigned int> table(capacity, UINT32_MAX);
+            for(size_t i = shardOffset[shard]; i < shardOffset[shard + 1]; i++){
+                unsigned int v = shardVertices[i];
+                size_t slot = (size_t)hashes[v] & (capacity - 1);
+                while(table[slot] != UINT32_MAX && (hashes[table[slot]] != hashes[v] || !equalWeldKeys(vertices[table[slot]], vertices[v], settings)))
+                    slot = (slot + 1) & (capacity - 1);
+                if(table[slot] == UINT32_MAX)
+                    table[slot] = v;
+                representative[v] = table[slot];
+            }
+        }
+    });
+
+    // 4. compact in order of first occurrence and rewrite the indices
+    vector<unsigned int> remap(vertexCount);
+    vector<Vertex> welded;
+    welded.reserve(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++){
+        if(representative[v] == v){
+            remap[v] = (unsigned int)welded.size();
+            welded.push_back(vertices[v]);
+        }
+        else
+            remap[v] = remap[representative[v]];
+    }
+    for(unsigned int &index : geometry.indices)
+        if(index < vertexCount)
+            index = remap[index];
+
+    size_t removed = vertexCount - welded.size();
+    geometry.vertices.swap(welded);
+    return removed;
+}
+
+// MARK: - Analysis
+// ----------------
+VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics &other){
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformed += other.transformed;
+    return *this;
+}
+
+// FIFO cache emulated with timestamps: a vertex is resident while fewer than cacheSize misses happened since it was loaded
+static unsigned int updateFifoCache(const unsigned int *triangle, unsigned int cacheSize, vector<unsigned int> &timestamps, unsigned int &timestamp){
+    unsigned int misses = 0;
+    for(int i = 0; i < 3; i++){
+        if(timestamp - timestamps[triangle[i]] > cacheSize){
+            timestamps[triangle[i]] = timestamp++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+VertexCacheStatistics analyzeVertexCache(const MeshGeometry &geometry, unsigned int cacheSize){
+    VertexCacheStatistics statistics;
+    vector<unsigned int> timestamps(geometry.vertices.size(), 0);
+    vector<bool> referenced(geometry.vertices.size(), false);
+    unsigned int timestamp = cacheSize + 1;
+
+    for(size_t i = 0; i + 2 < geometry.indices.size(); i += 3){
+        statistics.transformed += updateFifoCache(&geometry.indices[i], cacheSize, timestamps, timestamp);
+        statistics.triangles++;
+        for(int j = 0; j < 3; j++){
+            if(!referenced[geometry.indices[i + j]]){
+                referenced[geometry.indices[i + j]] = true;
+                statistics.vertices++;
+            }
+        }
+    }
+    return statistics;
+}
+
+// MARK: - Vertex cache
+// ---------------------
+// Forsyth's scoring: recently used vertices and vertices with few remaining triangles score high
+static const int FORSYTH_CACHE_SIZE = 32;
+static const int FORSYTH_MAX_VALENCE = 32;
+
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles){
+    static float cacheScores[FORSYTH_CACHE_SIZE];
+    static float valenceScores[FORSYTH_MAX_VALENCE];
+    static bool initialized = [](){
+        const float cacheDecayPower = 1.5f, lastTriangleScore = 0.75f;
+        const float valenceBoostScale = 2.0f, valenceBoostPower = 0.5f;
+        for(int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            cacheScores[i] = i < 3 ? lastTriangleScore : pow(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), cacheDecayPower);
+        valenceScores[0] = 0.0f;
+        for(int i = 1; i < FORSYTH_MAX_VALENCE; i++)
+            valenceScores[i] = valenceBoostScale * pow((float)i, -valenceBoostPower);
+        return true;
+    }();
+    (void)initialized;
+
+    if(remainingTriangles == 0)
+        return -1.0f;
+    float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+    return score + valenceScores[min(remainingTriangles, (unsigned int)FORSYTH_MAX_VALENCE - 1)];
+}
+
+void optimizeVertexCache(MeshGeometry &geometry){
+    optimizeVertexCache(geometry.indices, geometry.vertices.size());
+}
+
+void optimizeVertexCache(vector<unsigned int> &sourceIndices, size_t vertexCount){
+    const vector<unsigned int> &indices = sourceIndices;
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2)
+        return;
+
+    // 1. vertex -> triangle adjacency, the live part of each list shrinks as triangles are emitted
+    vector<unsigned int> remaining(vertexCount, 0), adjacencyOffset(vertexCount + 1, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+    for(size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    vector<unsigned int> adjacency(triangleCount * 3), fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    // 2. initial scores
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    vector<float> triangleScore(triangleCount);
+    vector<bool> emitted(triangleCount, false);
+    int best = 0;
+    for(size_t t = 0; t < triangleCount; t++){
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+        if(triangleScore[t] > triangleScore[best])
+            best = (int)t;
+    }
+
+    // 3. greedily emit the best triangle touching the cache
+    vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    vector<unsigned int> cache, nextCache;
+    size_t inputCursor = 0;
+    for(size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++){
+        if(best < 0){
+            // nothing in the cache has triangles left, continue with the next unused triangle in input order
+            while(emitted[inputCursor])
+                inputCursor++;
+            best = (int)inputCursor;
+        }
+        const unsigned int *triangle = &indices[3 * best];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for(int j = 0; j < 3; j++){
+            unsigned int v = triangle[j];
+            unsigned int *list = &adjacency[adjacencyOffset[v]];
+            for(unsigned int k = 0; k < remaining[v]; k++){
+                if(list[k] == (unsigned int)best){
+                    list[k] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front, the rest shift back and the tail falls out
+        nextCache.assign(triangle, triangle + 3);
+        for(unsigned int v : cache)
+            if(v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        for(size_t k = 0; k < nextCache.size(); k++){
+            unsigned int v = nextCache[k];
+            cachePosition[v] = k < (size_t)FORSYTH_CACHE_SIZE ? (int)k : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for(unsigned int v : nextCache){
+            const unsigned int *list = &adjacency[adjacencyOffset[v]];
+            for(unsigned int k = 0; k < remaining[v]; k++){
+                unsigned int t = list[k];
+                triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+                if(cachePosition[v] >= 0 && triangleScore[t] > bestScore){
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+        if(nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+    sourceIndices.swap(result);
+}
+
+// MARK: - Overdraw
+// -----------------
+void optimizeOverdraw(MeshGeometry &geometry, float threshold){
+    const unsigned int cacheSize = 16;
+    const vector<unsigned int> &indices = geometry.indices;
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2)
+        return;
+
+    // 1. hard boundaries: a triangle missing all three vertices starts a new patch of the surface
+    vector<unsigned int> timestamps(geometry.vertices.size(), 0);
+    unsigned int timestamp = cacheSize + 1;
+    vector<size_t> hardClusters;
+    for(size_t t = 0; t < triangleCount; t++)
+        if(updateFifoCache(&indices[3 * t], cacheSize, timestamps, timestamp) == 3 || t == 0)
+            hardClusters.push_back(t);
+
+    // 2. soft boundaries: split patches further as long as each piece stays within threshold of the patch ACMR
+    vector<size_t> clusters;
+    for(size_t c = 0; c < hardClusters.size(); c++){
+        size_t start = hardClusters[c], end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+
+        timestamp += cacheSize + 1;
+        size_t misses = 0;
+        for(size_t t = start; t < end; t++)
+            misses += updateFifoCache(&indices[3 * t], cacheSize, timestamps, timestamp);
+        float clusterThreshold = threshold * (float)misses / (float)(end - start);
+
+        size_t first = clusters.size();
+        clusters.push_back(start);
+        timestamp += cacheSize + 1;
+        size_t runningMisses = 0, runningTriangles = 0;
+        for(size_t t = start; t < end; t++){
+            runningMisses += updateFifoCache(&indices[3 * t], cacheSize, timestamps, timestamp);
+            runningTriangles++;
+            if((float)runningMisses / runningTriangles <= clusterThreshold && t + 1 < end){
+                clusters.push_back(t + 1);
+                timestamp += cacheSize + 1;
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+        // the tail never reached the target, it joins the previous piece
+        if(runningTriangles > 0 && clusters.size() > first + 1)
+            clusters.pop_back();
+    }
+
+    // 3. sort key: how far a cluster faces out of the mesh centre
+    glm::vec3 meshCentroid(0.0f);
+    for(const Vertex &vertex : geometry.vertices)
+        meshCentroid += vertex.Position;
+    meshCentroid = meshCentroid / (float)max<size_t>(geometry.vertices.size(), 1);
+
+    vector<float> sortKey(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++){
+        size_t start = clusters[c], end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 normal(0.0f), centroid(0.0f);
+        float area = 0.0f;
+        for(size_t t = start; t < end; t++){
+            const glm::vec3 &p0 = geometry.vertices[indices[3 * t]].Position;
+            const glm::vec3 &p1 = geometry.vertices[indices[3 * t + 1]].Position;
+            const glm::vec3 &p2 = geometry.vertices[indices[3 * t + 2]].Position;
+            glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);      // length is twice the area
+            float triangleArea = glm::length(areaNormal);
+            normal += areaNormal;
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        centroid = area > 0.0f ? centroid / area : centroid;
+        sortKey[c] = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+    }
+
+    // 4. outward facing clusters first, they occlude the rest
+    vector<size_t> order(clusters.size());
+    for(size_t c = 0; c < order.size(); c++)
+        order[c] = c;
+    stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b){ return sortKey[a] > sortKey[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(size_t c : order){
+        size_t start = clusters[c], end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + 3 * start, indices.begin() + 3 * end);
+    }
+    geometry.indices.swap(result);
+}
+
+// MARK: - Vertex fetch
+// ---------------------
+void optimizeVertexFetch(MeshGeometry &geometry){
+    vector<int> remap(geometry.vertices.size(), -1);
+    vector<Vertex> vertices;
+    vertices.reserve(geometry.vertices.size());
+    for(unsigned int &index : geometry.indices){
+        if(remap[index] < 0){
+            remap[index] = (int)vertices.size();
+            vertices.push_back(geometry.vertices[index]);
+        }
+        index = (unsigned int)remap[index];
+    }
+    geometry.vertices.swap(vertices);
+}
+
+void optimizeMeshGeometry(MeshGeometry &geometry){
+    optimizeVertexCache(geometry);
+    optimizeOverdraw(geometry);
+    optimizeVertexFetch(geometry);
+}
+
+// MARK: - Simplification
+// -----------------------
+MeshLodSettings& meshLodSettings(){
+    static MeshLodSettings settings;
+    return settings;
+}
+
+// sum of squared distances to weighted planes, as a symmetric 4x4 matrix
+struct SimplifyQuadric {
+    double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+    double weight = 0;
+
+    void addPlane(double a, double b, double c, double d, double w){
+        a2 += w * a * a; b2 += w * b * b; c2 += w * c * c; d2 += w * d * d;
+        ab += w * a * b; ac += w * a * c; ad += w * a * d;
+        bc += w * b * c; bd += w * b * d; cd += w * c * d;
+        weight += w;
+    }
+    SimplifyQuadric operator+(const SimplifyQuadric &o) const{
+        SimplifyQuadric q;
+        q.a2 = a2 + o.a2; q.b2 = b2 + o.b2; q.c2 = c2 + o.c2; q.d2 = d2 + o.d2;
+        q.ab = ab + o.ab; q.ac = ac + o.ac; q.ad = ad + o.ad;
+        q.bc = bc + o.bc; q.bd = bd + o.bd; q.cd = cd + o.cd;
+        q.weight = weight + o.weight;
+        return q;
+    }
+    // root mean squared distance of p to the planes
+    float error(const glm::vec3 &p) const{
+        if(weight <= 0.0)
+            return 0.0f;
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+                 + 2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+        return (float)sqrt(max(e / weight, 0.0));
+    }
+};
+
+// vertices that must not move: open or non-manifold edges and positions shared by several vertices (UV or normal seams)
+static vector<bool> findLockedVertices(const vector<Vertex> &vertices, const vector<unsigned int> &indices){
+    size_t vertexCount = vertices.size();
+
+    // 1. one id per distinct position
+    vector<unsigned int> order(vertexCount), positionId(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+        order[v] = (unsigned int)v;
+    auto less = [&vertices](unsigned int a, unsigned int b){
+        const glm::vec3 &p = vertices[a].Position, &q = vertices[b].Position;
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+    };
+    sort(order.begin(), order.end(), less);
+    for(size_t i = 0; i < vertexCount; i++)
+        positionId[order[i]] = i > 0 && !less(order[i - 1], order[i]) ? positionId[order[i - 1]] : order[i];
+
+    // 2. seams: more than one referenced vertex at a position
+    vector<bool> locked(vertexCount, false), used(vertexCount, false);
+    vector<unsigned int> wedges(vertexCount, 0);
+    for(unsigned int index : indices){
+        if(!used[index]){
+            used[index] = true;
+            wedges[positionId[index]]++;
+        }
+    }
+    for(size_t v = 0; v < vertexCount; v++)
+        locked[v] = wedges[positionId[v]] > 1;
+
+    // 3. borders: an edge between two positions not shared by exactly two triangles
+    vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for(size_t i = 0; i + 2 < indices.size(); i += 3){
+        for(int e = 0; e < 3; e++){
+            uint64_t a = positionId[indices[i + e]], b = positionId[indices[i + (e + 1) % 3]];
+            edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+        }
+    }
+    sort(edges.begin(), edges.end());
+    vector<bool> borderPosition(vertexCount, false);
+    for(size_t i = 0; i < edges.size();){
+        size_t j = i;
+        while(j < edges.size() && edges[j] == edges[i])
+            j++;
+        if(j - i != 2){
+            borderPosition[edges[i] >> 32] = true;
+            borderPosition[edges[i] & 0xffffffffu] = true;
+        }
+        i = j;
+    }
+    for(size_t v = 0; v < vertexCount; v++)
+        locked[v] = locked[v] || borderPosition[positionId[v]];
+    return locked;
+}
+
+static glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2){
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+vector<unsigned int> simplifyIndices(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t targetIndexCount, float targetError, float &resultError){
+    size_t vertexCount = vertices.size();
+    vector<unsigned int> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    resultError = 0.0f;
+    if(result.size() <= targetIndexCount)
+        return result;
+
+    // 1. per vertex quadrics of the planes around it, area weighted
+    vector<SimplifyQuadric> quadrics(vertexCount);
+    for(size_t i = 0; i < result.size(); i += 3){
+        const glm::vec3 &p0 = vertices[result[i]].Position, &p1 = vertices[result[i + 1]].Position, &p2 = vertices[result[i + 2]].Position;
+        glm::vec3 normal = triangleNormal(p0, p1, p2);
+        float length = glm::length(normal);
+        if(length <= 0.0f)
+            continue;
+        normal = normal / length;
+        SimplifyQuadric plane;
+        plane.addPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), length * 0.5f);
+        for(int j = 0; j < 3; j++)
+            quadrics[result[i + j]] = quadrics[result[i + j]] + plane;
+    }
+    vector<bool> locked = findLockedVertices(vertices, result);
+
+    struct Collapse {
+        unsigned int from, to;
+        float error;
+    };
+    size_t targetTriangles = targetIndexCount / 3;
+    vector<unsigned int> adjacencyOffset(vertexCount + 1), adjacency, remap(vertexCount);
+    vector<bool> touched(vertexCount);
+    vector<Collapse> collapses;
+
+    // 2. passes of independent collapses, cheapest first, until the target or the error bound stops them
+    while(result.size() / 3 > targetTriangles){
+        fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for(unsigned int index : result)
+            adjacencyOffset[index + 1]++;
+        for(size_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        adjacency.resize(result.size());
+        vector<unsigned int> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for(size_t i = 0; i < result.size(); i++)
+            adjacency[cursor[result[i]]++] = (unsigned int)(i / 3);
+
+        collapses.clear();
+        for(size_t i = 0; i < result.size(); i += 3){
+            for(int e = 0; e < 3; e++){
+                unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+                if(!locked[a])
+                    collapses.push_back({ a, b, (quadrics[a] + quadrics[b]).error(vertices[b].Position) });
+                if(!locked[b])
+                    collapses.push_back({ b, a, (quadrics[a] + quadrics[b]).error(vertices[a].Position) });
+            }
+        }
+        sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y){ return x.error < y.error; });
+
+        fill(touched.begin(), touched.end(), false);
+        for(size_t v = 0; v < vertexCount; v++)
+            remap[v] = (unsigned int)v;
+        size_t liveTriangles = result.size() / 3, collapsed = 0;
+        for(const Collapse &collapse : collapses){
+            if(collapse.error > targetError || liveTriangles <= targetTriangles)
+                break;
+            if(touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject collapses that fold a remaining triangle over
+            bool flips = false;
+            size_t removed = 0;
+            for(unsigned int k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1] && !flips; k++){
+                const unsigned int *triangle = &result[3 * adjacency[k]];
+                if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to){
+                    removed++;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for(int j = 0; j < 3; j++){
+                    before[j] = vertices[triangle[j]].Position;
+                    after[j] = triangle[j] == collapse.from ? vertices[collapse.to].Position : before[j];
+                }
+                flips = glm::dot(triangleNormal(before[0], before[1], before[2]), triangleNormal(after[0], after[1], after[2])) <= 0.0f;
+            }
+            if(flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] = quadrics[collapse.to] + quadrics[collapse.from];
+            for(unsigned int k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1]; k++)
+                for(int j = 0; j < 3; j++)
+                    touched[result[3 * adjacency[k] + j]] = true;
+            liveTriangles -= removed;
+            resultError = max(resultError, collapse.error);
+            collapsed++;
+        }
+        if(collapsed == 0)
+            break;
+
+        // 3. apply the pass and drop the triangles that collapsed
+        size_t write = 0;
+        for(size_t i = 0; i < result.size(); i += 3){
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+    return result;
+}
+
+void buildMeshLods(MeshGeometry &geometry, const MeshLodSettings &settings){
+    size_t baseCount = geometry.indices.size() / 3 * 3;
+    geometry.indices.resize(baseCount);
+    geometry.lods.assign(1, MeshLod{ 0, (unsigned int)baseCount, 0.0f });
+    if(geometry.vertices.empty() || baseCount == 0)
+        return;
+
+    glm::vec3 minimum = geometry.vertices[0].Position, maximum = minimum;
+    for(const Vertex &vertex : geometry.vertices){
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    float errorBudget = settings.maxError * glm::length(maximum - minimum) * 0.5f;
+
+    // every level is simplified from the previous one, its error bound is the sum of the steps
+    vector<unsigned int> previous(geometry.indices);
+    float previousError = 0.0f;
+    unsigned int levels = min(settings.levels, (unsigned int)MAX_MESH_LODS - 1);
+    for(unsigned int level = 0; level < levels; level++){
+        size_t target = (size_t)(previous.size() / 3 * settings.reduction) * 3;
+        if(target < 3 * 16 || previousError >= errorBudget)
+            break;
+        float stepError = 0.0f;
+        vector<unsigned int> simplified = simplifyIndices(geometry.vertices, previous, target, errorBudget - previousError, stepError);
+        if(simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+            break;      // seams and borders keep it from shrinking further
+
+        optimizeVertexCache(simplified, geometry.vertices.size());
+        previousError += stepError;
+        geometry.lods.push_back(MeshLod{ (unsigned int)geometry.indices.size(), (unsigned int)simplified.size(), previousError });
+        geometry.indices.insert(geometry.indices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+}
+
+// MARK: - Meshlets
+// -----------------
+MeshletSettings& meshletSettings(){
+    static MeshletSettings settings;
+    return settings;
+}
+
+static Meshlet computeMeshletBounds(const MeshGeometry &geometry, size_t firstIndex, size_t indexCount){
+    Meshlet meshlet;
+    meshlet.firstIndex = (unsigned int)firstIndex;
+    meshlet.indexCount = (unsigned int)indexCount;
+
+    // 1. sphere around the bounding box
+    const vector<Vertex> &vertices = geometry.vertices;
+    glm::vec3 minimum = vertices[geometry.indices[firstIndex]].Position, maximum = minimum;
+    for(size_t i = firstIndex; i < firstIndex + indexCount; i++){
+        minimum = glm::min(minimum, vertices[geometry.indices[i]].Position);
+        maximum = glm::max(maximum, vertices[geometry.indices[i]].Position);
+    }
+    meshlet.center = (minimum + maximum) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(size_t i = firstIndex; i < firstIndex + indexCount; i++)
+        meshlet.radius = max(meshlet.radius, glm::length(vertices[geometry.indices[i]].Position - meshlet.center));
+
+    // 2. cone around the face normals, sin of its half angle is the cutoff
+    glm::vec3 axis(0.0f);
+    vector<glm::vec3> normals;
+    normals.reserve(indexCount / 3);
+    for(size_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3){
+        glm::vec3 normal = triangleNormal(vertices[geometry.indices[i]].Position, vertices[geometry.indices[i + 1]].Position, vertices[geometry.indices[i + 2]].Position);
+        float length = glm::length(normal);
+        if(length <= 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+    float axisLength = glm::length(axis);
+    float minimumDot = 1.0f;
+    axis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    for(const glm::vec3 &normal : normals)
+        minimumDot = min(minimumDot, glm::dot(normal, axis));
+    meshlet.coneAxis = axis;
+    // a cone wider than about 84 degrees culls next to nothing, 1 never culls
+    meshlet.coneCutoff = normals.empty() || minimumDot <= 0.1f ? 1.0f : sqrt(1.0f - minimumDot * minimumDot);
+    return meshlet;
+}
+
+void buildMeshlets(MeshGeometry &geometry, const MeshletSettings &settings){
+    geometry.meshlets.clear();
+    size_t first = geometry.lods.empty() ? 0 : geometry.lods[0].firstIndex;
+    size_t count = geometry.lods.empty() ? geometry.indices.size() / 3 * 3 : geometry.lods[0].indexCount;
+    if(count / 3 < settings.minTriangles || settings.maxVertices < 3 || settings.maxTriangles < 1)
+        return;
+
+    vector<unsigned int> owner(geometry.vertices.size(), UINT32_MAX);     // meshlet that last used the vertex
+    unsigned int current = 0;
+    size_t start = first, vertexCount = 0;
+    for(size_t i = first; i < first + count; i += 3){
+        const unsigned int *triangle = &geometry.indices[i];
+        size_t added = 0;
+        for(int j = 0; j < 3; j++)
+            if(owner[triangle[j]] != current && (j == 0 || triangle[j] != triangle[0]) && (j < 2 || triangle[2] != triangle[1]))
+                added++;
+
+        if(vertexCount + added > settings.maxVertices || (i - start) / 3 >= settings.maxTriangles){
+            geometry.meshlets.push_back(computeMeshletBounds(geometry, start, i - start));
+            current++;
+            start = i;
+            vertexCount = 0;
+            added = 0;
+            for(int j = 0; j < 3; j++)
+                if((j == 0 || triangle[j] != triangle[0]) && (j < 2 || triangle[2] != triangle[1]))
+                    added++;
+        }
+        for(int j = 0; j < 3; j++)
+            owner[triangle[j]] = current;
+        vertexCount += added;
+    }
+    geometry.meshlets.push_back(computeMeshletBounds(geometry, start, first + count - start));
+}
+
+#endif /* MeshProcessing_h */
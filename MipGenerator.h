@@ -0,0 +1,289 @@
+#ifndef MipGenerator_h
+#define MipGenerator_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "KtxFile.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+// standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+enum MipFilter {
+    MIP_FILTER_BOX,             // 2x2 average (3 taps along odd sizes), cheapest
+    MIP_FILTER_KAISER           // windowed sinc, keeps detail without aliasing
+};
+
+struct MipGenerationSettings {
+    bool enabled = true;                    // build the chain on the CPU instead of glGenerateMipmap
+    MipFilter filter = MIP_FILTER_KAISER;
+    bool persist = true;                    // write the chain to <image>.ktx so the next run skips decoding and filtering
+};
+
+// MARK: - Functions
+// -----------------
+MipGenerationSettings& mipGenerationSettings();
+// full chain of an 8-bit image down to 1x1 as an uncompressed KtxImage (rows padded to 4 bytes),
+// srgb filters the color channels in linear space (diffuse maps), alpha is always linear
+bool generateMipChain(const unsigned char *pixels, int width, int height, int components, MipFilter filter, bool srgb, KtxImage &chain);
+
+// MARK: - Function realization
+// --------------------
+MipGenerationSettings& mipGenerationSettings(){
+    static MipGenerationSettings settings;
+    return settings;
+}
+
+static const float* srgbToLinearTable(){
+    static float table[256];
+    static bool initialized = [](){
+        for(int i = 0; i < 256; i++){
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+// linear [0, 1] sampled at 4096 steps, fine enough for 8-bit output
+static const unsigned char* linearToSrgbTable(){
+    static unsigned char table[4096];
+    static bool initialized = [](){
+        for(int i = 0; i < 4096; i++){
+            float l = i / 4095.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * pow(l, 1.0f / 2.4f) - 0.055f;
+            table[i] = (unsigned char)(clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+static size_t mipRowPitch(int width, int components){
+    return ((size_t)width * components + 3) & ~(size_t)3;
+}
+
+// 8-bit pixels to interleaved RGBA floats, missing channels read as GL samples them (0, 0, 1)
+static vector<float> unpackMipLevel(const unsigned char *pixels, int width, int height, int components, bool srgb){
+    const float *toLinear = srgbToLinearTable();
+    vector<float> result((size_t)width * height * 4);
+    for(size_t i = 0; i < (size_t)width * height; i++){
+        float *out = &result[4 * i];
+        const unsigned char *in = pixels + i * components;
+        for(int c = 0; c < 4; c++){
+            if(c >= components)
+                out[c] = c == 3 ? 1.0f : 0.0f;
+            else if(srgb && c < 3)
+                out[c] = toLinear[in[c]];
+            else
+                out[c] = in[c] / 255.0f;
+        }
+    }
+    return result;
+}
+
+static void packMipLevel(const vector<float> &level, int width, int height, int components, bool srgb, vector<unsigned char> &output){
+    const unsigned char *toSrgb = linearToSrgbTable();
+    size_t pitch = mipRowPitch(width, components);
+    output.assign(pitch * height, 0);
+    for(int y = 0; y < height; y++){
+        unsigned char *row = &output[pitch * y];
+        for(int x = 0; x < width; x++){
+            const float *in = &level[((size_t)y * width + x) * 4];
+            for(int c = 0; c < components; c++){
+                float v = clamp(in[c], 0.0f, 1.0f);
+                row[x * components + c] = (srgb && c < 3) ? toSrgb[(int)(v * 4095.0f + 0.5f)] : (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+// one axis of the box filter: (0.5, 0.5) over 2x, 2x + 1 for even sizes, (0.25, 0.5, 0.25) over 2x .. 2x + 2 for odd ones,
+// so the last row and column of an odd level are filtered in instead of dropped
+struct MipBoxTaps {
+    int index[3];
+    float weight[3];
+    int count;
+};
+
+static MipBoxTaps buildBoxTaps(int destination, int sourceSize){
+    bool odd = sourceSize > 1 && sourceSize % 2 == 1;
+    MipBoxTaps taps;
+    taps.count = odd ? 3 : 2;
+    for(int k = 0; k < taps.count; k++){
+        taps.index[k] = min(2 * destination + k, sourceSize - 1);
+        taps.weight[k] = odd && k != 1 ? 0.25f : 0.5f;
+    }
+    return taps;
+}
+
+static vector<float> downsampleBox(const vector<float> &source, int width, int height){
+    int nextWidth = max(1, width / 2), nextHeight = max(1, height / 2);
+    vector<float> result((size_t)nextWidth * nextHeight * 4);
+    vector<MipBoxTaps> horizontal(nextWidth);
+    for(int x = 0; x < nextWidth; x++)
+        horizontal[x] = buildBoxTaps(x, width);
+
+    ThreadPool::shared().parallelFor((size_t)nextHeight, [&](size_t begin, size_t end){
+        for(size_t y = begin; y < end; y++){
+            MipBoxTaps vertical = buildBoxTaps((int)y, height);
+            for(int x = 0; x < nextWidth; x++){
+                const MipBoxTaps &columns = horizontal[x];
+                Float4 sum = Float4::splat(0.0f);
+                for(int i = 0; i < vertical.count; i++){
+                    const float *sourceRow = &source[(size_t)vertical.index[i] * width * 4];
+                    for(int j = 0; j < columns.count; j++)
+                        sum = sum + Float4::load(&sourceRow[(size_t)columns.index[j] * 4]) * Float4::splat(vertical.weight[i] * columns.weight[j]);
+                }
+                sum.store(&result[((size_t)y * nextWidth + x) * 4]);
+            }
+        }
+    }, 16);
+    return result;
+}
+
+// MARK: - Kaiser filter
+// ----------------------
+static double besselI0(double x){
+    double sum = 1.0, term = 1.0, quarterSquare = x * x / 4.0;
+    for(int k = 1; k < 32 && term > sum * 1e-12; k++){
+        term *= quarterSquare / (k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// sinc windowed by a Kaiser window, x in destination pixels
+static float kaiserSinc(float x, float radius, float alpha){
+    if(fabs(x) >= radius)
+        return 0.0f;
+    float sinc = fabs(x) < 1e-6f ? 1.0f : sin(3.14159265f * x) / (3.14159265f * x);
+    float t = x / radius;
+    return sinc * (float)(besselI0(alpha * sqrt(1.0 - t * t)) / besselI0(alpha));
+}
+
+struct MipFilterTaps {
+    vector<int> first;          // first source texel of every destination texel (may be negative, sampling wraps)
+    vector<float> weights;      // tapCount weights per destination texel, normalized
+    int tapCount;
+};
+
+// one axis of the downsample, sampling wraps like GL_REPEAT
+static MipFilterTaps buildKaiserTaps(int sourceSize, int destinationSize){
+    const float radius = 2.0f, alpha = 4.0f;
+    float scale = (float)sourceSize / destinationSize;
+
+    MipFilterTaps taps;
+    taps.tapCount = (int)ceil(2.0f * radius * scale) + 1;
+    taps.first.resize(destinationSize);
+    taps.weights.resize((size_t)destinationSize * taps.tapCount);
+    for(int j = 0; j < destinationSize; j++){
+        float center = (j + 0.5f) * scale;
+        int first = (int)floor(center - radius * scale);
+        float sum = 0.0f;
+        float *weights = &taps.weights[(size_t)j * taps.tapCount];
+        for(int k = 0; k < taps.tapCount; k++){
+            weights[k] = kaiserSinc((first + k + 0.5f - center) / scale, radius, alpha);
+            sum += weights[k];
+        }
+        for(int k = 0; k < taps.tapCount; k++)
+            weights[k] /= sum;
+        taps.first[j] = first;
+    }
+    return taps;
+}
+
+static vector<float> downsampleKaiser(const vector<float> &source, int width, int height){
+    int nextWidth = max(1, width / 2), nextHeight = max(1, height / 2);
+    MipFilterTaps horizontal = buildKaiserTaps(width, nextWidth);
+    MipFilterTaps vertical = buildKaiserTaps(height, nextHeight);
+
+    // 1. horizontal pass, one RGBA texel per Float4
+    vector<float> rows((size_t)nextWidth * height * 4);
+    ThreadPool::shared().parallelFor((size_t)height, [&](size_t begin, size_t end){
+        for(size_t y = begin; y < end; y++){
+            const float *sourceRow = &source[y * width * 4];
+            for(int x = 0; x < nextWidth; x++){
+                const float *weights = &horizontal.weights[(size_t)x * horizontal.tapCount];
+                Float4 sum = Float4::splat(0.0f);
+                for(int k = 0; k < horizontal.tapCount; k++){
+                    int sx = ((horizontal.first[x] + k) % width + width) % width;
+                    sum = sum + Float4::load(sourceRow + sx * 4) * Float4::splat(weights[k]);
+                }
+                sum.store(&rows[(y * nextWidth + x) * 4]);
+            }
+        }
+    }, 16);
+
+    // 2. vertical pass
+    vector<float> result((size_t)nextWidth * nextHeight * 4);
+    ThreadPool::shared().parallelFor((size_t)nextHeight, [&](size_t begin, size_t end){
+        for(size_t y = begin; y < end; y++){
+            const float *weights = &vertical.weights[y * vertical.tapCount];
+            float *destinationRow = &result[y * nextWidth * 4];
+            for(int k = 0; k < vertical.tapCount; k++){
+                int sy = ((vertical.first[y] + k) % height + height) % height;
+                const float *sourceRow = &rows[(size_t)sy * nextWidth * 4];
+                Float4 weight = Float4::splat(weights[k]);
+                for(int x = 0; x < nextWidth; x++){
+                    Float4 accumulated = k == 0 ? Float4::splat(0.0f) : Float4::load(destinationRow + x * 4);
+                    (accumulated + Float4::load(sourceRow + x * 4) * weight).store(destinationRow + x * 4);
+                }
+            }
+        }
+    }, 16);
+    return result;
+}
+
+// MARK: - Chain
+// --------------
+bool generateMipChain(const unsigned char *pixels, int width, int height, int components, MipFilter filter, bool srgb, KtxImage &chain){
+    if(!pixels || width <= 0 || height <= 0 || components < 1 || components > 4)
+        return false;
+
+    static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum sizedFormats[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    chain = KtxImage();
+    chain.glType = GL_UNSIGNED_BYTE;
+    chain.glTypeSize = 1;
+    chain.glFormat = formats[components - 1];
+    chain.glInternalFormat = sizedFormats[components - 1];
+    chain.glBaseInternalFormat = formats[components - 1];
+    chain.width = (uint32_t)width;
+    chain.height = (uint32_t)height;
+
+    // level 0 is the source itself, rows padded to 4 bytes
+    size_t pitch = mipRowPitch(width, components);
+    chain.levels.push_back(vector<unsigned char>(pitch * height, 0));
+    for(int y = 0; y < height; y++)
+        memcpy(&chain.levels[0][pitch * y], pixels + (size_t)y * width * components, (size_t)width * components);
+
+    // every level is filtered from the previous one kept in float, so rounding does not accumulate
+    vector<float> level = unpackMipLevel(pixels, width, height, components, srgb);
+    while(width > 1 || height > 1){
+        level = filter == MIP_FILTER_KAISER ? downsampleKaiser(level, width, height) : downsampleBox(level, width, height);
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+        chain.levels.push_back(vector<unsigned char>());
+        packMipLevel(level, width, height, components, srgb, chain.levels.back());
+    }
+    return true;
+}
+
+#endif /* MipGenerator_h */
@@ -15,70 +15,424 @@
 // glm library
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
 
 // other library
 #include "stb_image.h"
 #include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 // own library
 #include "Shader.h"
+#include "BatchRenderer.h"
+#include "RenderQueue.h"
+#include "Camera.h"
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshProcessing.h"
+#include "ResidencyManager.h"
+#include "SceneGraph.h"
+#include "TextureArray.h"
+#include "TextureLoader.h"
+#include "TextureRegistry.h"
 
 // standard library
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 // MARK: - Functions
 // -----------------
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// MARK: - Structure
+// -----------------
+// flattened copy of the aiNode hierarchy, stored parent-before-child
+struct ModelNode {
+    int parent;                     // index into Model::nodes, -1 for the root
+    glm::mat4 transformation;       // aiNode::mTransformation, relative to the parent
+    unsigned int firstMesh;         // the meshes of a node are stored contiguously in Model::meshes
+    unsigned int meshCount;
+};
+
+// what the last culling, LOD-selecting draw of a model submitted, for profiling
+struct ModelDrawStatistics {
+    size_t drawnTriangles = 0;
+    size_t fullTriangles = 0;           // what LOD 0 of every mesh without culling would have drawn
+    unsigned int meshesPerLod[MAX_MESH_LODS] = {};
+    unsigned int culledMeshes = 0;      // bounding sphere outside the frustum
+    size_t clusters = 0;                // meshlets tested (LOD 0 of clustered meshes)
+    size_t frustumCulledClusters = 0;
+    size_t backfaceCulledClusters = 0;  // rejected by their normal cone
+    size_t multiDrawRanges = 0;         // index ranges left after merging neighbouring visible meshlets
+    unsigned int drawCalls = 0;         // 0 when queued into a BatchRenderer or RenderQueue, see their statistics
+    size_t instances = 0;               // drawInstanced only
+};
 
 // MARK: - Class
 // -----------------
+// the default file access of Assimp, noting every file an import opens (the model and e.g. its .mtl or .bin)
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    explicit RecordingIOSystem(vector<string> &opened) : opened(opened) {}
+
+    using Assimp::DefaultIOSystem::Open;
+    Assimp::IOStream* Open(const char *file, const char *mode = "rb") override {
+        Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
+        if(stream && find(opened.begin(), opened.end(), file) == opened.end())
+            opened.push_back(file);
+        return stream;
+    }
+
+private:
+    vector<string> &opened;
+};
+
 class Model {
 public:
     // Functions
     // ------------
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma){
+    // VERTEX_ENCODING_PACKED quantizes the vertex buffers (about a quarter of the memory), the cache keeps full vertices either way
+    // optimize reorders triangles and vertices at import (vertex cache, overdraw, fetch), the cache keeps the optimized order
+    Model(string const &path, bool gamma = false, VertexEncoding encoding = VERTEX_ENCODING_FULL, bool optimize = true) : gammaCorrection(gamma), vertexEncoding(encoding), optimizeMeshes(optimize){
         loadModel(path);
     }
-    void draw(Shader &shader);
+    // releases this model's references on the shared textures and its residency entries
+    ~Model();
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    // both draws set the shader's model and normalMatrix per node: model placed by the node hierarchy of the file
+    // every mesh at LOD 0
+    void draw(Shader &shader, const glm::mat4 &model = glm::mat4(1.0f));
+    // meshes outside the frustum are skipped, the rest draw at the coarsest LOD whose error stays below
+    // meshLodSettings().pixelError on screen; at LOD 0 clustered meshes also cull their meshlets (meshletSettings().culling)
+    // projection is the matrix the shader uses, viewportHeight in pixels
+    void draw(Shader &shader, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight);
+    // the same culling and LOD selection, the visible ranges are queued into batch instead of drawn (one record per mesh)
+    void submit(BatchRenderer &batch, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight);
+    // the same again into a render queue, drawn with shader in the queue's key order (one transform per node)
+    void submit(RenderQueue &queue, Shader &shader, RenderPass pass, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight);
+    // every instance at one LOD with one glDrawElementsInstancedBaseVertex per mesh, the shader's instanced path
+    // applies InstanceData::model on top of the node matrices (no culling or LOD selection per instance)
+    void drawInstanced(Shader &shader, const InstanceData *instances, size_t instanceCount, unsigned int lod = 0);
+    // node 0 places the model, node i + 1 is nodes[i] of the file; animate through setLocalTransform
+    SceneGraph& getSceneGraph() { return sceneGraph; }
+    const ModelDrawStatistics& getDrawStatistics() const { return drawStatistics; }
+    const vector<unsigned int>& getSelectedLods() const { return selectedLods; }
     
 private:
     // Properties
     // ------------
     vector<Mesh> meshes;
+    vector<ModelNode> nodes;
+    SceneGraph sceneGraph;
+    vector<unsigned int> meshNodes;     // scene graph node of every mesh
     string directory;
-    vector<Texture> textures_loaded;    // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    unordered_map<string, unsigned int> textures_loaded;    // material path -> texture referenced by this model, each holds one reference in the TextureRegistry
+    vector<Texture> textures_pending;   // textures missed in the TextureRegistry, loaded in one batch after import
+    vector<GpuTexture> textureArrays;   // the model's packed textures (textureArraySettings()), never evicted
     bool gammaCorrection;
+    VertexEncoding vertexEncoding;
+    bool optimizeMeshes;
+    VertexCacheStatistics cacheBefore;  // summed over the meshes of one import
+    VertexCacheStatistics cacheAfter;
+    vector<unsigned int> selectedLods;  // per mesh, kept between draws for the hysteresis
+    ModelDrawStatistics drawStatistics;
+    vector<GLsizei> drawCounts;         // multi-draw scratch, reused every draw
+    vector<const void*> drawOffsets;
+    string cacheFilePath;               // the .bmcache evicted meshes are reloaded from
+    uint64_t cacheSourceHash = 0;
+    vector<MeshCacheSource> cacheDependencies;  // the other files the import read, part of the cache's validity
+    vector<MeshCacheMesh> cacheRecords; // per mesh, empty when no cache matches the meshes
+    vector<unsigned int> meshResidency; // ResidencyManager id per mesh, 0 for meshes that cannot be reloaded
     
     // Functions
     // -----------
     void loadModel(string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    void processNode(aiNode* node, const aiScene* scene, int parent);
+    void processMesh(aiMesh* mesh, const aiScene* scene);
+    void processBones(aiMesh* mesh, vector<Vertex> &vertices);
     vector<Texture> loadMaterialTextures(aiMaterial *material, aiTextureType textureType, string typeName);
+    static MaterialBlock loadMaterialConstants(const aiMaterial *material);
+    Texture loadTexture(const string &path, const string &typeName);
+    void loadPendingTextures(const string &name);
+    // copies the model's 2D textures into texture arrays and points the materials at the layers
+    void packTextureArrays(const string &name);
+    void printIndexReport(const string &name) const;
+    void printOptimizationReport(const string &name) const;
+    void printLodReport(const string &name) const;
+    void printMeshletReport(const string &name) const;
+    uint32_t cacheImportFlags() const;
+    
+    void buildSceneGraph();
+    // moves node 0 to model if it changed and updates the world matrices
+    void placeModel(const glm::mat4 &model);
+    // the culling draw, draws with shader, queues into batch or queues into queue with shader (the unused ones are nullptr)
+    void drawVisible(Shader *shader, BatchRenderer *batch, RenderQueue *queue, RenderPass pass, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight);
+    
+    // residency: meshes with a CPU copy or a matching cache can be evicted, drawing makes them and their textures resident again
+    void trackResidency();
+    bool reloadMesh(unsigned int index);
+    bool makeResident(unsigned int index);
+    
+    // binary mesh cache
+    bool loadFromCache(const string &cachePath, uint64_t sourceHash);
+    bool writeCache(const string &cachePath, uint64_t sourceHash);
     
 };
 
 // MARK: - Function realization
 // -------------------
-void Model::draw(Shader &shader)
+Model::~Model()
+{
+    for(const pair<const string, unsigned int> &texture : textures_loaded)
+        TextureRegistry::instance().release(texture.second);
+    for(unsigned int id : meshResidency)
+        ResidencyManager::instance().untrack(id);
+    // the meshes give their geometry ranges back themselves, through the GpuDeletionQueue
+}
+
+void Model::draw(Shader &shader, const glm::mat4 &model)
 {
-    for(unsigned int i = 0; i < meshes.size(); i++)
+    placeModel(model);
+    // meshes of one vertex format share a VAO, it is only bound when the format changes
+    GeometryAllocator::instance().invalidateBinding();
+    unsigned int currentNode = UINT32_MAX;
+    for(unsigned int i = 0; i < meshes.size(); i++){
+        if(!makeResident(i))
+            continue;
+        if(meshNodes[i] != currentNode){
+            currentNode = meshNodes[i];
+            shader.setMat4("model"_u, sceneGraph.getWorldMatrix(currentNode));
+            shader.setMat3("normalMatrix"_u, sceneGraph.getNormalMatrix(currentNode));
+        }
         meshes[i].draw(shader);
+    }
+    glBindVertexArray(0);
+    GeometryAllocator::instance().invalidateBinding();
+}
+
+void Model::draw(Shader &shader, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight)
+{
+    drawVisible(&shader, nullptr, nullptr, RENDER_PASS_OPAQUE, camera, model, projection, viewportHeight);
+}
+
+void Model::submit(BatchRenderer &batch, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight)
+{
+    drawVisible(nullptr, &batch, nullptr, RENDER_PASS_OPAQUE, camera, model, projection, viewportHeight);
+}
+
+void Model::submit(RenderQueue &queue, Shader &shader, RenderPass pass, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight)
+{
+    drawVisible(&shader, nullptr, &queue, pass, camera, model, projection, viewportHeight);
+}
+
+void Model::drawVisible(Shader *shader, BatchRenderer *batch, RenderQueue *queue, RenderPass pass, const Camera &camera, const glm::mat4 &model, const glm::mat4 &projection, float viewportHeight)
+{
+    const MeshLodSettings &settings = meshLodSettings();
+    const bool culling = meshletSettings().culling;
+    float pixelsAtUnitDistance = viewportHeight / (2.0f * tan(glm::radians(camera.Zoom) * 0.5f));
+    glm::mat4 viewProjection = projection * camera.getViewMatrix();
+    placeModel(model);
+    const bool immediate = !batch && !queue;
+
+    // per node: frustum planes in mesh space (Gribb/Hartmann), normalized so they give distances in mesh units
+    unsigned int currentNode = UINT32_MAX;
+    glm::mat4 world(1.0f);
+    glm::vec4 planes[6];
+    glm::vec3 eye(0.0f);
+    float scale = 1.0f;
+    bool coneCulling = false;
+    unsigned int transform = 0;
+    auto enterNode = [&](unsigned int node){
+        currentNode = node;
+        world = sceneGraph.getWorldMatrix(node);
+        glm::vec3 axisScale(glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])));
+        scale = max(axisScale.x, max(axisScale.y, axisScale.z));
+        glm::mat4 clip = viewProjection * world;
+        for(int i = 0; i < 3; i++){
+            glm::vec4 row(clip[0][i], clip[1][i], clip[2][i], clip[3][i]), w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+            planes[2 * i] = w + row;
+            planes[2 * i + 1] = w - row;
+        }
+        for(glm::vec4 &plane : planes)
+            plane = plane / glm::length(glm::vec3(plane));
+        // the cone test needs mesh space angles, so only under uniform scale
+        eye = glm::vec3(glm::inverse(world) * glm::vec4(camera.Position, 1.0f));
+        coneCulling = max(axisScale.x, max(axisScale.y, axisScale.z)) <= min(axisScale.x, min(axisScale.y, axisScale.z)) * 1.001f;
+        if(queue)
+            transform = queue->addTransform(world, sceneGraph.getNormalMatrix(node));
+        else if(immediate){
+            shader->setMat4("model"_u, world);
+            shader->setMat3("normalMatrix"_u, sceneGraph.getNormalMatrix(node));
+        }
+    };
+    auto inFrustum = [&planes](const glm::vec3 &center, float radius){
+        for(const glm::vec4 &plane : planes)
+            if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    };
+
+    selectedLods.resize(meshes.size(), 0);
+    drawStatistics = ModelDrawStatistics();
+    GeometryAllocator::instance().invalidateBinding();
+    for(unsigned int i = 0; i < meshes.size(); i++){
+        Mesh &mesh = meshes[i];
+        drawStatistics.fullTriangles += mesh.lods[0].indexCount / 3;
+        if(meshNodes[i] != currentNode)
+            enterNode(meshNodes[i]);
+        if(culling && mesh.boundsRadius > 0.0f && !inFrustum(mesh.boundsCenter, mesh.boundsRadius)){
+            drawStatistics.culledMeshes++;
+            continue;
+        }
+        if(!makeResident(i))
+            continue;
+
+        glm::vec3 center = glm::vec3(world * glm::vec4(mesh.boundsCenter, 1.0f));
+        float distance = glm::length(center - camera.Position) - mesh.boundsRadius * scale;
+
+        // screen pixels per model unit at the nearest point of the bounding sphere, the camera inside it keeps LOD 0
+        unsigned int lod = 0;
+        if(distance > 0.0f && mesh.boundsRadius > 0.0f){
+            float pixelsPerUnit = scale * pixelsAtUnitDistance / distance;
+            unsigned int current = min(selectedLods[i], (unsigned int)mesh.lods.size() - 1);
+            for(unsigned int level = 1; level < mesh.lods.size(); level++){
+                float threshold = level > current ? settings.pixelError * (1.0f - settings.hysteresis) : settings.pixelError;
+                if(mesh.lods[level].error * pixelsPerUnit > threshold)
+                    break;
+                lod = level;
+            }
+        }
+        selectedLods[i] = lod;
+        drawStatistics.meshesPerLod[lod]++;
+        unsigned int record = batch ? batch->addRecord(mesh, world, sceneGraph.getNormalMatrix(currentNode)) : 0;
+
+        if(lod > 0 || !culling || mesh.meshlets.empty()){
+            drawStatistics.drawnTriangles += mesh.lods[lod].indexCount / 3;
+            if(batch)
+                batch->addDraw(mesh, record, mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount);
+            else if(queue)
+                queue->submit(pass, *shader, mesh, transform, mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount);
+            else{
+                drawStatistics.drawCalls++;
+                mesh.draw(*shader, lod);
+            }
+            continue;
+        }
+
+        // LOD 0 of a clustered mesh: the visible meshlets, neighbouring ranges merged, in one multi-draw
+        size_t elementSize = indexTypeSize(mesh.indexType);
+        drawCounts.clear();
+        drawOffsets.clear();
+        unsigned int nextIndex = UINT32_MAX;
+        for(const Meshlet &meshlet : mesh.meshlets){
+            drawStatistics.clusters++;
+            if(!inFrustum(meshlet.center, meshlet.radius)){
+                drawStatistics.frustumCulledClusters++;
+                continue;
+            }
+            glm::vec3 view = meshlet.center - eye;
+            if(coneCulling && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius){
+                drawStatistics.backfaceCulledClusters++;
+                continue;
+            }
+            drawStatistics.drawnTriangles += meshlet.indexCount / 3;
+            if(meshlet.firstIndex == nextIndex)
+                drawCounts.back() += (GLsizei)meshlet.indexCount;
+            else{
+                drawCounts.push_back((GLsizei)meshlet.indexCount);
+                drawOffsets.push_back((const void*)((size_t)meshlet.firstIndex * elementSize));
+            }
+            nextIndex = meshlet.firstIndex + meshlet.indexCount;
+        }
+        drawStatistics.multiDrawRanges += drawCounts.size();
+        if(batch){
+            for(size_t range = 0; range < drawCounts.size(); range++)
+                batch->addDraw(mesh, record, (unsigned int)((size_t)drawOffsets[range] / elementSize), (unsigned int)drawCounts[range]);
+            continue;
+        }
+        if(queue){
+            for(size_t range = 0; range < drawCounts.size(); range++)
+                queue->submit(pass, *shader, mesh, transform, (unsigned int)((size_t)drawOffsets[range] / elementSize), (unsigned int)drawCounts[range]);
+            continue;
+        }
+        drawStatistics.drawCalls += drawCounts.empty() ? 0 : 1;
+        mesh.draw(*shader, drawCounts.data(), drawOffsets.data(), (GLsizei)drawCounts.size());
+    }
+    if(!immediate)
+        return;     // nothing bound, the BatchRenderer or RenderQueue draws at flush
+    glBindVertexArray(0);
+    GeometryAllocator::instance().invalidateBinding();
+}
+
+void Model::drawInstanced(Shader &shader, const InstanceData *instances, size_t instanceCount, unsigned int lod)
+{
+    drawStatistics = ModelDrawStatistics();
+    if(instanceCount == 0)
+        return;
+    InstanceBuffer &instanceBuffer = InstanceBuffer::shared();
+    instanceBuffer.upload(instances, instanceCount);
+    placeModel(glm::mat4(1.0f));
+
+    shader.setBool("instanced"_u, true);
+    GeometryAllocator::instance().invalidateBinding();
+    unsigned int currentNode = UINT32_MAX;
+    for(unsigned int i = 0; i < meshes.size(); i++){
+        Mesh &mesh = meshes[i];
+        if(!makeResident(i))
+            continue;
+        if(meshNodes[i] != currentNode){
+            currentNode = meshNodes[i];
+            shader.setMat4("model"_u, sceneGraph.getWorldMatrix(currentNode));
+            shader.setMat3("normalMatrix"_u, sceneGraph.getNormalMatrix(currentNode));
+        }
+        unsigned int level = min(lod, (unsigned int)mesh.lods.size() - 1);
+        GeometryAllocator::instance().attachInstanceBuffer(*mesh.layout, instanceBuffer);
+        mesh.drawInstanced(shader, level, (GLsizei)instanceCount);
+        drawStatistics.drawCalls++;
+        drawStatistics.drawnTriangles += (size_t)mesh.lods[level].indexCount / 3 * instanceCount;
+        drawStatistics.fullTriangles += (size_t)mesh.lods[0].indexCount / 3 * instanceCount;
+    }
+    drawStatistics.instances = instanceCount;
+    glBindVertexArray(0);
+    GeometryAllocator::instance().invalidateBinding();
+    shader.setBool("instanced"_u, false);
 }
 
 void Model::loadModel(string path)
 {
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    // warm load: the cache next to the source is only trusted while the source hash, the hashes of the files the import
+    // read besides it and the cache version match
+    string cachePath = path + MESH_CACHE_EXTENSION;
+    uint64_t sourceHash = 0;
+    bool hashed = hashFileContents(path, sourceHash);
+    cacheFilePath = cachePath;
+    cacheSourceHash = sourceHash;
+    if(hashed && loadFromCache(cachePath, sourceHash)){
+        loadPendingTextures(path);
+        packTextureArrays(path);
+        printIndexReport(path);
+        trackResidency();
+        buildSceneGraph();
+        return;
+    }
+
+    // the importer owns the IOSystem, opened outlives both
+    vector<string> opened;
     Assimp::Importer importer;
+    importer.SetIOHandler(new RecordingIOSystem(opened));
     const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
@@ -86,35 +440,68 @@ void Model::loadModel(string path)
         cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
         return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
     // process ASSIMP's root node
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, -1);
+    loadPendingTextures(path);
+    packTextureArrays(path);
+    printIndexReport(path);
+    printOptimizationReport(path);
+    printLodReport(path);
+    printMeshletReport(path);
+
+    // a companion file that cannot be hashed any more leaves the model without a cache
+    for(const string &file : opened){
+        if(file == path)
+            continue;
+        MeshCacheSource dependency{ file, 0 };
+        hashed = hashed && hashFileContents(file, dependency.hash);
+        cacheDependencies.push_back(dependency);
+    }
+    if(hashed)
+        writeCache(cachePath, sourceHash);
+    // the GPU has its copy and the cache is written, the CPU import data is only kept on request
+    if(!residencySettings().keepCpuCopies)
+        for(Mesh &mesh : meshes)
+            mesh.releaseImportData();
+    trackResidency();
+    buildSceneGraph();
 }
 
 // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode *node, const aiScene *scene)
+void Model::processNode(aiNode *node, const aiScene *scene, int parent)
 {
+    // record the node before its children so parents always precede them
+    ModelNode modelNode;
+    modelNode.parent = parent;
+    modelNode.transformation = glm::transpose(glm::make_mat4(&node->mTransformation.a1));   // aiMatrix4x4 is row-major
+    modelNode.firstMesh = (unsigned int)meshes.size();
+    modelNode.meshCount = 0;        // counted below, a split mesh adds several parts
+    int nodeIndex = (int)nodes.size();
+    nodes.push_back(modelNode);
+
     // process node's all meshes (if it has)
     for(unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // the node object only contains indices to index the actual objects in the scene.
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        processMesh(mesh, scene);
     }
+    nodes[nodeIndex].meshCount = (unsigned int)meshes.size() - nodes[nodeIndex].firstMesh;
     // process it's children node
     for(unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, nodeIndex);
     }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene){
+// appends the mesh to meshes, split into parts of at most 65536 vertices so every part draws with 16-bit indices
+void Model::processMesh(aiMesh *mesh, const aiScene *scene){
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    MaterialBlock constants;
     
     // process vertex's position, normal and texcoord
     // ---------------
@@ -156,13 +543,25 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene){
             vector.z = mesh->mBitangents[i].z;
             vertex.Bitangent = vector;
         }
-        else
+        else{
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+        
+        // bones, filled in by processBones
+        for(int j = 0; j < MAX_BONE_INFLUENCE; j++){
+            vertex.m_BoneIDs[j] = -1;
+            vertex.m_Weights[j] = 0.0f;
+        }
         
         // final
         vertices.push_back(vertex);
     }
     
+    if(mesh->HasBones())
+        processBones(mesh, vertices);
+    
     // process indices
     // ---------------
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
@@ -194,9 +593,54 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene){
         // 4. height maps
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        // 5. colors and glossiness for the Material block
+        constants = loadMaterialConstants(material);
     }
     
-    return Mesh(vertices, indices, textures);
+    MeshGeometry geometry;
+    geometry.vertices.swap(vertices);
+    geometry.indices.swap(indices);
+    if(vertexWeldSettings().enabled && !geometry.vertices.empty()){
+        size_t imported = geometry.vertices.size();
+        size_t removed = weldVertices(geometry, vertexWeldSettings());
+        cout << "MESH::WELD::" << mesh->mName.C_Str() << "::" << imported << " -> " << geometry.vertices.size() << " vertices ("
+             << 100.0 * removed / imported << "% removed)" << endl;
+    }
+    for(MeshGeometry &part : splitMeshGeometry(move(geometry))){
+        if(optimizeMeshes){
+            cacheBefore += analyzeVertexCache(part);
+            optimizeMeshGeometry(part);
+            cacheAfter += analyzeVertexCache(part);
+        }
+        if(meshLodSettings().enabled)
+            buildMeshLods(part, meshLodSettings());
+        if(meshletSettings().enabled)
+            buildMeshlets(part, meshletSettings());
+        meshes.emplace_back(move(part.vertices), move(part.indices), textures, vertexEncoding, move(part.lods), move(part.meshlets));
+        meshes.back().setMaterial(constants);
+    }
+}
+
+// keeps the MAX_BONE_INFLUENCE strongest bones of every vertex
+void Model::processBones(aiMesh *mesh, vector<Vertex> &vertices){
+    for(unsigned int boneID = 0; boneID < mesh->mNumBones; boneID++){
+        const aiBone *bone = mesh->mBones[boneID];
+        for(unsigned int i = 0; i < bone->mNumWeights; i++){
+            const aiVertexWeight &weight = bone->mWeights[i];
+            if(weight.mVertexId >= vertices.size())
+                continue;
+            Vertex &vertex = vertices[weight.mVertexId];
+            
+            int weakest = 0;
+            for(int j = 1; j < MAX_BONE_INFLUENCE; j++)
+                if(vertex.m_Weights[j] < vertex.m_Weights[weakest])
+                    weakest = j;
+            if(weight.mWeight > vertex.m_Weights[weakest]){
+                vertex.m_BoneIDs[weakest] = (int)boneID;
+                vertex.m_Weights[weakest] = weight.mWeight;
+            }
+        }
+    }
 }
 
 vector<Texture> Model::loadMaterialTextures(aiMaterial *material, aiTextureType textureType, string typeName){
@@ -205,28 +649,552 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial *material, aiTextureType
     {
         aiString str;
         material->GetTexture(textureType, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
+        textures.push_back(loadTexture(str.C_Str(), typeName));
+    }
+    return textures;
+}
+
+MaterialBlock Model::loadMaterialConstants(const aiMaterial *material){
+    // the colors scale the textures in FragmentShader.glsl, what the file leaves out keeps the MaterialBlock defaults
+    MaterialBlock constants;
+    aiColor4D color;
+    if(material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS)
+        constants.diffuseColor = glm::vec4(color.r, color.g, color.b, color.a);
+    if(material->Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS)
+        constants.specularColor = glm::vec4(color.r, color.g, color.b, color.a);
+    float shininess = 0.0f;
+    if(material->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess > 0.0f)
+        constants.glossy = shininess;
+    return constants;
+}
+
+Texture Model::loadTexture(const string &path, const string &typeName){
+    Texture texture;
+    texture.type = typeName;
+    texture.path = path;
+
+    // already referenced by this model
+    unordered_map<string, unsigned int>::const_iterator loaded = textures_loaded.find(path);
+    if(loaded != textures_loaded.end()){
+        texture.id = loaded->second;
+        return texture;
+    }
+
+    // resident for another model, otherwise queue it: the id is filled in by loadPendingTextures once the whole model is imported
+    texture.id = 0;
+    if(!TextureRegistry::instance().acquire(TextureRegistry::normalizePath(directory + '/' + path), texture.id))
+        textures_pending.push_back(texture);
+    textures_loaded[path] = texture.id;
+    return texture;
+}
+
+// decodes every queued texture of the model in parallel, uploads them on the GL thread and patches the meshes
+void Model::loadPendingTextures(const string &name){
+    if(textures_pending.empty())
+        return;
+
+    vector<string> filenames;
+    vector<TextureUsage> usages;
+    for(const Texture &texture : textures_pending){
+        filenames.push_back(TextureRegistry::normalizePath(directory + '/' + texture.path));
+        usages.push_back(textureUsageFromType(texture.type));   // normal maps go to BC5
+    }
+
+    TextureLoadReport report;
+    vector<unsigned int> textureIDs = TextureRegistry::instance().loadBatch(filenames, usages, &report);
+    report.print(name);
+
+    for(size_t i = 0; i < textures_pending.size(); i++)
+        textures_loaded[textures_pending[i].path] = textureIDs[i];
+    textures_pending.clear();
+
+    // the materials were built with id 0 for these, look them up again now that they can be shared
+    for(Mesh &mesh : meshes){
+        bool patched = false;
+        for(Texture &texture : mesh.textures){
+            if(texture.id == 0){
+                texture.id = textures_loaded[texture.path];
+                patched = true;
             }
         }
-        if(!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        if(patched)
+            mesh.setMaterial(mesh.material->getConstants());
+    }
+}
+
+void Model::packTextureArrays(const string &name){
+    if(!textureArraySettings().enabled || textures_loaded.empty())
+        return;
+
+    vector<GLuint> textureIDs;
+    for(const pair<const string, unsigned int> &texture : textures_loaded)
+        if(texture.second != 0 && find(textureIDs.begin(), textureIDs.end(), texture.second) == textureIDs.end())
+            textureIDs.push_back(texture.second);
+    sort(textureIDs.begin(), textureIDs.end());
+
+    vector<const Material*> sequence;
+    for(const Mesh &mesh : meshes)
+        sequence.push_back(mesh.material.get());
+    TextureArrayReport report;
+    report.bindsBefore = Material::countTextureBinds(sequence);
+
+    unordered_map<GLuint, TextureLayer> layers;
+    vector<GpuTexture> arrays = buildTextureArrays(textureIDs, layers, report);
+    for(GpuTexture &array : arrays)
+        textureArrays.push_back(move(array));
+
+    // the meshes sample the layers from now on, their materials are looked up again
+    sequence.clear();
+    for(Mesh &mesh : meshes){
+        bool patched = false;
+        for(Texture &texture : mesh.textures){
+            unordered_map<GLuint, TextureLayer>::const_iterator layer = layers.find(texture.id);
+            if(texture.target != GL_TEXTURE_2D || layer == layers.end())
+                continue;
+            texture.id = layer->second.array;
+            texture.target = GL_TEXTURE_2D_ARRAY;
+            texture.layer = layer->second.layer;
+            patched = true;
         }
+        if(patched)
+            mesh.setMaterial(mesh.material->getConstants());
+        sequence.push_back(mesh.material.get());
     }
-    return textures;
+    report.bindsAfter = Material::countTextureBinds(sequence);
+
+    // the copies are this model's, its references on the 2D textures go (other models may still hold them)
+    for(unordered_map<string, unsigned int>::iterator texture = textures_loaded.begin(); texture != textures_loaded.end(); ){
+        if(layers.count(texture->second)){
+            TextureRegistry::instance().release(texture->second);
+            texture = textures_loaded.erase(texture);
+        }
+        else
+            ++texture;
+    }
+    report.print(name);
+}
+
+// index memory of the model against 32-bit indices everywhere, index fetch per draw shrinks by the same ratio
+void Model::printIndexReport(const string &name) const{
+    size_t shortMeshes = 0, indexBytes = 0, fullBytes = 0;
+    for(const Mesh &mesh : meshes){
+        if(mesh.indexType == GL_UNSIGNED_SHORT)
+            shortMeshes++;
+        indexBytes += (size_t)mesh.indexCount * indexTypeSize(mesh.indexType);
+        fullBytes += (size_t)mesh.indexCount * sizeof(uint32_t);
+    }
+    if(fullBytes == 0)
+        return;
+    cout << "MESH::INDEX_REPORT::" << name << endl
+         << "    meshes:  " << meshes.size() << " (" << shortMeshes << " with 16-bit indices)" << endl
+         << "    indices: " << indexBytes / 1024.0 << " KiB instead of " << fullBytes / 1024.0 << " KiB, "
+         << 100.0 * (fullBytes - indexBytes) / fullBytes << "% less memory and index bandwidth" << endl;
+}
+
+// post-transform cache simulation (16-entry FIFO) of the imported index order against the optimized one
+void Model::printOptimizationReport(const string &name) const{
+    if(!optimizeMeshes || cacheBefore.triangles == 0)
+        return;
+    cout << "MESH::OPTIMIZATION_REPORT::" << name << endl
+         << "    triangles: " << cacheAfter.triangles << ", vertices: " << cacheAfter.vertices << endl
+         << "    ACMR: " << cacheBefore.acmr() << " -> " << cacheAfter.acmr() << endl
+         << "    ATVR: " << cacheBefore.atvr() << " -> " << cacheAfter.atvr() << endl;
+}
+
+// triangles per level summed over the meshes and the largest error bound of each level
+void Model::printLodReport(const string &name) const{
+    size_t triangles[MAX_MESH_LODS] = {}, meshCount[MAX_MESH_LODS] = {};
+    float error[MAX_MESH_LODS] = {};
+    for(const Mesh &mesh : meshes){
+        for(size_t level = 0; level < mesh.lods.size(); level++){
+            triangles[level] += mesh.lods[level].indexCount / 3;
+            meshCount[level]++;
+            error[level] = max(error[level], mesh.lods[level].error);
+        }
+    }
+    if(meshCount[1] == 0)
+        return;
+    cout << "MESH::LOD_REPORT::" << name << endl;
+    for(int level = 0; level < MAX_MESH_LODS && meshCount[level] > 0; level++)
+        cout << "    LOD " << level << ": " << triangles[level] << " triangles in " << meshCount[level] << " meshes, error <= " << error[level] << endl;
+}
+
+void Model::printMeshletReport(const string &name) const{
+    size_t meshletCount = 0, clusteredMeshes = 0, triangles = 0, coneCullable = 0;
+    for(const Mesh &mesh : meshes){
+        if(mesh.meshlets.empty())
+            continue;
+        clusteredMeshes++;
+        meshletCount += mesh.meshlets.size();
+        for(const Meshlet &meshlet : mesh.meshlets){
+            triangles += meshlet.indexCount / 3;
+            if(meshlet.coneCutoff < 1.0f)
+                coneCullable++;
+        }
+    }
+    if(meshletCount == 0)
+        return;
+    cout << "MESH::MESHLET_REPORT::" << name << endl
+         << "    meshlets: " << meshletCount << " in " << clusteredMeshes << " meshes, " << (float)triangles / meshletCount << " triangles each" << endl
+         << "    normal cones: " << coneCullable << " meshlets can be back-face culled" << endl;
+}
+
+// MARK: - Scene graph
+// ---------------------
+void Model::buildSceneGraph(){
+    // nodes is already parent-before-child, it maps one to one behind the placement node
+    unsigned int placement = sceneGraph.addNode(-1);
+    meshNodes.assign(meshes.size(), placement);
+    for(size_t i = 0; i < nodes.size(); i++){
+        unsigned int node = sceneGraph.addNode(nodes[i].parent < 0 ? (int)placement : nodes[i].parent + 1, nodes[i].transformation);
+        for(unsigned int m = nodes[i].firstMesh; m < nodes[i].firstMesh + nodes[i].meshCount && m < meshes.size(); m++)
+            meshNodes[m] = node;
+    }
+    sceneGraph.updateWorldMatrices();
+}
+
+void Model::placeModel(const glm::mat4 &model){
+    if(sceneGraph.size() > 0 && sceneGraph.getLocalTransform(0) != model)
+        sceneGraph.setLocalTransform(0, model);
+    sceneGraph.updateWorldMatrices();
+}
+
+// MARK: - Residency
+// -------------------
+void Model::trackResidency(){
+    meshResidency.assign(meshes.size(), 0);
+    for(unsigned int i = 0; i < meshes.size(); i++){
+        if(meshes[i].vertices.empty() && i >= cacheRecords.size())
+            continue;
+        meshResidency[i] = ResidencyManager::instance().track(RESIDENCY_MESH, meshes[i].getGpuBytes(),
+                                                              [this, i](){ meshes[i].evictGeometry(); },
+                                                              [this, i](){ return reloadMesh(i); });
+    }
+}
+
+// from the CPU copy if kept, otherwise from the cache written or read at load time
+bool Model::reloadMesh(unsigned int index){
+    Mesh &mesh = meshes[index];
+    if(!mesh.vertices.empty()){
+        mesh.restoreGeometry(mesh.vertices.data(), mesh.vertices.size(), mesh.indexData.data());
+        return mesh.isResident();
+    }
+    if(index >= cacheRecords.size())
+        return false;
+
+    // the cache may have been rewritten by another import since, its ranges only match while the header does
+    MappedFile file;
+    if(!file.open(cacheFilePath) || file.getSize() < sizeof(MeshCacheHeader))
+        return false;
+    const unsigned char *base = file.getData();
+    const uint64_t size = file.getSize();
+    const MeshCacheHeader *header = (const MeshCacheHeader*)base;
+    const MeshCacheMesh &record = cacheRecords[index];
+    if(memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 || header->version != MESH_CACHE_VERSION ||
+       header->sourceHash != cacheSourceHash || header->fileSize != size || header->importFlags != cacheImportFlags() ||
+       record.vertexOffset > size || (uint64_t)record.vertexCount * sizeof(Vertex) > size - record.vertexOffset ||
+       record.indexOffset > size || (uint64_t)record.indexCount * record.indexSize > size - record.indexOffset ||
+       record.indexCount != mesh.indexCount || record.indexSize != indexTypeSize(mesh.indexType))
+        return false;
+    vector<MeshCacheSource> dependencies;
+    if(!readCacheDependencies(base, size, dependencies) || dependencies != cacheDependencies)
+        return false;
+
+    mesh.restoreGeometry((const Vertex*)(base + record.vertexOffset), record.vertexCount, base + record.indexOffset);
+    return mesh.isResident();
+}
+
+bool Model::makeResident(unsigned int index){
+    for(const Texture &texture : meshes[index].textures)
+        TextureRegistry::instance().touch(texture.id);
+    return index >= meshResidency.size() || ResidencyManager::instance().touch(meshResidency[index]);
+}
+
+// MARK: - Mesh cache
+// -------------------
+// import options baked into the cached geometry, a cache written with other options is re-imported
+uint32_t Model::cacheImportFlags() const{
+    return (optimizeMeshes ? MESH_CACHE_FLAG_OPTIMIZED : 0) | (vertexWeldSettings().enabled ? MESH_CACHE_FLAG_WELDED : 0) |
+           (meshLodSettings().enabled ? MESH_CACHE_FLAG_LODS : 0) | (meshletSettings().enabled ? MESH_CACHE_FLAG_MESHLETS : 0);
+}
+
+// maps the cache and feeds every mesh straight from the mapping, returns false (without touching GL) if anything is stale or malformed
+bool Model::loadFromCache(const string &cachePath, uint64_t sourceHash){
+    MappedFile file;
+    if(!file.open(cachePath) || file.getSize() < sizeof(MeshCacheHeader))
+        return false;
+
+    const unsigned char *base = file.getData();
+    const uint64_t size = file.getSize();
+    const MeshCacheHeader *header = (const MeshCacheHeader*)base;
+    if(memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 || header->version != MESH_CACHE_VERSION ||
+       header->sourceHash != sourceHash || header->fileSize != size || header->vertexSize != sizeof(Vertex) ||
+       header->importFlags != cacheImportFlags())
+        return false;
+
+    // validate every range before creating any GL object
+    auto inFile = [size](uint64_t offset, uint64_t bytes){ return offset <= size && bytes <= size - offset; };
+    if(!inFile(header->meshOffset, (uint64_t)header->meshCount * sizeof(MeshCacheMesh)) ||
+       !inFile(header->textureOffset, (uint64_t)header->textureCount * sizeof(MeshCacheTexture)) ||
+       !inFile(header->nodeOffset, (uint64_t)header->nodeCount * sizeof(MeshCacheNode)) ||
+       !inFile(header->lodOffset, (uint64_t)header->lodCount * sizeof(MeshCacheLod)) ||
+       !inFile(header->meshletOffset, (uint64_t)header->meshletCount * sizeof(MeshCacheMeshlet)) ||
+       !inFile(header->stringOffset, header->stringSize))
+        return false;
+
+    // every other file the import read has to be unchanged too
+    vector<MeshCacheSource> dependencies;
+    if(!readCacheDependencies(base, size, dependencies))
+        return false;
+    for(const MeshCacheSource &dependency : dependencies){
+        uint64_t hash = 0;
+        if(!hashFileContents(dependency.path, hash) || hash != dependency.hash)
+            return false;
+    }
+
+    const MeshCacheMesh *meshRecords = (const MeshCacheMesh*)(base + header->meshOffset);
+    const MeshCacheTexture *textureRecords = (const MeshCacheTexture*)(base + header->textureOffset);
+    const MeshCacheNode *nodeRecords = (const MeshCacheNode*)(base + header->nodeOffset);
+    const MeshCacheLod *lodRecords = (const MeshCacheLod*)(base + header->lodOffset);
+    const MeshCacheMeshlet *meshletRecords = (const MeshCacheMeshlet*)(base + header->meshletOffset);
+    const char *strings = (const char*)(base + header->stringOffset);
+
+    for(uint32_t i = 0; i < header->meshCount; i++){
+        const MeshCacheMesh &record = meshRecords[i];
+        if((record.indexSize != 2 && record.indexSize != 4) ||
+           !inFile(record.vertexOffset, (uint64_t)record.vertexCount * sizeof(Vertex)) ||
+           !inFile(record.indexOffset, (uint64_t)record.indexCount * record.indexSize) ||
+           (uint64_t)record.firstTexture + record.textureCount > header->textureCount ||
+           record.lodCount == 0 || record.lodCount > MAX_MESH_LODS || (uint64_t)record.firstLod + record.lodCount > header->lodCount ||
+           (uint64_t)record.firstMeshlet + record.meshletCount > header->meshletCount)
+            return false;
+        for(uint32_t m = record.firstMeshlet; m < record.firstMeshlet + record.meshletCount; m++)
+            if((uint64_t)meshletRecords[m].firstIndex + meshletRecords[m].indexCount > lodRecords[record.firstLod].indexCount)
+                return false;
+        for(uint32_t l = record.firstLod; l < record.firstLod + record.lodCount; l++)
+            if((uint64_t)lodRecords[l].firstIndex + lodRecords[l].indexCount > record.indexCount || lodRecords[l].indexCount % 3 != 0)
+                return false;
+        // every index has to address a vertex of its own mesh
+        for(uint32_t j = 0; j < record.indexCount; j++){
+            uint32_t index;
+            if(record.indexSize == 2){
+                uint16_t index16;
+                memcpy(&index16, base + record.indexOffset + j * 2, 2);
+                index = index16;
+            }
+            else
+                memcpy(&index, base + record.indexOffset + j * 4, 4);
+            if(index >= record.vertexCount)
+                return false;
+        }
+    }
+    for(uint32_t i = 0; i < header->textureCount; i++){
+        const MeshCacheTexture &record = textureRecords[i];
+        if((uint64_t)record.typeOffset + record.typeLength > header->stringSize ||
+           (uint64_t)record.pathOffset + record.pathLength > header->stringSize)
+            return false;
+    }
+    for(uint32_t i = 0; i < header->nodeCount; i++){
+        const MeshCacheNode &record = nodeRecords[i];
+        if(record.parent >= (int32_t)i || (uint64_t)record.firstMesh + record.meshCount > header->meshCount)
+            return false;
+    }
+
+    // upload
+    meshes.reserve(header->meshCount);
+    for(uint32_t i = 0; i < header->meshCount; i++){
+        const MeshCacheMesh &record = meshRecords[i];
+
+        vector<Texture> textures;
+        for(uint32_t t = record.firstTexture; t < record.firstTexture + record.textureCount; t++){
+            const MeshCacheTexture &texture = textureRecords[t];
+            textures.push_back(loadTexture(string(strings + texture.pathOffset, texture.pathLength),
+                                           string(strings + texture.typeOffset, texture.typeLength)));
+        }
+
+        vector<MeshLod> lods;
+        for(uint32_t l = record.firstLod; l < record.firstLod + record.lodCount; l++)
+            lods.push_back(MeshLod{ lodRecords[l].firstIndex, lodRecords[l].indexCount, lodRecords[l].error });
+        vector<Meshlet> meshlets(record.meshletCount);
+        for(uint32_t m = 0; m < record.meshletCount; m++){
+            const MeshCacheMeshlet &cached = meshletRecords[record.firstMeshlet + m];
+            meshlets[m].firstIndex = cached.firstIndex;
+            meshlets[m].indexCount = cached.indexCount;
+            meshlets[m].center = glm::vec3(cached.center[0], cached.center[1], cached.center[2]);
+            meshlets[m].radius = cached.radius;
+            meshlets[m].coneAxis = glm::vec3(cached.coneAxis[0], cached.coneAxis[1], cached.coneAxis[2]);
+            meshlets[m].coneCutoff = cached.coneCutoff;
+        }
+
+        meshes.emplace_back((const Vertex*)(base + record.vertexOffset), record.vertexCount,
+                            base + record.indexOffset, record.indexCount, record.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                            textures, vertexEncoding, move(lods), move(meshlets));
+        MaterialBlock constants;
+        memcpy(&constants.diffuseColor, record.diffuseColor, sizeof(record.diffuseColor));
+        memcpy(&constants.specularColor, record.specularColor, sizeof(record.specularColor));
+        constants.glossy = record.glossy;
+        meshes.back().setMaterial(constants);
+        if(residencySettings().keepCpuCopies){
+            meshes.back().vertices.assign((const Vertex*)(base + record.vertexOffset), (const Vertex*)(base + record.vertexOffset) + record.vertexCount);
+            meshes.back().indexData.assign(base + record.indexOffset, base + record.indexOffset + (size_t)record.indexCount * record.indexSize);
+        }
+    }
+    cacheRecords.assign(meshRecords, meshRecords + header->meshCount);
+    cacheDependencies = move(dependencies);
+
+    nodes.reserve(header->nodeCount);
+    for(uint32_t i = 0; i < header->nodeCount; i++){
+        ModelNode node;
+        node.parent = nodeRecords[i].parent;
+        node.transformation = glm::make_mat4(nodeRecords[i].transformation);
+        node.firstMesh = nodeRecords[i].firstMesh;
+        node.meshCount = nodeRecords[i].meshCount;
+        nodes.push_back(node);
+    }
+    return true;
+}
+
+// writes the freshly imported model to a temporary file and renames it into place, so readers never see a partial cache
+bool Model::writeCache(const string &cachePath, uint64_t sourceHash){
+    // 1. records and string table
+    vector<MeshCacheMesh> meshRecords(meshes.size());
+    vector<MeshCacheTexture> textureRecords;
+    vector<MeshCacheNode> nodeRecords(nodes.size());
+    vector<MeshCacheLod> lodRecords;
+    vector<MeshCacheMeshlet> meshletRecords;
+    vector<MeshCacheDependency> dependencyRecords;
+    string strings;
+
+    for(size_t i = 0; i < meshes.size(); i++){
+        meshRecords[i].vertexCount = (uint32_t)meshes[i].vertices.size();
+        meshRecords[i].indexCount = meshes[i].indexCount;
+        meshRecords[i].indexSize = (uint32_t)indexTypeSize(meshes[i].indexType);
+        meshRecords[i].firstLod = (uint32_t)lodRecords.size();
+        meshRecords[i].lodCount = (uint32_t)meshes[i].lods.size();
+        meshRecords[i].firstMeshlet = (uint32_t)meshletRecords.size();
+        meshRecords[i].meshletCount = (uint32_t)meshes[i].meshlets.size();
+        const MaterialBlock &constants = meshes[i].material->getConstants();
+        memcpy(meshRecords[i].diffuseColor, &constants.diffuseColor, sizeof(meshRecords[i].diffuseColor));
+        memcpy(meshRecords[i].specularColor, &constants.specularColor, sizeof(meshRecords[i].specularColor));
+        meshRecords[i].glossy = constants.glossy;
+        for(const Meshlet &meshlet : meshes[i].meshlets){
+            MeshCacheMeshlet record;
+            record.firstIndex = meshlet.firstIndex;
+            record.indexCount = meshlet.indexCount;
+            memcpy(record.center, &meshlet.center, sizeof(record.center));
+            record.radius = meshlet.radius;
+            memcpy(record.coneAxis, &meshlet.coneAxis, sizeof(record.coneAxis));
+            record.coneCutoff = meshlet.coneCutoff;
+            meshletRecords.push_back(record);
+        }
+        for(const MeshLod &lod : meshes[i].lods){
+            MeshCacheLod record;
+            record.firstIndex = lod.firstIndex;
+            record.indexCount = lod.indexCount;
+            record.error = lod.error;
+            record.padding = 0;
+            lodRecords.push_back(record);
+        }
+        meshRecords[i].firstTexture = (uint32_t)textureRecords.size();
+        meshRecords[i].textureCount = (uint32_t)meshes[i].textures.size();
+        for(const Texture &texture : meshes[i].textures){
+            MeshCacheTexture record;
+            record.typeOffset = (uint32_t)strings.size();
+            record.typeLength = (uint32_t)texture.type.size();
+            strings += texture.type;
+            record.pathOffset = (uint32_t)strings.size();
+            record.pathLength = (uint32_t)texture.path.size();
+            strings += texture.path;
+            textureRecords.push_back(record);
+        }
+    }
+    for(const MeshCacheSource &dependency : cacheDependencies){
+        MeshCacheDependency record;
+        record.pathOffset = (uint32_t)strings.size();
+        record.pathLength = (uint32_t)dependency.path.size();
+        record.hash = dependency.hash;
+        strings += dependency.path;
+        dependencyRecords.push_back(record);
+    }
+    for(size_t i = 0; i < nodes.size(); i++){
+        nodeRecords[i].parent = nodes[i].parent;
+        nodeRecords[i].firstMesh = nodes[i].firstMesh;
+        nodeRecords[i].meshCount = nodes[i].meshCount;
+        nodeRecords[i].padding = 0;
+        memcpy(nodeRecords[i].transformation, glm::value_ptr(nodes[i].transformation), sizeof(nodeRecords[i].transformation));
+    }
+
+    // 2. layout
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = (uint32_t)meshRecords.size();
+    header.textureCount = (uint32_t)textureRecords.size();
+    header.nodeCount = (uint32_t)nodeRecords.size();
+    header.importFlags = cacheImportFlags();
+    header.lodCount = (uint32_t)lodRecords.size();
+    header.meshletCount = (uint32_t)meshletRecords.size();
+    header.dependencyCount = (uint32_t)dependencyRecords.size();
+    header.meshOffset = alignCacheOffset(sizeof(MeshCacheHeader));
+    header.textureOffset = alignCacheOffset(header.meshOffset + meshRecords.size() * sizeof(MeshCacheMesh));
+    header.nodeOffset = alignCacheOffset(header.textureOffset + textureRecords.size() * sizeof(MeshCacheTexture));
+    header.lodOffset = alignCacheOffset(header.nodeOffset + nodeRecords.size() * sizeof(MeshCacheNode));
+    header.meshletOffset = alignCacheOffset(header.lodOffset + lodRecords.size() * sizeof(MeshCacheLod));
+    header.dependencyOffset = alignCacheOffset(header.meshletOffset + meshletRecords.size() * sizeof(MeshCacheMeshlet));
+    header.stringOffset = alignCacheOffset(header.dependencyOffset + dependencyRecords.size() * sizeof(MeshCacheDependency));
+    header.stringSize = strings.size();
+
+    uint64_t offset = alignCacheOffset(header.stringOffset + header.stringSize);
+    for(size_t i = 0; i < meshes.size(); i++){
+        meshRecords[i].vertexOffset = offset;
+        offset = alignCacheOffset(offset + meshes[i].vertices.size() * sizeof(Vertex));
+        meshRecords[i].indexOffset = offset;
+        offset = alignCacheOffset(offset + meshes[i].indexData.size());
+    }
+    header.fileSize = offset;
+
+    // 3. write
+    string tempPath = cachePath + ".tmp";
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    if(!file){
+        cout << "WARNING::MESH_CACHE::CANNOT_WRITE::" << tempPath << endl;
+        return false;
+    }
+    const char padding[8] = {0};
+    uint64_t written = 0;
+    auto write = [&](uint64_t at, const void *bytes, uint64_t count){
+        file.write(padding, at - written);
+        file.write((const char*)bytes, count);
+        written = at + count;
+    };
+    write(0, &header, sizeof(header));
+    write(header.meshOffset, meshRecords.data(), meshRecords.size() * sizeof(MeshCacheMesh));
+    write(header.textureOffset, textureRecords.data(), textureRecords.size() * sizeof(MeshCacheTexture));
+    write(header.nodeOffset, nodeRecords.data(), nodeRecords.size() * sizeof(MeshCacheNode));
+    write(header.lodOffset, lodRecords.data(), lodRecords.size() * sizeof(MeshCacheLod));
+    write(header.meshletOffset, meshletRecords.data(), meshletRecords.size() * sizeof(MeshCacheMeshlet));
+    write(header.dependencyOffset, dependencyRecords.data(), dependencyRecords.size() * sizeof(MeshCacheDependency));
+    write(header.stringOffset, strings.data(), strings.size());
+    for(size_t i = 0; i < meshes.size(); i++){
+        write(meshRecords[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+        write(meshRecords[i].indexOffset, meshes[i].indexData.data(), meshes[i].indexData.size());
+    }
+    file.write(padding, header.fileSize - written);
+    file.close();
+
+    if(!file){
+        std::remove(tempPath.c_str());
+        cout << "WARNING::MESH_CACHE::CANNOT_WRITE::" << tempPath << endl;
+        return false;
+    }
+    std::remove(cachePath.c_str());
+    if(std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        return false;
+    cacheRecords = meshRecords;
+    return true;
 }
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
@@ -234,39 +1202,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return loadTextureFile(filename);
 }
 
 #endif /* Model_h */
@@ -0,0 +1,282 @@
+#ifndef ProgramCache_h
+#define ProgramCache_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "Hash.h"
+
+// standard library
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// bump whenever the file layout or the key changes, older entries are compiled again and overwritten
+#define PROGRAM_CACHE_VERSION 1
+#define PROGRAM_CACHE_MAGIC "BMPB"
+#define PROGRAM_CACHE_EXTENSION ".bpcache"
+
+// MARK: - GL 4.1
+// ------------------
+// glad is generated for 3.3 core, program binaries (GL 4.1 or ARB_get_program_binary) are loaded here
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (*PFNCACHEGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (*PFNCACHEPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (*PFNCACHEPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// MARK: - Structure
+// ------------------
+struct ProgramCacheSettings {
+    bool enabled = true;                // off compiles every program, as without driver support
+    string directory = "ShaderCache";   // one <key>.bpcache per program, relative to the working directory
+};
+
+// a cache file: header | driver binary
+struct ProgramCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;               // ProgramBinaryCache::keyOf, also the file name
+    uint32_t binaryFormat;      // as returned by glGetProgramBinary
+    uint32_t binarySize;
+    uint64_t binaryHash;        // FNV-1a of the binary, guards against truncated writes
+};
+
+// cold programs are compiled and linked from source, warm ones come from a cache file
+struct ProgramCacheStatistics {
+    unsigned int compiled = 0;
+    unsigned int loaded = 0;
+    unsigned int rejected = 0;          // cache files the driver refused (updated driver), compiled again
+    unsigned int malformed = 0;         // cache files that are truncated, foreign or fail their hash, compiled again
+    double compileMs = 0.0;
+    double loadMs = 0.0;
+};
+
+// MARK: - Functions
+// -----------------
+ProgramCacheSettings& programCacheSettings();
+
+// MARK: - Class
+// ------------------
+// on-disk cache of linked programs keyed by the shader sources, the defines and the driver strings,
+// every miss or refused binary falls back to compiling, whose binary is written for the next launch
+// GL thread only
+class ProgramBinaryCache {
+public:
+    // Functions
+    // ----------
+    static ProgramBinaryCache& shared();
+
+    // loads the entry points and hashes the driver strings, without it (or with no binary formats) every program compiles
+    bool initialize(GLADloadproc load);
+    bool isAvailable() const { return available && programCacheSettings().enabled; }
+
+    uint64_t keyOf(const string &vertexCode, const string &fragmentCode, const string &defines = "") const;
+    // links program from the file of key, false to compile it instead
+    bool load(uint64_t key, GLuint program);
+    // before glLinkProgram, the driver only keeps a binary it was asked for
+    void prepare(GLuint program);
+    // after a successful link from source, milliseconds is what compiling and linking took
+    void store(uint64_t key, GLuint program, double milliseconds);
+
+    const ProgramCacheStatistics& getStatistics() const { return statistics; }
+    void printReport() const;
+
+private:
+    // Properties
+    // ----------
+    PFNCACHEGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+    PFNCACHEPROGRAMBINARYPROC programBinary = nullptr;
+    PFNCACHEPROGRAMPARAMETERIPROC programParameteri = nullptr;
+    bool available = false;
+    uint64_t driverHash = 0;            // GL_VENDOR, GL_RENDERER, GL_VERSION and GL_SHADING_LANGUAGE_VERSION
+    ProgramCacheStatistics statistics;
+
+    ProgramBinaryCache() {}
+    string pathOf(uint64_t key) const;
+};
+
+// MARK: - Function realization
+// --------------------
+ProgramBinaryCache& ProgramBinaryCache::shared(){
+    static ProgramBinaryCache programBinaryCache;
+    return programBinaryCache;
+}
+
+ProgramCacheSettings& programCacheSettings(){
+    static ProgramCacheSettings settings;
+    return settings;
+}
+
+bool ProgramBinaryCache::initialize(GLADloadproc load){
+    GLint major = 0, minor = 0, extensionCount = 0, formatCount = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    bool supported = major > 4 || (major == 4 && minor >= 1);
+    for(GLint i = 0; i < extensionCount && !supported; i++){
+        const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        supported = extension && strcmp(extension, "GL_ARB_get_program_binary") == 0;
+    }
+    if(supported){
+        getProgramBinary = (PFNCACHEGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        programBinary = (PFNCACHEPROGRAMBINARYPROC)load("glProgramBinary");
+        programParameteri = (PFNCACHEPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    }
+    available = getProgramBinary && programBinary && programParameteri && formatCount > 0;
+    if(!available){
+        cout << "WARNING::PROGRAM_CACHE::NO_PROGRAM_BINARIES::GL " << major << "." << minor << ", " << formatCount << " formats, compiling every program" << endl;
+        return false;
+    }
+
+    // a binary is only valid for the driver that produced it
+    driverHash = hashBytes(PROGRAM_CACHE_MAGIC, 4);
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    for(GLenum name : names){
+        const char *value = (const char*)glGetString(name);
+        if(value)
+            driverHash = hashBytes(value, strlen(value) + 1, driverHash);
+    }
+    return true;
+}
+
+uint64_t ProgramBinaryCache::keyOf(const string &vertexCode, const string &fragmentCode, const string &defines) const{
+    // sizes in between, so no text moving from one part to the next gives the same key
+    uint64_t sizes[3] = { vertexCode.size(), fragmentCode.size(), defines.size() };
+    uint64_t key = hashBytes(&driverHash, sizeof(driverHash));
+    key = hashBytes(sizes, sizeof(sizes), key);
+    key = hashBytes(vertexCode.data(), vertexCode.size(), key);
+    key = hashBytes(fragmentCode.data(), fragmentCode.size(), key);
+    return hashBytes(defines.data(), defines.size(), key);
+}
+
+string ProgramBinaryCache::pathOf(uint64_t key) const{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return programCacheSettings().directory + "/" + name + PROGRAM_CACHE_EXTENSION;
+}
+
+bool ProgramBinaryCache::load(uint64_t key, GLuint program){
+    if(!isAvailable())
+        return false;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string path = pathOf(key);
+    ifstream file(path, ios::binary | ios::ate);
+    if(!file)
+        return false;
+
+    // the size on disk bounds binarySize before anything is allocated for it
+    uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+    ProgramCacheHeader header;
+    vector<char> binary;
+    bool valid = fileSize >= sizeof(header) && file.read((char*)&header, sizeof(header)) && memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0
+                 && header.version == PROGRAM_CACHE_VERSION && header.key == key && sizeof(header) + (uint64_t)header.binarySize == fileSize;
+    if(valid){
+        binary.resize(header.binarySize);
+        valid = file.read(binary.data(), binary.size()) && hashBytes(binary.data(), binary.size()) == header.binaryHash;
+    }
+    file.close();
+    if(!valid){
+        statistics.malformed++;
+        std::remove(path.c_str());
+        return false;
+    }
+
+    GLint linked = GL_FALSE;
+    programBinary(program, (GLenum)header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(!linked){
+        // the program is unlinked again and can still be built from source, the entry is rewritten then
+        statistics.rejected++;
+        std::remove(path.c_str());
+        return false;
+    }
+    statistics.loaded++;
+    statistics.loadMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void ProgramBinaryCache::prepare(GLuint program){
+    if(isAvailable())
+        programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramBinaryCache::store(uint64_t key, GLuint program, double milliseconds){
+    statistics.compiled++;
+    statistics.compileMs += milliseconds;
+    if(!isAvailable())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+        return;
+    vector<char> binary((size_t)length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    getProgramBinary(program, length, &written, &format, binary.data());
+    if(written <= 0)
+        return;
+    binary.resize((size_t)written);
+
+    ProgramCacheHeader header;
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binarySize = (uint32_t)binary.size();
+    header.binaryHash = hashBytes(binary.data(), binary.size());
+
+    error_code error;
+    filesystem::create_directories(programCacheSettings().directory, error);
+    string path = pathOf(key);
+    string tempPath = path + ".tmp";
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    if(!file){
+        cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE::" << tempPath << endl;
+        return;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write(binary.data(), binary.size());
+    file.close();
+    if(!file){
+        std::remove(tempPath.c_str());
+        cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE::" << tempPath << endl;
+        return;
+    }
+    std::remove(path.c_str());
+    std::rename(tempPath.c_str(), path.c_str());
+}
+
+void ProgramBinaryCache::printReport() const{
+    cout << "SHADER::CACHE_REPORT::" << (isAvailable() ? programCacheSettings().directory : string("no program binaries")) << endl
+         << "    cold: " << statistics.compiled << " programs compiled and linked in " << statistics.compileMs << " ms";
+    if(statistics.rejected > 0)
+        cout << " (" << statistics.rejected << " cached binaries refused by the driver)";
+    if(statistics.malformed > 0)
+        cout << " (" << statistics.malformed << " malformed cache files)";
+    cout << endl
+         << "    warm: " << statistics.loaded << " programs from binaries in " << statistics.loadMs << " ms" << endl;
+}
+
+#endif /* ProgramCache_h */
@@ -0,0 +1,377 @@
+#ifndef RenderQueue_h
+#define RenderQueue_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "GeometryAllocator.h"
+#include "Hash.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+
+// standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// drawn in this order, the transparent pass blends without writing depth
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_TRANSPARENT = 1
+};
+
+// 64-bit sort key, most significant field first:
+//     opaque:      pass(2) shader(10) material(20) vertex array(8) depth(24)     state grouped, then front to back for early-Z
+//     transparent: pass(2) depth(24)  shader(10)   material(20) vertex array(8)  back to front (depth inverted), then state
+#define RENDER_KEY_SHADER_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 20
+#define RENDER_KEY_VERTEX_ARRAY_BITS 8
+#define RENDER_KEY_DEPTH_BITS 24
+
+// below this many draws per thread the sort stays on the calling thread
+#define RENDER_QUEUE_SORT_CHUNK 4096
+
+// what the last flush of the queue did
+struct RenderQueueStatistics {
+    size_t draws = 0;
+    size_t programBinds = 0;
+    size_t materialBinds = 0;           // Mesh::bindMaterial calls: material and vertex decoding uniforms
+    size_t vertexArrayBinds = 0;
+    size_t transformUpdates = 0;        // model and normalMatrix uniforms
+    size_t unsortedBinds = 0;           // program + material + vertex array binds the submission order would have needed
+    size_t bindsAvoided = 0;
+    unsigned int sortPasses = 0;        // radix passes, bytes every key shares are skipped
+    double sortMs = 0.0;
+    double executeMs = 0.0;             // CPU time of the state changes and draw calls
+};
+
+// MARK: - Class
+// ------------------
+// the draws of a frame in key order: every submit gets a sort key from its pass, program, material, vertex array
+// and view depth, the keys are radix sorted on the ThreadPool and the draws replayed binding only what changed
+// the key only decides the order, the replay compares the real state, so ids recycled after a wrap cost binds, never correctness
+// GL thread only (the sort tasks never touch GL)
+class RenderQueue {
+public:
+    // Functions
+    // ----------
+    static RenderQueue& shared();
+
+    // starts collecting the draws of a frame, depth is measured along forward from eye and quantized up to farPlane
+    void begin(const glm::vec3 &eye, const glm::vec3 &forward, float farPlane);
+    // one placement shared by the draws that reference it
+    unsigned int addTransform(const glm::mat4 &world, const glm::mat3 &normalMatrix);
+    // indexCount indices from firstIndex (counted from the mesh's first index) drawn with shader and the transform
+    void submit(RenderPass pass, Shader &shader, const Mesh &mesh, unsigned int transform, unsigned int firstIndex, unsigned int indexCount);
+    // sorts the keys (called by flush when it was not)
+    void sort();
+    // draws everything in key order, then the queue is empty until the next begin
+    void flush();
+
+    const RenderQueueStatistics& getStatistics() const { return statistics; }
+    void printStatistics() const;
+
+    static uint64_t makeKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t vertexArray, uint32_t depth);
+
+private:
+    // Structure
+    // ----------
+    struct Transform {
+        glm::mat4 world;
+        glm::mat3 normalMatrix;
+    };
+
+    struct RenderCommand {
+        RenderPass pass;
+        Shader *shader;
+        const Mesh *mesh;
+        unsigned int transform;
+        uint64_t material;              // materialHash, what the replay compares (the key holds a recyclable id)
+        GLuint firstIndex;              // in indices from the start of the arena's index buffer
+        GLuint indexCount;
+    };
+
+    // Properties
+    // ----------
+    glm::vec3 eye = glm::vec3(0.0f);
+    glm::vec3 forward = glm::vec3(0.0f, 0.0f, -1.0f);
+    float farPlane = 100.0f;
+    vector<Transform> transforms;
+    vector<RenderCommand> commands;
+    vector<uint64_t> keys;              // per command
+    vector<uint64_t> sortedKeys;
+    vector<uint32_t> order;             // command index per sorted key
+    vector<uint64_t> keyScratch;
+    vector<uint32_t> orderScratch;
+    vector<uint32_t> histograms;        // 256 digit counts per sort chunk
+    bool sorted = false;
+    // small ids for the key fields, kept across frames so the order stays stable
+    unordered_map<GLuint, uint32_t> shaderIDs;
+    unordered_map<uint64_t, uint32_t> materialIDs;
+    unordered_map<const VertexLayout*, uint32_t> vertexArrayIDs;
+    RenderQueueStatistics statistics;
+
+    RenderQueue() {}
+    template<typename Key>
+    static uint32_t idFor(unordered_map<Key, uint32_t> &ids, const Key &key, unsigned int bits);
+    static uint64_t materialHash(const Mesh &mesh);
+    size_t countUnsortedBinds() const;
+};
+
+// MARK: - Function realization
+// --------------------
+RenderQueue& RenderQueue::shared(){
+    static RenderQueue renderQueue;
+    return renderQueue;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t vertexArray, uint32_t depth){
+    const uint32_t depthMask = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+    uint64_t key = (uint64_t)pass << 62;
+    if(pass == RENDER_PASS_TRANSPARENT)
+        return key | (uint64_t)(depthMask - (depth & depthMask)) << 38 | (uint64_t)shader << 28 | (uint64_t)material << 8 | vertexArray;
+    return key | (uint64_t)shader << 52 | (uint64_t)material << 32 | (uint64_t)vertexArray << 24 | (depth & depthMask);
+}
+
+template<typename Key>
+uint32_t RenderQueue::idFor(unordered_map<Key, uint32_t> &ids, const Key &key, unsigned int bits){
+    auto found = ids.find(key);
+    if(found != ids.end())
+        return found->second;
+    // out of ids: start over, the groups of this frame may split but every draw still binds what it needs
+    if(ids.size() >= (1u << bits))
+        ids.clear();
+    uint32_t id = (uint32_t)ids.size();
+    ids.emplace(key, id);
+    return id;
+}
+
+uint64_t RenderQueue::materialHash(const Mesh &mesh){
+    // FNV-1a over what Mesh::bindMaterial sets: the material and, for packed vertices, the dequantization
+    uint64_t key[2] = { mesh.material->getHash(), mesh.layout->packed };
+    uint64_t hash = hashBytes(key, sizeof(key));
+    if(mesh.layout->packed){
+        hash = hashBytes(&mesh.getPositionOffset(), sizeof(glm::vec3), hash);
+        hash = hashBytes(&mesh.getPositionScale(), sizeof(glm::vec3), hash);
+    }
+    return hash;
+}
+
+void RenderQueue::begin(const glm::vec3 &newEye, const glm::vec3 &newForward, float newFarPlane){
+    eye = newEye;
+    forward = newForward;
+    farPlane = max(newFarPlane, 1e-3f);
+    transforms.clear();
+    commands.clear();
+    keys.clear();
+    sorted = false;
+}
+
+unsigned int RenderQueue::addTransform(const glm::mat4 &world, const glm::mat3 &normalMatrix){
+    transforms.push_back(Transform{ world, normalMatrix });
+    return (unsigned int)transforms.size() - 1;
+}
+
+void RenderQueue::submit(RenderPass pass, Shader &shader, const Mesh &mesh, unsigned int transform, unsigned int firstIndex, unsigned int indexCount){
+    if(indexCount == 0 || transform >= transforms.size() || !mesh.isResident())
+        return;
+
+    // view depth of the bounding sphere's center, quantized over [0, farPlane]
+    glm::vec3 center = glm::vec3(transforms[transform].world * glm::vec4(mesh.boundsCenter, 1.0f));
+    float depth = glm::clamp(glm::dot(center - eye, forward) / farPlane, 0.0f, 1.0f);
+    uint32_t quantizedDepth = (uint32_t)(depth * (float)((1u << RENDER_KEY_DEPTH_BITS) - 1));
+
+    RenderCommand command;
+    command.pass = pass;
+    command.shader = &shader;
+    command.mesh = &mesh;
+    command.transform = transform;
+    command.material = materialHash(mesh);
+    command.firstIndex = (GLuint)(mesh.geometry->indexOffset / indexTypeSize(mesh.indexType)) + firstIndex;
+    command.indexCount = indexCount;
+    commands.push_back(command);
+    keys.push_back(makeKey(pass, idFor(shaderIDs, shader.ID, RENDER_KEY_SHADER_BITS), idFor(materialIDs, command.material, RENDER_KEY_MATERIAL_BITS),
+                           idFor(vertexArrayIDs, mesh.layout, RENDER_KEY_VERTEX_ARRAY_BITS), quantizedDepth));
+    sorted = false;
+}
+
+size_t RenderQueue::countUnsortedBinds() const{
+    // the replay's rules applied to the submission order
+    size_t binds = 0;
+    GLuint program = 0;
+    uint64_t material = 0;
+    const VertexLayout *layout = nullptr;
+    for(const RenderCommand &command : commands){
+        if(command.shader->ID != program){
+            program = command.shader->ID;
+            material = 0;
+            binds++;
+        }
+        if(command.material != material){
+            material = command.material;
+            binds++;
+        }
+        if(command.mesh->layout != layout){
+            layout = command.mesh->layout;
+            binds++;
+        }
+    }
+    return binds;
+}
+
+void RenderQueue::sort(){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    statistics = RenderQueueStatistics();
+    statistics.draws = commands.size();
+    statistics.unsortedBinds = countUnsortedBinds();
+
+    size_t count = commands.size();
+    order.resize(count);
+    for(size_t i = 0; i < count; i++)
+        order[i] = (uint32_t)i;
+    sortedKeys.assign(keys.begin(), keys.end());
+    keyScratch.resize(count);
+    orderScratch.resize(count);
+
+    // bytes every key shares (the pass, unused id bits) cannot change the order
+    uint64_t anyBits = 0, allBits = ~0ull;
+    for(uint64_t key : keys){
+        anyBits |= key;
+        allBits &= key;
+    }
+    uint64_t varyingBits = anyBits ^ allBits;
+
+    // LSD radix sort over 8-bit digits: every chunk counts its digits, the counts become the chunks' write offsets
+    // (digit-major, chunk-minor, so equal digits keep their order and the passes stay stable), then every chunk scatters
+    size_t chunkCount = max<size_t>(1, min<size_t>(ThreadPool::shared().size() + 1, count / RENDER_QUEUE_SORT_CHUNK));
+    size_t chunkSize = (count + chunkCount - 1) / max<size_t>(chunkCount, 1);
+    histograms.resize(chunkCount * 256);
+    auto forEachChunk = [&](const function<void(size_t chunk, size_t begin, size_t end)> &body){
+        ThreadPool::shared().parallelFor(chunkCount, [&](size_t first, size_t last){
+            for(size_t chunk = first; chunk < last; chunk++)
+                body(chunk, chunk * chunkSize, min(count, (chunk + 1) * chunkSize));
+        });
+    };
+    for(unsigned int shift = 0; shift < 64 && count > 1; shift += 8){
+        if(((varyingBits >> shift) & 0xFF) == 0)
+            continue;
+        forEachChunk([&](size_t chunk, size_t begin, size_t end){
+            uint32_t *histogram = &histograms[chunk * 256];
+            fill(histogram, histogram + 256, 0u);
+            for(size_t i = begin; i < end; i++)
+                histogram[(sortedKeys[i] >> shift) & 0xFF]++;
+        });
+        uint32_t offset = 0;
+        for(size_t digit = 0; digit < 256; digit++)
+            for(size_t chunk = 0; chunk < chunkCount; chunk++){
+                uint32_t digitCount = histograms[chunk * 256 + digit];
+                histograms[chunk * 256 + digit] = offset;
+                offset += digitCount;
+            }
+        forEachChunk([&](size_t chunk, size_t begin, size_t end){
+            uint32_t *histogram = &histograms[chunk * 256];
+            for(size_t i = begin; i < end; i++){
+                uint32_t position = histogram[(sortedKeys[i] >> shift) & 0xFF]++;
+                keyScratch[position] = sortedKeys[i];
+                orderScratch[position] = order[i];
+            }
+        });
+        sortedKeys.swap(keyScratch);
+        order.swap(orderScratch);
+        statistics.sortPasses++;
+    }
+    sorted = true;
+    statistics.sortMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void RenderQueue::flush(){
+    if(!sorted)
+        sort();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    GeometryAllocator &allocator = GeometryAllocator::instance();
+    allocator.invalidateBinding();
+    GLuint program = 0;
+    uint64_t material = 0;
+    const VertexLayout *layout = nullptr;
+    unsigned int transform = UINT32_MAX;
+    bool blending = false;
+    for(uint32_t index : order){
+        const RenderCommand &command = commands[index];
+        Shader &shader = *command.shader;
+        if(command.pass == RENDER_PASS_TRANSPARENT && !blending){
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            blending = true;
+        }
+        // uniforms live in the program, a new one needs the material and the transform again
+        if(shader.ID != program){
+            shader.use();
+            program = shader.ID;
+            material = 0;
+            transform = UINT32_MAX;
+            statistics.programBinds++;
+        }
+        if(command.material != material){
+            command.mesh->bindMaterial(shader);
+            material = command.material;
+            statistics.materialBinds++;
+        }
+        if(command.mesh->layout != layout){
+            allocator.bindVertexArray(*command.mesh->layout);
+            layout = command.mesh->layout;
+            statistics.vertexArrayBinds++;
+        }
+        if(command.transform != transform){
+            transform = command.transform;
+            shader.setMat4("model"_u, transforms[transform].world);
+            shader.setMat3("normalMatrix"_u, transforms[transform].normalMatrix);
+            statistics.transformUpdates++;
+        }
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)command.indexCount, command.mesh->indexType,
+                                 (void*)((size_t)command.firstIndex * indexTypeSize(command.mesh->indexType)), (GLint)command.mesh->geometry->baseVertex);
+    }
+    if(blending){
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+    if(!commands.empty()){
+        glBindVertexArray(0);
+        allocator.invalidateBinding();
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    size_t binds = statistics.programBinds + statistics.materialBinds + statistics.vertexArrayBinds;
+    statistics.bindsAvoided = statistics.unsortedBinds > binds ? statistics.unsortedBinds - binds : 0;
+    statistics.executeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    transforms.clear();
+    commands.clear();
+    keys.clear();
+    sorted = false;
+}
+
+void RenderQueue::printStatistics() const{
+    cout << "RENDER::QUEUE::" << statistics.draws << " draws" << endl
+         << "    binds:   " << statistics.programBinds << " program, " << statistics.materialBinds << " material, "
+         << statistics.vertexArrayBinds << " vertex array (" << statistics.bindsAvoided << " of " << statistics.unsortedBinds << " avoided)" << endl
+         << "    uniform: " << statistics.transformUpdates << " transform updates" << endl
+         << "    sort:    " << statistics.sortMs << " ms CPU, " << statistics.sortPasses << " radix passes" << endl
+         << "    execute: " << statistics.executeMs << " ms CPU" << endl;
+}
+
+#endif /* RenderQueue_h */
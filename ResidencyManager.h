@@ -0,0 +1,202 @@
+#ifndef ResidencyManager_h
+#define ResidencyManager_h
+
+// MARK: - Library
+// -----------------
+// standard library
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+struct ResidencySettings {
+    bool keepCpuCopies = false;         // keep mesh vertices and indices in RAM after upload (CPU picking, culling), otherwise dropped
+    size_t gpuBudgetBytes = 0;          // textures and mesh buffers above it are evicted least recently drawn first, 0 never evicts
+    unsigned int idleFrames = 120;      // only what was not drawn for this many frames is evicted, at least GpuDeletionQueue::framesInFlight
+};
+
+enum ResidencyKind {
+    RESIDENCY_MESH,
+    RESIDENCY_TEXTURE,
+    RESIDENCY_KIND_COUNT
+};
+
+// MARK: - Class
+// ------------------
+// LRU bookkeeping of evictable GPU memory, owners register an evict and a reload function per resource
+// and touch it whenever it is drawn; evicted resources come back transparently on the next touch
+// GL thread only
+class ResidencyManager {
+public:
+    // Functions
+    // ----------
+    static ResidencyManager& instance();
+
+    // returns the id to touch, 0 is never tracked (and always resident)
+    // evict frees the GPU memory, reload restores it from the source and returns false if the source is gone
+    unsigned int track(ResidencyKind kind, size_t bytes, function<void()> evict, function<bool()> reload);
+    void untrack(unsigned int id);
+    // marks the resource drawn this frame, reloads it first if it was evicted; false if it is not resident
+    bool touch(unsigned int id);
+    // evicts down to the budget, call once per frame
+    void advanceFrame();
+
+    size_t getResidentBytes() const;
+    size_t getEvictedBytes() const;
+    void printStatistics() const;
+
+private:
+    // Structure
+    // ----------
+    struct Entry {
+        ResidencyKind kind;
+        size_t bytes;
+        uint64_t lastUsedFrame;
+        bool tracked;
+        bool resident;
+        bool failed;                    // its reload failed once, not retried every frame
+        function<void()> evict;
+        function<bool()> reload;
+    };
+
+    // Properties
+    // ----------
+    vector<Entry> entries;              // id - 1
+    vector<unsigned int> freeIDs;
+    uint64_t frame = 0;
+    size_t residentBytes[RESIDENCY_KIND_COUNT] = {};
+    size_t evictedBytes[RESIDENCY_KIND_COUNT] = {};
+    size_t evictions = 0;
+    size_t reloads = 0;
+
+    ResidencyManager() {}
+};
+
+// MARK: - Functions
+// -----------------
+ResidencySettings& residencySettings();
+
+// MARK: - Function realization
+// --------------------
+ResidencySettings& residencySettings(){
+    static ResidencySettings settings;
+    return settings;
+}
+
+ResidencyManager& ResidencyManager::instance(){
+    // never destroyed, like the GpuDeletionQueue: the registries untrack from their own static destructors
+    static ResidencyManager *manager = new ResidencyManager();
+    return *manager;
+}
+
+unsigned int ResidencyManager::track(ResidencyKind kind, size_t bytes, function<void()> evict, function<bool()> reload){
+    unsigned int id;
+    if(freeIDs.empty()){
+        entries.push_back(Entry());
+        id = (unsigned int)entries.size();
+    }
+    else{
+        id = freeIDs.back();
+        freeIDs.pop_back();
+    }
+    entries[id - 1] = Entry{ kind, bytes, frame, true, true, false, move(evict), move(reload) };
+    residentBytes[kind] += bytes;
+    return id;
+}
+
+void ResidencyManager::untrack(unsigned int id){
+    if(id == 0 || id > entries.size() || !entries[id - 1].tracked)
+        return;
+    Entry &entry = entries[id - 1];
+    (entry.resident ? residentBytes : evictedBytes)[entry.kind] -= entry.bytes;
+    entry = Entry();
+    entry.tracked = false;
+    freeIDs.push_back(id);
+}
+
+bool ResidencyManager::touch(unsigned int id){
+    if(id == 0 || id > entries.size())
+        return true;
+    Entry &entry = entries[id - 1];
+    entry.lastUsedFrame = frame;
+    if(entry.resident)
+        return true;
+    if(entry.failed)
+        return false;
+
+    if(!entry.reload()){
+        cout << "ERROR::RESIDENCY::RELOAD_FAILED::" << (entry.kind == RESIDENCY_MESH ? "mesh" : "texture") << endl;
+        entry.failed = true;
+        return false;
+    }
+    entry.resident = true;
+    evictedBytes[entry.kind] -= entry.bytes;
+    residentBytes[entry.kind] += entry.bytes;
+    reloads++;
+    return true;
+}
+
+void ResidencyManager::advanceFrame(){
+    frame++;
+    const ResidencySettings &settings = residencySettings();
+    size_t resident = getResidentBytes();
+    if(settings.gpuBudgetBytes == 0 || resident <= settings.gpuBudgetBytes)
+        return;
+
+    // least recently drawn first, among what sat idle long enough that no queued frame still reads it
+    vector<unsigned int> candidates;
+    for(unsigned int i = 0; i < entries.size(); i++)
+        if(entries[i].tracked && entries[i].resident && frame - entries[i].lastUsedFrame >= settings.idleFrames)
+            candidates.push_back(i);
+    sort(candidates.begin(), candidates.end(), [this](unsigned int a, unsigned int b){ return entries[a].lastUsedFrame < entries[b].lastUsedFrame; });
+
+    for(unsigned int i : candidates){
+        if(resident <= settings.gpuBudgetBytes)
+            break;
+        Entry &entry = entries[i];
+        entry.evict();
+        entry.resident = false;
+        residentBytes[entry.kind] -= entry.bytes;
+        evictedBytes[entry.kind] += entry.bytes;
+        resident -= entry.bytes;
+        evictions++;
+    }
+}
+
+size_t ResidencyManager::getResidentBytes() const{
+    size_t bytes = 0;
+    for(int kind = 0; kind < RESIDENCY_KIND_COUNT; kind++)
+        bytes += residentBytes[kind];
+    return bytes;
+}
+
+size_t ResidencyManager::getEvictedBytes() const{
+    size_t bytes = 0;
+    for(int kind = 0; kind < RESIDENCY_KIND_COUNT; kind++)
+        bytes += evictedBytes[kind];
+    return bytes;
+}
+
+void ResidencyManager::printStatistics() const{
+    const double MiB = 1024.0 * 1024.0;
+    const ResidencySettings &settings = residencySettings();
+    cout << "RESIDENCY::MANAGER" << endl
+         << "    budget:   ";
+    if(settings.gpuBudgetBytes)
+        cout << settings.gpuBudgetBytes / MiB << " MiB, idle after " << settings.idleFrames << " frames" << endl;
+    else
+        cout << "unlimited" << endl;
+    cout << "    resident: " << getResidentBytes() / MiB << " MiB (meshes " << residentBytes[RESIDENCY_MESH] / MiB
+         << ", textures " << residentBytes[RESIDENCY_TEXTURE] / MiB << ")" << endl
+         << "    evicted:  " << getEvictedBytes() / MiB << " MiB (meshes " << evictedBytes[RESIDENCY_MESH] / MiB
+         << ", textures " << evictedBytes[RESIDENCY_TEXTURE] / MiB << ")" << endl
+         << "    " << evictions << " evictions, " << reloads << " reloads" << endl;
+}
+
+#endif /* ResidencyManager_h */
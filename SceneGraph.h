@@ -0,0 +1,136 @@
+#ifndef SceneGraph_h
+#define SceneGraph_h
+
+// MARK: - Library
+// -----------------
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "ThreadPool.h"
+
+// standard library
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Class
+// ------------------
+// transform hierarchy in flat arrays (one per field), nodes are stored parent-before-child
+// setLocalTransform only marks the node, updateWorldMatrices recomputes the marked subtrees level by level,
+// the nodes of one level in parallel; normal matrices are computed with the world matrices so no shader inverts them
+class SceneGraph {
+public:
+    // Functions
+    // ----------
+    // parent must be an existing node or -1 for a root, returns the new node
+    unsigned int addNode(int parent, const glm::mat4 &localTransform = glm::mat4(1.0f));
+    void setLocalTransform(unsigned int node, const glm::mat4 &localTransform);
+    // brings every world and normal matrix up to date
+    void updateWorldMatrices();
+
+    size_t size() const { return parents.size(); }
+    int getParent(unsigned int node) const { return parents[node]; }
+    const glm::mat4& getLocalTransform(unsigned int node) const { return localTransforms[node]; }
+    const glm::mat4& getWorldMatrix(unsigned int node) const { return worldMatrices[node]; }
+    // transpose(inverse(mat3(world))), for normals
+    const glm::mat3& getNormalMatrix(unsigned int node) const { return normalMatrices[node]; }
+    // recomputed by the last update, e.g. to re-upload only those
+    bool wasUpdated(unsigned int node) const { return updated[node] != 0; }
+
+private:
+    // Properties
+    // ----------
+    vector<int> parents;
+    vector<unsigned int> depths;
+    vector<glm::mat4> localTransforms;
+    vector<glm::mat4> worldMatrices;
+    vector<glm::mat3> normalMatrices;
+    vector<uint8_t> dirty;              // local transform changed since the last update
+    vector<uint8_t> updated;            // recomputed by the last update, read by the children of the next level
+    vector<unsigned int> levelOrder;    // nodes sorted by depth, rebuilt after adding nodes
+    vector<size_t> levelStarts;         // levelOrder range of each depth, one past the last level at the end
+    bool anyDirty = false;
+    bool levelsValid = true;
+
+    // Functions
+    // ----------
+    void buildLevels();
+    void updateNode(unsigned int node);
+};
+
+// MARK: - Function realization
+// --------------------
+unsigned int SceneGraph::addNode(int parent, const glm::mat4 &localTransform){
+    unsigned int node = (unsigned int)parents.size();
+    if(parent >= (int)node)
+        parent = -1;        // would break the parent-before-child order
+    parents.push_back(parent);
+    depths.push_back(parent < 0 ? 0 : depths[parent] + 1);
+    localTransforms.push_back(localTransform);
+    worldMatrices.push_back(glm::mat4(1.0f));
+    normalMatrices.push_back(glm::mat3(1.0f));
+    dirty.push_back(1);
+    updated.push_back(0);
+    anyDirty = true;
+    levelsValid = false;
+    return node;
+}
+
+void SceneGraph::setLocalTransform(unsigned int node, const glm::mat4 &localTransform){
+    localTransforms[node] = localTransform;
+    dirty[node] = 1;
+    anyDirty = true;
+}
+
+void SceneGraph::buildLevels(){
+    // counting sort by depth, stable so every level keeps the storage order
+    unsigned int levelCount = 0;
+    for(unsigned int depth : depths)
+        levelCount = max(levelCount, depth + 1);
+    levelStarts.assign(levelCount + 1, 0);
+    for(unsigned int depth : depths)
+        levelStarts[depth + 1]++;
+    for(unsigned int level = 0; level < levelCount; level++)
+        levelStarts[level + 1] += levelStarts[level];
+    vector<size_t> cursor(levelStarts.begin(), levelStarts.end() - 1);
+    levelOrder.resize(parents.size());
+    for(unsigned int node = 0; node < parents.size(); node++)
+        levelOrder[cursor[depths[node]]++] = node;
+    levelsValid = true;
+}
+
+void SceneGraph::updateNode(unsigned int node){
+    int parent = parents[node];
+    updated[node] = dirty[node] || (parent >= 0 && updated[parent]);
+    if(!updated[node])
+        return;
+    worldMatrices[node] = parent >= 0 ? worldMatrices[parent] * localTransforms[node] : localTransforms[node];
+    normalMatrices[node] = glm::transpose(glm::inverse(glm::mat3(worldMatrices[node])));
+    dirty[node] = 0;
+}
+
+void SceneGraph::updateWorldMatrices(){
+    if(!anyDirty){
+        // nothing moved, the flags of the last update are stale now
+        fill(updated.begin(), updated.end(), 0);
+        return;
+    }
+    if(!levelsValid)
+        buildLevels();
+
+    // a level only reads the one above it, which is complete once its parallelFor returns
+    // small levels run inline, threads only pay off for thousands of nodes
+    const size_t minChunk = 512;
+    for(size_t level = 0; level + 1 < levelStarts.size(); level++){
+        size_t first = levelStarts[level];
+        ThreadPool::shared().parallelFor(levelStarts[level + 1] - first, [this, first](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++)
+                updateNode(levelOrder[first + i]);
+        }, minChunk);
+    }
+    anyDirty = false;
+}
+
+#endif /* SceneGraph_h */
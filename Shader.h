@@ -7,10 +7,18 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderUniform.h"
+#include "UniformBlocks.h"
+
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
@@ -18,9 +26,11 @@ class Shader {
 public:
 	//ID
 	unsigned int ID;
+	//sampler layout of the Material the sampler uniforms point at (set by Material::bind), reset to 0 after setting samplers directly
+	uint64_t samplerLayout = 0;
 
-	//constructor
-	Shader(const char* vertexPath, const char* fragmentPath);
+	//constructor, defines are inserted after #version in both stages (one permutation, see ShaderPermutations)
+	Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
 	
 	//ʹ/
 	void use();
@@ -28,11 +38,44 @@ public:
 	void setBool(const std::string& name, bool value) const;
 	void setInt(const std::string& name, int value) const;
 	void setFloat(const std::string& name, float value) const;
+	void setMat3(const std::string& name, glm::mat3 value) const;
 	void setMat4(const std::string& name, glm::mat4 value) const;
 	void setVec3(const std::string& name, glm::vec3 value) const;
+	//the same through a hashed name ("viewPos"_u): a search in the reflected table, no string and no GL query
+	void setBool(UniformID id, bool value) const;
+	void setInt(UniformID id, int value) const;
+	void setFloat(UniformID id, float value) const;
+	void setMat3(UniformID id, const glm::mat3& value) const;
+	void setMat4(UniformID id, const glm::mat4& value) const;
+	void setVec3(UniformID id, const glm::vec3& value) const;
+
+	//location of an active uniform, -1 if the program has none of that name (like glGetUniformLocation)
+	GLint getUniformLocation(UniformID id) const;
+	//typed handle resolved once, invalid (and a warning) if the GLSL type does not match T
+	template<typename T>
+	Uniform<T> uniform(UniformID id) const;
+	size_t getUniformCount() const { return uniforms.size(); }
+
+private:
+	//one active uniform, array elements get an entry each ("lights[2]") and the array name one for element 0
+	struct ReflectedUniform {
+		uint32_t hash;
+		GLint location;
+		GLenum type;
+	};
+	vector<ReflectedUniform> uniforms;	//sorted by hash, filled after linking
+
+	void reflectUniforms();
+	//binds the program's uniform blocks to the UniformBlocks binding points and checks their sizes
+	void bindUniformBlocks();
+	//compiles both stages into ID and links it, the binary goes to the ProgramBinaryCache under programKey
+	void compileAndLink(const string& vertexCode, const string& fragmentCode, uint64_t programKey);
+	//points the sampler2DArray uniforms at TEXTURE_ARRAY_UNIT_BASE and up, they default to unit 0 with the sampler2Ds
+	void assignArraySamplerUnits();
+	const ReflectedUniform* findUniform(uint32_t hash) const;
 };
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines) {
 	//1.ļлȡ/ƬԪɫ
 	//-------------------------------------------
 	string vertexCode;
@@ -66,6 +109,26 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 		cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << endl; 
 	}
 	
+	//#include "file" resolved next to the including file, the defines after #version
+	preprocessShaderSource(vertexCode, vertexPath, defines);
+	preprocessShaderSource(fragmentCode, fragmentPath, defines);
+
+	//2.program binary cache: the same sources, defines and driver link from the binary of an earlier launch
+	//-------------------------------------------
+	uint64_t programKey = ProgramBinaryCache::shared().keyOf(vertexCode, fragmentCode, defines.toString());
+	ID = glCreateProgram();
+	if (!ProgramBinaryCache::shared().load(programKey, ID))
+		compileAndLink(vertexCode, fragmentCode, programKey);
+
+	//3.uniform reflection
+	//-------------------------------------------
+	reflectUniforms();
+	bindUniformBlocks();
+	assignArraySamplerUnits();
+}
+
+void Shader::compileAndLink(const string& vertexCode, const string& fragmentCode, uint64_t programKey) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 	const char* vertexShaderCode = vertexCode.c_str();
 	const char* fragmentShaderCode = fragmentCode.c_str();
 	
@@ -98,9 +161,9 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	}
 	
 	//ɫ
-	ID = glCreateProgram();
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
+	ProgramBinaryCache::shared().prepare(ID);
 	glLinkProgram(ID);
 	//Ϣ
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -108,30 +171,149 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 		glGetProgramInfoLog(ID, 512, NULL, infoLog);
 		cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED" << infoLog << endl;
 	}
+	else
+		ProgramBinaryCache::shared().store(programKey, ID, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
 	
 	//ɾɫ
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
 }
 
+void Shader::assignArraySamplerUnits() {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	vector<GLint> assigned;	//an array name and its element 0 share a location
+	for (const ReflectedUniform& uniform : uniforms) {
+		if (uniform.type != GL_SAMPLER_2D_ARRAY || find(assigned.begin(), assigned.end(), uniform.location) != assigned.end())
+			continue;
+		if (assigned.empty())
+			glUseProgram(ID);
+		glUniform1i(uniform.location, TEXTURE_ARRAY_UNIT_BASE + (GLint)assigned.size());
+		assigned.push_back(uniform.location);
+	}
+	if (!assigned.empty())
+		glUseProgram((GLuint)previous);
+}
+
+void Shader::bindUniformBlocks() {
+	GLint count = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; i++) {
+		char name[64] = {};
+		glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(name), NULL, name);
+		GLuint binding = UniformBlocks::bindingOf(name);
+		if (binding == GL_INVALID_INDEX) {
+			cout << "WARNING::SHADER::UNKNOWN_UNIFORM_BLOCK::" << name << endl;
+			continue;
+		}
+		glUniformBlockBinding(ID, (GLuint)i, binding);
+
+		//std140 is fixed by the GLSL declaration, a different size means the C++ mirror is out of date
+		GLint size = 0;
+		glGetActiveUniformBlockiv(ID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		if ((size_t)size != UniformBlocks::sizeOf(binding))
+			cout << "ERROR::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH::" << name << " is " << size << " bytes, C++ has " << UniformBlocks::sizeOf(binding) << endl;
+	}
+}
+
+void Shader::reflectUniforms() {
+	uniforms.clear();
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	vector<GLchar> name(max(maxLength, 1) + 16);
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		GLint location = glGetUniformLocation(ID, name.data());
+		if (location < 0)
+			continue;	//uniform block members have no location
+		uniforms.push_back(ReflectedUniform{ hashUniformName(name.data(), length), location, type });
+
+		//arrays are reported once as "name[0]", the name alone and every element are valid names too
+		if (length > 3 && string(name.data() + length - 3, 3) == "[0]") {
+			string base(name.data(), length - 3);
+			uniforms.push_back(ReflectedUniform{ hashUniformName(base.data(), base.size()), location, type });
+			for (GLint element = 1; element < size; element++) {
+				string elementName = base + "[" + to_string(element) + "]";
+				GLint elementLocation = glGetUniformLocation(ID, elementName.c_str());
+				if (elementLocation >= 0)
+					uniforms.push_back(ReflectedUniform{ hashUniformName(elementName.data(), elementName.size()), elementLocation, type });
+			}
+		}
+	}
+
+	sort(uniforms.begin(), uniforms.end(), [](const ReflectedUniform& a, const ReflectedUniform& b) { return a.hash < b.hash; });
+	for (size_t i = 1; i < uniforms.size(); i++)
+		if (uniforms[i].hash == uniforms[i - 1].hash && uniforms[i].location != uniforms[i - 1].location)
+			cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION::locations " << uniforms[i - 1].location << " and " << uniforms[i].location << endl;
+}
+
+const Shader::ReflectedUniform* Shader::findUniform(uint32_t hash) const {
+	vector<ReflectedUniform>::const_iterator found = lower_bound(uniforms.begin(), uniforms.end(), hash,
+		[](const ReflectedUniform& uniform, uint32_t value) { return uniform.hash < value; });
+	return found != uniforms.end() && found->hash == hash ? &*found : nullptr;
+}
+
+GLint Shader::getUniformLocation(UniformID id) const {
+	const ReflectedUniform* uniform = findUniform(id.hash);
+	return uniform ? uniform->location : -1;
+}
+
+template<typename T>
+Uniform<T> Shader::uniform(UniformID id) const {
+	const ReflectedUniform* reflected = findUniform(id.hash);
+	if (!reflected)
+		return Uniform<T>();
+	if (!uniformTypeMatches<T>(reflected->type)) {
+		cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH::" << (id.name ? id.name : "(runtime name)") << endl;
+		return Uniform<T>();
+	}
+	return Uniform<T>(reflected->location);
+}
+
 void Shader::use() {
 	glUseProgram(ID);
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), (int)value);
 }
 void Shader::setFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+	glUniform1f(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), value);
 }
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+	glUniform1i(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), value);
+}
+void Shader::setMat3(const std::string& name, glm::mat3 value) const {
+	glUniformMatrix3fv(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), 1, GL_FALSE, glm::value_ptr(value));
 }
 void Shader::setMat4(const std::string& name, glm::mat4 value) const {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), 1, GL_FALSE, glm::value_ptr(value));
 }
 void Shader::setVec3(const std::string& name, glm::vec3 value) const {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	glUniform3fv(getUniformLocation(UniformID{ hashUniformName(name.data(), name.size()), nullptr }), 1, glm::value_ptr(value));
+}
+
+void Shader::setBool(UniformID id, bool value) const {
+	uploadUniform(getUniformLocation(id), value);
+}
+void Shader::setFloat(UniformID id, float value) const {
+	uploadUniform(getUniformLocation(id), value);
+}
+void Shader::setInt(UniformID id, int value) const {
+	uploadUniform(getUniformLocation(id), value);
+}
+void Shader::setMat3(UniformID id, const glm::mat3& value) const {
+	uploadUniform(getUniformLocation(id), value);
+}
+void Shader::setMat4(UniformID id, const glm::mat4& value) const {
+	uploadUniform(getUniformLocation(id), value);
+}
+void Shader::setVec3(UniformID id, const glm::vec3& value) const {
+	uploadUniform(getUniformLocation(id), value);
 }
 
 #endif // SHADER_H
@@ -0,0 +1,206 @@
+#ifndef ShaderPermutations_h
+#define ShaderPermutations_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "Material.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+#include "UniformBlocks.h"
+
+// standard library
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Class
+// ------------------
+// one vertex / fragment shader pair compiled once per define set, on first use (linked from the ProgramBinaryCache after
+// the first launch); what is drawn between use and the next use, stopTiming or endFrame is timed per permutation with
+// GL_TIME_ELAPSED queries, read back frames later so the CPU never waits for them
+// GL thread only
+class ShaderPermutations {
+public:
+    // Functions
+    // ----------
+    ShaderPermutations(const string &vertexPath, const string &fragmentPath) : vertexPath(vertexPath), fragmentPath(fragmentPath) {}
+    ~ShaderPermutations();
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    // the program of defines, compiled the first time it is asked for
+    Shader& get(const ShaderDefines &defines);
+    // get and glUseProgram, inside a frame the GPU time until the next use, stopTiming or endFrame counts for this permutation
+    Shader& use(const ShaderDefines &defines);
+    // before binding a program that is none of the permutations, so its draws are not counted for the last one used
+    void stopTiming() { stopQuery(); }
+    void beginFrame();
+    void endFrame();
+    size_t size() const { return permutations.size(); }
+
+    // what FragmentShader.glsl specializes on: the light counts of lights and the maps of material (nullptr: diffuse and specular)
+    static ShaderDefines lightingDefines(const LightsBlock &lights, const Material *material);
+    // GPU time per frame of every permutation since the last report
+    void printReport(const string &name);
+
+private:
+    // Structure
+    // ----------
+    struct Permutation {
+        ShaderDefines defines;
+        unique_ptr<Shader> shader;
+        uint64_t gpuNanoseconds = 0;    // read back since the last report
+    };
+
+    struct PendingQuery {
+        GLuint query;
+        size_t permutation;
+    };
+
+    // Properties
+    // ----------
+    string vertexPath;
+    string fragmentPath;
+    vector<Permutation> permutations;
+    unordered_map<string, size_t> lookup;   // ShaderDefines::toString -> permutations
+    vector<GLuint> idleQueries;
+    deque<PendingQuery> pendingQueries;     // ended, in submission order
+    GLuint runningQuery = 0;
+    size_t runningPermutation = 0;
+    bool inFrame = false;
+    unsigned int frames = 0;                // since the last report
+
+    // Functions
+    // ----------
+    size_t indexOf(const ShaderDefines &defines);
+    void stopQuery();
+    void collectQueries();
+};
+
+// MARK: - Function realization
+// --------------------
+ShaderPermutations::~ShaderPermutations(){
+    stopQuery();
+    for(const PendingQuery &pending : pendingQueries)
+        idleQueries.push_back(pending.query);
+    if(!idleQueries.empty())
+        glDeleteQueries((GLsizei)idleQueries.size(), idleQueries.data());
+}
+
+size_t ShaderPermutations::indexOf(const ShaderDefines &defines){
+    string name = defines.toString();
+    unordered_map<string, size_t>::const_iterator found = lookup.find(name);
+    if(found != lookup.end())
+        return found->second;
+
+    Permutation permutation;
+    permutation.defines = defines;
+    permutation.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+    permutations.push_back(move(permutation));
+    lookup[name] = permutations.size() - 1;
+    return permutations.size() - 1;
+}
+
+Shader& ShaderPermutations::get(const ShaderDefines &defines){
+    return *permutations[indexOf(defines)].shader;
+}
+
+Shader& ShaderPermutations::use(const ShaderDefines &defines){
+    size_t index = indexOf(defines);
+    Shader &shader = *permutations[index].shader;
+    shader.use();
+    if(inFrame && (runningQuery == 0 || runningPermutation != index)){
+        // one GL_TIME_ELAPSED query may run at a time, the previous permutation's ends here
+        stopQuery();
+        if(idleQueries.empty()){
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            idleQueries.push_back(query);
+        }
+        runningQuery = idleQueries.back();
+        idleQueries.pop_back();
+        runningPermutation = index;
+        glBeginQuery(GL_TIME_ELAPSED, runningQuery);
+    }
+    return shader;
+}
+
+void ShaderPermutations::beginFrame(){
+    collectQueries();
+    inFrame = true;
+}
+
+void ShaderPermutations::endFrame(){
+    stopQuery();
+    inFrame = false;
+    frames++;
+}
+
+void ShaderPermutations::stopQuery(){
+    if(runningQuery == 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pendingQueries.push_back(PendingQuery{ runningQuery, runningPermutation });
+    runningQuery = 0;
+}
+
+void ShaderPermutations::collectQueries(){
+    // queries finish in submission order, the first one still running ends the read back for this frame
+    while(!pendingQueries.empty()){
+        GLint available = 0;
+        glGetQueryObjectiv(pendingQueries.front().query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pendingQueries.front().query, GL_QUERY_RESULT, &nanoseconds);
+        permutations[pendingQueries.front().permutation].gpuNanoseconds += nanoseconds;
+        idleQueries.push_back(pendingQueries.front().query);
+        pendingQueries.pop_front();
+    }
+}
+
+ShaderDefines ShaderPermutations::lightingDefines(const LightsBlock &lights, const Material *material){
+    bool diffuseMap = material == nullptr, specularMap = material == nullptr, normalMap = false;
+    if(material){
+        for(const Texture &texture : material->getTextures()){
+            diffuseMap = diffuseMap || texture.type == "texture_diffuse";
+            specularMap = specularMap || texture.type == "texture_specular";
+            // texture arrays only hold diffuse and specular layers
+            normalMap = normalMap || (texture.type == "texture_normal" && texture.target == GL_TEXTURE_2D);
+        }
+    }
+
+    ShaderDefines defines;
+    defines.set("DIR_LIGHTS", max(0, min((int)lights.dirLightCount, MAX_DIR_LIGHTS)));
+    defines.set("POINT_LIGHTS", max(0, min((int)lights.pointLightCount, MAX_POINT_LIGHTS)));
+    defines.set("SPOT_LIGHTS", max(0, min((int)lights.spotLightCount, MAX_SPOT_LIGHTS)));
+    defines.set("HAS_DIFFUSE_MAP", diffuseMap ? 1 : 0);
+    defines.set("HAS_SPECULAR_MAP", specularMap ? 1 : 0);
+    defines.set("HAS_NORMAL_MAP", normalMap ? 1 : 0);
+    return defines;
+}
+
+void ShaderPermutations::printReport(const string &name){
+    cout << "SHADER::PERMUTATION_REPORT::" << name << " (" << permutations.size() << " permutations, " << frames << " frames)" << endl;
+    for(Permutation &permutation : permutations){
+        cout << "    " << (frames > 0 ? permutation.gpuNanoseconds / 1e6 / frames : 0.0) << " ms GPU per frame:";
+        for(const pair<string, string> &define : permutation.defines.getDefines())
+            cout << " " << define.first << "=" << define.second;
+        cout << (permutation.defines.empty() ? " no defines" : "") << endl;
+        permutation.gpuNanoseconds = 0;
+    }
+    frames = 0;
+}
+
+#endif /* ShaderPermutations_h */
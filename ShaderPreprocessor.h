@@ -0,0 +1,129 @@
+#ifndef ShaderPreprocessor_h
+#define ShaderPreprocessor_h
+
+// MARK: - Library
+// -----------------
+// standard library
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// #include nesting deeper than this is taken for a cycle
+#define SHADER_MAX_INCLUDE_DEPTH 16
+
+// MARK: - Class
+// ------------------
+// the compile-time switches of one shader permutation, emitted as #define lines right after #version
+// kept sorted by name, so equal sets give the same text (and the same program cache key) in any order of set
+class ShaderDefines {
+public:
+    // Functions
+    // ----------
+    ShaderDefines& set(const string &name, const string &value = "1");
+    ShaderDefines& set(const string &name, int value) { return set(name, to_string(value)); }
+
+    const vector<pair<string, string>>& getDefines() const { return defines; }
+    bool empty() const { return defines.empty(); }
+    string toString() const;
+    bool operator==(const ShaderDefines &other) const { return defines == other.defines; }
+
+private:
+    // Properties
+    // ----------
+    vector<pair<string, string>> defines;
+};
+
+// MARK: - Functions
+// -----------------
+// inserts the defines after the #version line and replaces every #include "file" line with that file, read relative to the
+// including file; a file included twice is only pasted the first time. false (with the line left out) when an include is missing
+bool preprocessShaderSource(string &source, const string &path, const ShaderDefines &defines);
+
+// MARK: - Function realization
+// --------------------
+ShaderDefines& ShaderDefines::set(const string &name, const string &value){
+    vector<pair<string, string>>::iterator found = lower_bound(defines.begin(), defines.end(), name,
+        [](const pair<string, string> &define, const string &key){ return define.first < key; });
+    if(found != defines.end() && found->first == name)
+        found->second = value;
+    else
+        defines.insert(found, make_pair(name, value));
+    return *this;
+}
+
+string ShaderDefines::toString() const{
+    string text;
+    for(const pair<string, string> &define : defines)
+        text += "#define " + define.first + " " + define.second + "\n";
+    return text;
+}
+
+static string shaderDirectoryOf(const string &path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? string() : path.substr(0, slash + 1);
+}
+
+// appends source to output with its includes resolved, included holds every file pasted so far
+static bool resolveShaderIncludes(const string &source, const string &path, vector<string> &included, string &output, unsigned int depth){
+    bool resolved = true;
+    istringstream lines(source);
+    string line;
+    while(getline(lines, line)){
+        size_t start = line.find_first_not_of(" \t");
+        if(start == string::npos || line.compare(start, 8, "#include") != 0){
+            output += line;
+            output += '\n';
+            continue;
+        }
+
+        size_t open = line.find('"', start + 8), close = open == string::npos ? open : line.find('"', open + 1);
+        if(close == string::npos){
+            cout << "ERROR::SHADER::INCLUDE_SYNTAX::" << path << "::" << line << endl;
+            resolved = false;
+            continue;
+        }
+        string includePath = shaderDirectoryOf(path) + line.substr(open + 1, close - open - 1);
+        if(find(included.begin(), included.end(), includePath) != included.end())
+            continue;
+        if(depth >= SHADER_MAX_INCLUDE_DEPTH){
+            cout << "ERROR::SHADER::INCLUDE_TOO_DEEP::" << includePath << endl;
+            resolved = false;
+            continue;
+        }
+        ifstream file(includePath, ios::binary);
+        if(!file){
+            cout << "ERROR::SHADER::INCLUDE_NOT_FOUND::" << includePath << " (from " << path << ")" << endl;
+            resolved = false;
+            continue;
+        }
+        stringstream includeStream;
+        includeStream << file.rdbuf();
+        included.push_back(includePath);
+        resolved = resolveShaderIncludes(includeStream.str(), includePath, included, output, depth + 1) && resolved;
+    }
+    return resolved;
+}
+
+bool preprocessShaderSource(string &source, const string &path, const ShaderDefines &defines){
+    string output;
+    vector<string> included(1, path);
+    bool resolved = resolveShaderIncludes(source, path, included, output, 0);
+
+    // #version has to stay the first directive, the defines follow it
+    if(!defines.empty()){
+        size_t version = output.find("#version");
+        size_t insertAt = version == string::npos ? 0 : output.find('\n', version);
+        insertAt = insertAt == string::npos ? output.size() : insertAt + (version == string::npos ? 0 : 1);
+        output.insert(insertAt, defines.toString());
+    }
+    source = move(output);
+    return resolved;
+}
+
+#endif /* ShaderPreprocessor_h */
@@ -0,0 +1,98 @@
+#ifndef ShaderUniform_h
+#define ShaderUniform_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+// standard library
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// a uniform name reduced to its FNV-1a hash, what Shader looks its reflected uniforms up by
+// "spotLight.position"_u is folded by the compiler, no string is built or compared at runtime
+struct UniformID {
+    uint32_t hash;
+    const char *name;                   // for messages only, nullptr for names hashed at runtime
+};
+
+#define UNIFORM_HASH_SEED 2166136261u
+
+// sampler2DArray uniforms use the units from here on (Shader sets them after linking, Material binds its texture arrays there),
+// a sampler2D and a sampler2DArray on one unit fail the draw
+#define TEXTURE_ARRAY_UNIT_BASE 8
+
+// continues hash over length more characters, so "texture_diffuse" + "1" hashes like "texture_diffuse1"
+constexpr uint32_t hashUniformName(const char *name, size_t length, uint32_t hash = UNIFORM_HASH_SEED){
+    for(size_t i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    return hash;
+}
+
+constexpr UniformID operator""_u(const char *name, size_t length){
+    return UniformID{ hashUniformName(name, length), name };
+}
+
+// MARK: - Functions
+// -----------------
+// declared before Uniform, set() of the scalar types finds them by ordinary lookup only
+inline void uploadUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void uploadUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void uploadUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void uploadUniform(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, glm::value_ptr(value)); }
+inline void uploadUniform(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, glm::value_ptr(value)); }
+inline void uploadUniform(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, glm::value_ptr(value)); }
+inline void uploadUniform(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+inline void uploadUniform(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+// MARK: - Class
+// ------------------
+// a uniform location resolved once with its GLSL type checked (Shader::uniform), set() is a single glUniform call
+// on the program in use; an invalid handle (missing or mistyped uniform) ignores set() like location -1 does
+template<typename T>
+class Uniform {
+public:
+    // Functions
+    // ----------
+    Uniform() : location(-1) {}
+    explicit Uniform(GLint location) : location(location) {}
+
+    void set(const T &value) const { uploadUniform(location, value); }
+    bool valid() const { return location >= 0; }
+    GLint getLocation() const { return location; }
+
+private:
+    // Properties
+    // ----------
+    GLint location;
+};
+
+// whether a C++ type can set a uniform of the GLSL type glGetActiveUniform reported, int also sets samplers
+template<typename T> bool uniformTypeMatches(GLenum type);
+template<> inline bool uniformTypeMatches<bool>(GLenum type) { return type == GL_BOOL; }
+template<> inline bool uniformTypeMatches<float>(GLenum type) { return type == GL_FLOAT; }
+template<> inline bool uniformTypeMatches<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+template<> inline bool uniformTypeMatches<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+template<> inline bool uniformTypeMatches<glm::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
+template<> inline bool uniformTypeMatches<glm::mat3>(GLenum type) { return type == GL_FLOAT_MAT3; }
+template<> inline bool uniformTypeMatches<glm::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
+template<> inline bool uniformTypeMatches<int>(GLenum type) {
+    switch(type){
+        case GL_INT: case GL_BOOL:
+        case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+#endif /* ShaderUniform_h */
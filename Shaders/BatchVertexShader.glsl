@@ -0,0 +1,72 @@
+#version 430 core
+layout (location = 0) in vec4 aPos;         // xyz, packed: snorm16 inside the mesh bounds
+layout (location = 1) in vec3 aNormal;      // xyz, packed: octahedral snorm16 in xy
+layout (location = 2) in vec2 aTexCoords;   // float or half
+layout (location = 3) in vec4 aTangent;     // xyz, packed: tangent frame quaternion (w < 0 mirrors the bitangent)
+layout (location = 4) in vec3 aBitangent;   // full format only
+layout (location = 14) in uint aDrawID;     // BatchRenderer: the command's baseInstance, one per draw
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec3 Tangent;
+out vec3 Bitangent;
+flat out uint MaterialIndex;
+
+// BatchRenderer DrawRecord, one per mesh placement
+struct DrawRecord
+{
+	mat4 model;
+	vec4 normalMatrix[3];       // columns of transpose(inverse(mat3(model)))
+	vec4 positionOffset;        // w = 1 for packed vertices
+	vec4 positionScale;
+	uvec4 material;             // x: material index
+};
+
+layout (std430, binding = 0) readonly buffer DrawRecords
+{
+	DrawRecord records[];
+};
+
+#include "PerFrame.glsl"
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec3 rotateByQuaternion(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	DrawRecord record = records[aDrawID];
+	vec3 position = aPos.xyz;
+	vec3 normal = aNormal;
+	vec3 tangent = aTangent.xyz;
+	vec3 bitangent = aBitangent;
+	if(record.positionOffset.w > 0.0)
+	{
+		position = record.positionOffset.xyz + record.positionScale.xyz * aPos.xyz;
+		normal = decodeOctahedral(aNormal.xy);
+		vec4 frame = normalize(aTangent);
+		tangent = rotateByQuaternion(frame, vec3(1.0, 0.0, 0.0));
+		bitangent = cross(normal, tangent) * (aTangent.w < 0.0 ? -1.0 : 1.0);
+	}
+
+	mat4 world = record.model;
+	mat3 normalTransform = mat3(record.normalMatrix[0].xyz, record.normalMatrix[1].xyz, record.normalMatrix[2].xyz);
+
+	gl_Position = projection * view * world * vec4(position, 1.0);
+	Normal = normalTransform * normal;
+	Tangent = mat3(world) * tangent;
+	Bitangent = mat3(world) * bitangent;
+	FragPos = vec3(world * vec4(position, 1.0));	//Translate to world space
+	TexCoords = aTexCoords;
+	MaterialIndex = record.material.x;
+}
\ No newline at end of file
@@ -11,107 +11,153 @@ in vec2 TexCoords;
 
 //Struct
 //-------------------------------------------------
-struct Material{
-    sampler2D diffuse;
-    sampler2D specular;
-    float glossy;
-};
-
-//Light
-struct DirLight{
-    vec3 direction;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight{
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "Lights.glsl"
 
-struct SpotLight{
-    vec3 position;
-    vec3 spotDirection;
-    float cutOff;
-    float outerCutOff;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+//Permutation: defines set by Shader (ShaderPermutations::lightingDefines), without them every light type
+//runs up to its count in the Lights block and both maps are sampled
+//-------------------------------------------------
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 0
+#endif
+#ifdef DIR_LIGHTS
+#define DIR_LIGHT_COUNT DIR_LIGHTS
+#else
+#define DIR_LIGHT_COUNT min(lightCounts.x, MAX_DIR_LIGHTS)
+#endif
+#ifdef POINT_LIGHTS
+#define POINT_LIGHT_COUNT POINT_LIGHTS
+#else
+#define POINT_LIGHT_COUNT min(lightCounts.y, MAX_POINT_LIGHTS)
+#endif
+#ifdef SPOT_LIGHTS
+#define SPOT_LIGHT_COUNT SPOT_LIGHTS
+#else
+#define SPOT_LIGHT_COUNT min(lightCounts.z, MAX_SPOT_LIGHTS)
+#endif
 
 //Function
 //-------------------------------------------------
-vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDirection);
-vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDirection);
-vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDirection);
-
-//Uniform Variables
+vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor);
+vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor);
+vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor);
+vec3 diffuseTexel();
+vec3 specularTexel();
+vec3 surfaceNormal();
+
+//Uniform Blocks, bound by Shader to the UniformBlocks binding points
 //-------------------------------------------------
-//Material
-uniform Material material;
+#include "PerFrame.glsl"
 
-//Light
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
-
-//Light Attributes
-uniform vec3 viewPos;
+//Material
+layout (std140) uniform Material
+{
+    vec4 diffuseColor;      //scales the textures
+    vec4 specularColor;
+    float glossy;
+    float diffuseLayer;     //>= 0: the texture is this layer of the array below (models with packed textures)
+    float specularLayer;
+    float padding;
+} material;
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+uniform sampler2DArray texture_diffuse_array;
+uniform sampler2DArray texture_specular_array;
+#if HAS_NORMAL_MAP
+uniform sampler2D texture_normal1;
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
 
 //Main
 //-------------------------------------------------
 void main()
 {
     //Attributes
-    vec3 normal = normalize(Normal);
+    vec3 normal = surfaceNormal();
     vec3 viewDirection = normalize(viewPos - FragPos);
+    //sampled once, every light scales them
+    vec3 diffuseColor = diffuseTexel();
+    vec3 specularColor = specularTexel();
     
     //Dircetion Light
-    vec3 result = calculateDirLight(dirLight, normal, viewDirection);
+    vec3 result = vec3(0.0);
+    for(int i = 0; i < DIR_LIGHT_COUNT; i++)
+        result += calculateDirLight(dirLights[i], normal, viewDirection, diffuseColor, specularColor);
     
     //Point Light
-    result += calculatePointLight(pointLight, normal, FragPos, viewDirection);
+    for(int i = 0; i < POINT_LIGHT_COUNT; i++)
+        result += calculatePointLight(pointLights[i], normal, FragPos, viewDirection, diffuseColor, specularColor);
 
     //Spot Light
-    result += calculateSpotLight(spotLight, normal, FragPos, viewDirection);
+    for(int i = 0; i < SPOT_LIGHT_COUNT; i++)
+        result += calculateSpotLight(spotLights[i], normal, FragPos, viewDirection, diffuseColor, specularColor);
     
     FragColor = vec4(result, 1.0f);
 }
 
 //Function Body
 //-------------------------------------------------
+//Material
+//the layer is uniform, only the sampled branch is evaluated; without a map the color alone
+vec3 diffuseTexel(){
+#if HAS_DIFFUSE_MAP
+    vec3 texel = material.diffuseLayer >= 0.0 ? texture(texture_diffuse_array, vec3(TexCoords, material.diffuseLayer)).rgb
+                                              : texture(texture_diffuse1, TexCoords).rgb;
+    return texel * material.diffuseColor.rgb;
+#else
+    return material.diffuseColor.rgb;
+#endif
+}
+
+vec3 specularTexel(){
+#if HAS_SPECULAR_MAP
+    vec3 texel = material.specularLayer >= 0.0 ? texture(texture_specular_array, vec3(TexCoords, material.specularLayer)).rgb
+                                               : texture(texture_specular1, TexCoords).rgb;
+    return texel * material.specularColor.rgb;
+#else
+    return material.specularColor.rgb;
+#endif
+}
+
+//tangent space normal map on top of the interpolated frame
+vec3 surfaceNormal(){
+#if HAS_NORMAL_MAP
+    //only x and y are stored (BC5 normal maps sample z as 0), z is rebuilt from the unit length
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(texture_normal1, TexCoords).xy * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
+    mat3 tangentFrame = mat3(normalize(Tangent), normalize(Bitangent), normalize(Normal));
+    return normalize(tangentFrame * tangentNormal);
+#else
+    return normalize(Normal);
+#endif
+}
+
 //Direction Light
-vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDirection){
+vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor){
     //Light Direction
     //------------
     vec3 lightDirection = normalize(-light.direction);
     
     //ambient
     //------------
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)).rgb;
+    vec3 ambient = light.ambient * diffuseColor;
     
     //diffuse
     //------------
-    vec3 diffuse = light.diffuse * texture(material.diffuse, TexCoords).rgb * max(dot(normal, lightDirection), 0.0);
+    vec3 diffuse = light.diffuse * diffuseColor * max(dot(normal, lightDirection), 0.0);
 
     //specular(Blinn-Phong Shading)
     //------------
     vec3 halfDirection = normalize(lightDirection + viewDirection);
-    vec3 specular = light.specular * texture(material.specular, TexCoords).rgb * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
+    vec3 specular = light.specular * specularColor * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
     
     //final = ambient + diffuse + specular
     //------------
@@ -119,7 +165,7 @@ vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDirection){
 }
 
 //Point light
-vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDirection){
+vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor){
     //Attenuation
     //------------
     float distance = length(light.position - fragPos);
@@ -131,16 +177,16 @@ vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewD
     
     //ambient
     //------------
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)).rgb;
+    vec3 ambient = light.ambient * diffuseColor;
     
     //diffuse
     //------------
-    vec3 diffuse = light.diffuse * texture(material.diffuse, TexCoords).rgb * max(dot(normal, lightDirection), 0.0);
+    vec3 diffuse = light.diffuse * diffuseColor * max(dot(normal, lightDirection), 0.0);
     
     //specular(Blinn-Phong Shading)
     //------------
     vec3 halfDirection = normalize(lightDirection + viewDirection);
-    vec3 specular = light.specular * texture(material.specular, TexCoords).rgb * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
+    vec3 specular = light.specular * specularColor * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
     
     //final = attenuation * (ambient + diffuse + specular)
     //------------
@@ -148,7 +194,7 @@ vec3 calculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewD
 }
 
 //Spot light
-vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDirection){
+vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDirection, vec3 diffuseColor, vec3 specularColor){
     //Light Direction
     //------------
     vec3 lightDirection = normalize(light.position - fragPos);
@@ -166,16 +212,16 @@ vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir
 
     //ambient
     //------------
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)).rgb;
+    vec3 ambient = light.ambient * diffuseColor;
     
     //diffuse
     //------------
-    vec3 diffuse = light.diffuse * texture(material.diffuse, TexCoords).rgb * max(dot(normal, lightDirection), 0.0);
+    vec3 diffuse = light.diffuse * diffuseColor * max(dot(normal, lightDirection), 0.0);
     
     //specular(Blinn-Phong Shading)
     //------------
     vec3 halfDirection = normalize(lightDirection + viewDirection);
-    vec3 specular = light.specular * texture(material.specular, TexCoords).rgb * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
+    vec3 specular = light.specular * specularColor * pow(max(dot(normal, halfDirection), 0.0), material.glossy);
     
     //final = attenuation * intensity * (ambient + diffuse + specular)
     //------------
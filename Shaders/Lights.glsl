@@ -0,0 +1,47 @@
+//UniformBlocks Lights, binding UNIFORM_BLOCK_LIGHTS (#include "Lights.glsl")
+//-------------------------------------------------
+//Light, std140: every float fills the tail of the vec3 before it (UniformBlocks.h mirrors these)
+#define MAX_DIR_LIGHTS 2
+#define MAX_POINT_LIGHTS 4
+#define MAX_SPOT_LIGHTS 2
+
+struct DirLight{
+    vec3 direction;
+    
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight{
+    vec3 position;
+    float constant;
+    
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight{
+    vec3 position;
+    float cutOff;
+    vec3 spotDirection;
+    float outerCutOff;
+    
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform Lights
+{
+    ivec4 lightCounts;      //x: directional, y: point, z: spot
+    DirLight dirLights[MAX_DIR_LIGHTS];
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
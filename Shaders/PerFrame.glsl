@@ -0,0 +1,9 @@
+//UniformBlocks PerFrame, binding UNIFORM_BLOCK_PER_FRAME (#include "PerFrame.glsl")
+//-------------------------------------------------
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+};
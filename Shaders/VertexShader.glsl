@@ -1,22 +1,66 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+layout (location = 0) in vec4 aPos;         // xyz, packed: snorm16 inside the mesh bounds
+layout (location = 1) in vec3 aNormal;      // xyz, packed: octahedral snorm16 in xy
+layout (location = 2) in vec2 aTexCoords;   // float or half
+layout (location = 3) in vec4 aTangent;     // xyz, packed: tangent frame quaternion (w < 0 mirrors the bitangent)
+layout (location = 4) in vec3 aBitangent;   // full format only
+layout (location = 7) in mat4 aInstanceModel;          // instanced only, InstanceData (7-10)
+layout (location = 11) in mat3 aInstanceNormalMatrix;  // instanced only (11-13)
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out vec3 Tangent;
+out vec3 Bitangent;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 normalMatrix;
+uniform mat3 normalMatrix;       // transpose(inverse(mat3(model))), computed on the CPU with the model matrix
+
+#include "PerFrame.glsl"
+
+// Model::drawInstanced, the instance matrices apply on top of model
+uniform bool instanced;
+
+// Mesh VERTEX_ENCODING_PACKED
+uniform bool packedVertex;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec3 rotateByQuaternion(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-	Normal = mat3(transpose(inverse(model))) * aNormal; 
-	//Normal = mat3(normalMatrix) * aNormal;
-	FragPos = vec3(model * vec4(aPos, 1.0));	//Translate to world space
+	vec3 position = aPos.xyz;
+	vec3 normal = aNormal;
+	vec3 tangent = aTangent.xyz;
+	vec3 bitangent = aBitangent;
+	if(packedVertex)
+	{
+		position = positionOffset + positionScale * aPos.xyz;
+		normal = decodeOctahedral(aNormal.xy);
+		vec4 frame = normalize(aTangent);
+		tangent = rotateByQuaternion(frame, vec3(1.0, 0.0, 0.0));
+		bitangent = cross(normal, tangent) * (aTangent.w < 0.0 ? -1.0 : 1.0);
+	}
+
+	mat4 world = instanced ? aInstanceModel * model : model;
+	mat3 normalTransform = instanced ? aInstanceNormalMatrix * normalMatrix : normalMatrix;
+
+    gl_Position = projection * view * world * vec4(position, 1.0);
+	Normal = normalTransform * normal;
+	Tangent = mat3(world) * tangent;
+	Bitangent = mat3(world) * bitangent;
+	FragPos = vec3(world * vec4(position, 1.0));	//Translate to world space
 	TexCoords = vec2(aTexCoords.x, aTexCoords.y);
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef Simd_h
+#define Simd_h
+
+// MARK: - Library
+// -----------------
+// SSE2 on x86, NEON on Apple silicon / ARM, plain arrays everywhere else
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
+#include <algorithm>
+
+// MARK: - Structure
+// ------------------
+// four packed floats, the only vector type the CPU texture tools need
+struct Float4 {
+#if defined(SIMD_SSE2)
+    __m128 v;
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+
+    // operators +, -, *, min4, max4 and selectLess (per lane a < b ? x : y) are defined per platform below
+    static Float4 load(const float *p);
+    static Float4 splat(float s);
+    void store(float *p) const;
+};
+
+// MARK: - Function realization
+// --------------------
+#if defined(SIMD_SSE2)
+inline Float4 Float4::load(const float *p) { Float4 r; r.v = _mm_loadu_ps(p); return r; }
+inline Float4 Float4::splat(float s) { Float4 r; r.v = _mm_set1_ps(s); return r; }
+inline void Float4::store(float *p) const { _mm_storeu_ps(p, v); }
+inline Float4 operator+(Float4 a, Float4 b) { Float4 r; r.v = _mm_add_ps(a.v, b.v); return r; }
+inline Float4 operator-(Float4 a, Float4 b) { Float4 r; r.v = _mm_sub_ps(a.v, b.v); return r; }
+inline Float4 operator*(Float4 a, Float4 b) { Float4 r; r.v = _mm_mul_ps(a.v, b.v); return r; }
+inline Float4 min4(Float4 a, Float4 b) { Float4 r; r.v = _mm_min_ps(a.v, b.v); return r; }
+inline Float4 max4(Float4 a, Float4 b) { Float4 r; r.v = _mm_max_ps(a.v, b.v); return r; }
+inline Float4 selectLess(Float4 a, Float4 b, Float4 x, Float4 y) { __m128 m = _mm_cmplt_ps(a.v, b.v); Float4 r; r.v = _mm_or_ps(_mm_and_ps(m, x.v), _mm_andnot_ps(m, y.v)); return r; }
+#elif defined(SIMD_NEON)
+inline Float4 Float4::load(const float *p) { Float4 r; r.v = vld1q_f32(p); return r; }
+inline Float4 Float4::splat(float s) { Float4 r; r.v = vdupq_n_f32(s); return r; }
+inline void Float4::store(float *p) const { vst1q_f32(p, v); }
+inline Float4 operator+(Float4 a, Float4 b) { Float4 r; r.v = vaddq_f32(a.v, b.v); return r; }
+inline Float4 operator-(Float4 a, Float4 b) { Float4 r; r.v = vsubq_f32(a.v, b.v); return r; }
+inline Float4 operator*(Float4 a, Float4 b) { Float4 r; r.v = vmulq_f32(a.v, b.v); return r; }
+inline Float4 min4(Float4 a, Float4 b) { Float4 r; r.v = vminq_f32(a.v, b.v); return r; }
+inline Float4 max4(Float4 a, Float4 b) { Float4 r; r.v = vmaxq_f32(a.v, b.v); return r; }
+inline Float4 selectLess(Float4 a, Float4 b, Float4 x, Float4 y) { Float4 r; r.v = vbslq_f32(vcltq_f32(a.v, b.v), x.v, y.v); return r; }
+#else
+inline Float4 Float4::load(const float *p) { Float4 r; for(int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+inline Float4 Float4::splat(float s) { Float4 r; for(int i = 0; i < 4; i++) r.v[i] = s; return r; }
+inline void Float4::store(float *p) const { for(int i = 0; i < 4; i++) p[i] = v[i]; }
+inline Float4 operator+(Float4 a, Float4 b) { for(int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline Float4 operator-(Float4 a, Float4 b) { for(int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline Float4 operator*(Float4 a, Float4 b) { for(int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline Float4 min4(Float4 a, Float4 b) { for(int i = 0; i < 4; i++) a.v[i] = std::min(a.v[i], b.v[i]); return a; }
+inline Float4 max4(Float4 a, Float4 b) { for(int i = 0; i < 4; i++) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+inline Float4 selectLess(Float4 a, Float4 b, Float4 x, Float4 y) { for(int i = 0; i < 4; i++) x.v[i] = a.v[i] < b.v[i] ? x.v[i] : y.v[i]; return x; }
+#endif
+
+// horizontal helpers
+inline float horizontalSum(Float4 a) { float f[4]; a.store(f); return (f[0] + f[1]) + (f[2] + f[3]); }
+inline float horizontalMin(Float4 a) { float f[4]; a.store(f); return std::min(std::min(f[0], f[1]), std::min(f[2], f[3])); }
+inline float horizontalMax(Float4 a) { float f[4]; a.store(f); return std::max(std::max(f[0], f[1]), std::max(f[2], f[3])); }
+
+#endif /* Simd_h */
@@ -0,0 +1,213 @@
+#ifndef TextureArray_h
+#define TextureArray_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "GpuResource.h"
+
+// standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+struct TextureArraySettings {
+    bool enabled = false;               // models copy their textures of equal size, format and mip count into GL_TEXTURE_2D_ARRAY layers at load
+    unsigned int minLayers = 2;         // smaller groups stay 2D textures
+};
+
+// where a packed texture went
+struct TextureLayer {
+    GLuint array;
+    int layer;
+};
+
+// one model's packing, the binds are what drawing its meshes in order costs through Material::bind
+struct TextureArrayReport {
+    size_t textures = 0;                // distinct 2D textures of the model
+    size_t packed = 0;                  // copied into a layer
+    size_t arrays = 0;
+    size_t arrayBytes = 0;              // every level of every layer of the arrays
+    size_t packedBytes = 0;             // the same textures as separate 2D textures
+    size_t bindsBefore = 0;
+    size_t bindsAfter = 0;
+    double copyMs = 0.0;
+
+    void print(const string &name) const;
+};
+
+// MARK: - Functions
+// -----------------
+TextureArraySettings& textureArraySettings();
+// GL thread only: groups the textures by size, internal format and mip count and copies every group of at least
+// minLayers (split at GL_MAX_ARRAY_TEXTURE_LAYERS) level by level into a new texture array, so every layer keeps its own
+// mip chain and nothing bleeds between layers; layers gets an entry per copied texture, releasing the sources is left to the caller
+vector<GpuTexture> buildTextureArrays(const vector<GLuint> &textureIDs, unordered_map<GLuint, TextureLayer> &layers, TextureArrayReport &report);
+
+// MARK: - Function realization
+// --------------------
+TextureArraySettings& textureArraySettings(){
+    static TextureArraySettings settings;
+    return settings;
+}
+
+// 8-bit formats survive a read back as RGBA bytes, anything else is left as it is
+static size_t textureArrayTexelSize(GLint internalFormat){
+    switch(internalFormat){
+        case GL_RED: case GL_R8:                            return 1;
+        case GL_RG: case GL_RG8:                            return 2;
+        case GL_RGB: case GL_RGB8: case GL_SRGB8:           return 3;
+        case GL_RGBA: case GL_RGBA8: case GL_SRGB8_ALPHA8:  return 4;
+        default:                                            return 0;
+    }
+}
+
+vector<GpuTexture> buildTextureArrays(const vector<GLuint> &textureIDs, unordered_map<GLuint, TextureLayer> &layers, TextureArrayReport &report){
+    struct Source {
+        GLuint id;
+        size_t bytes;                   // all levels
+    };
+    typedef tuple<GLint, GLint, GLint, GLint, GLint> Key;  // width, height, internal format, compressed, levels
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<GpuTexture> arrays;
+    report.textures = textureIDs.size();
+
+    // ordered, so a model packs the same way on every load
+    map<Key, vector<Source>> groups;
+    for(GLuint id : textureIDs){
+        GLint width = 0, height = 0, format = 0, compressed = GL_FALSE, maxLevel = 1000;
+        glBindTexture(GL_TEXTURE_2D, id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        if(width <= 0 || height <= 0 || (!compressed && textureArrayTexelSize(format) == 0))
+            continue;
+
+        // the levels the texture really has: up to MAX_LEVEL or the 1x1 level, whichever comes first
+        Source source{ id, 0 };
+        GLint levels = 0;
+        while(levels <= maxLevel){
+            GLint levelWidth = 0, levelHeight = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_WIDTH, &levelWidth);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_HEIGHT, &levelHeight);
+            if(levelWidth <= 0)
+                break;
+            GLint levelBytes = 0;
+            if(compressed)
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelBytes);
+            else
+                levelBytes = levelWidth * levelHeight * (GLint)textureArrayTexelSize(format);
+            source.bytes += (size_t)levelBytes;
+            levels++;
+            if(levelWidth == 1 && levelHeight == 1)
+                break;
+        }
+        groups[Key(width, height, format, compressed, levels)].push_back(source);
+    }
+
+    GLint maxLayers = 256;              // the GL 3.3 minimum
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    vector<unsigned char> staging;
+    for(const pair<const Key, vector<Source>> &group : groups){
+        GLint width, height, format, compressed, levels;
+        tie(width, height, format, compressed, levels) = group.first;
+        const vector<Source> &sources = group.second;
+
+        for(size_t first = 0; first < sources.size(); first += (size_t)maxLayers){
+            GLsizei layerCount = (GLsizei)min(sources.size() - first, (size_t)maxLayers);
+            if(layerCount < (GLsizei)max(textureArraySettings().minLayers, 2u))
+                break;
+
+            // level sizes of the first layer, equal for all of them by the group key
+            vector<GLint> levelBytes(levels);
+            glBindTexture(GL_TEXTURE_2D, sources[first].id);
+            for(GLint level = 0; level < levels; level++){
+                if(compressed)
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelBytes[level]);
+                else
+                    levelBytes[level] = max(width >> level, 1) * max(height >> level, 1) * 4;
+            }
+
+            GpuTexture array = GpuTexture::create();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.get());
+            for(GLint level = 0; level < levels; level++){
+                GLsizei levelWidth = max(width >> level, 1), levelHeight = max(height >> level, 1);
+                if(compressed)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, (GLenum)format, levelWidth, levelHeight, layerCount, 0, levelBytes[level] * layerCount, NULL);
+                else
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelWidth, levelHeight, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+
+            // what the array allocates: every compressed level once per layer, or its texels in the format the driver gave the array
+            GLint arrayFormat = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &arrayFormat);
+            size_t texelSize = textureArrayTexelSize(arrayFormat) > 0 ? textureArrayTexelSize(arrayFormat) : textureArrayTexelSize(format);
+            for(GLint level = 0; level < levels; level++){
+                if(compressed)
+                    report.arrayBytes += (size_t)levelBytes[level] * layerCount;
+                else
+                    report.arrayBytes += (size_t)max(width >> level, 1) * max(height >> level, 1) * texelSize * layerCount;
+            }
+
+            // read back each level of each source and write it into its layer, blocks and texels stay as they are
+            for(GLsizei layer = 0; layer < layerCount; layer++){
+                const Source &source = sources[first + layer];
+                for(GLint level = 0; level < levels; level++){
+                    GLsizei levelWidth = max(width >> level, 1), levelHeight = max(height >> level, 1);
+                    staging.resize((size_t)levelBytes[level]);
+                    glBindTexture(GL_TEXTURE_2D, source.id);
+                    if(compressed)
+                        glGetCompressedTexImage(GL_TEXTURE_2D, level, staging.data());
+                    else
+                        glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+                    if(compressed)
+                        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1, (GLenum)format, levelBytes[level], staging.data());
+                    else
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+                }
+                layers[source.id] = TextureLayer{ array.get(), (int)layer };
+                report.packed++;
+                report.packedBytes += source.bytes;
+            }
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            arrays.push_back(move(array));
+            report.arrays++;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    invalidateTextureBindings();
+    report.copyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return arrays;
+}
+
+void TextureArrayReport::print(const string &name) const{
+    cout << "TEXTURE::ARRAY_REPORT::" << name << endl
+         << "    textures: " << packed << " of " << textures << " in " << arrays << " arrays (" << copyMs << " ms)" << endl
+         << "    binds:    " << bindsBefore << " -> " << bindsAfter << " texture binds drawing the meshes in order" << endl
+         << "    memory:   " << arrayBytes / (1024.0 * 1024.0) << " MiB in arrays for " << packedBytes / (1024.0 * 1024.0) << " MiB of 2D textures ("
+         << (packedBytes > 0 ? ((double)arrayBytes / packedBytes - 1.0) * 100.0 : 0.0) << "% overhead)" << endl;
+}
+
+#endif /* TextureArray_h */
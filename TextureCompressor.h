@@ -0,0 +1,654 @@
+#ifndef TextureCompressor_h
+#define TextureCompressor_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// other library
+#include "stb_image.h"
+
+// own library
+#include "KtxFile.h"
+#include "MipGenerator.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+// standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// what a texture is sampled for, decides the block format and the filtering space
+enum TextureUsage {
+    TEXTURE_USAGE_COLOR,        // texture_diffuse
+    TEXTURE_USAGE_DATA,         // texture_specular, texture_height
+    TEXTURE_USAGE_NORMAL        // texture_normal, only x and y are stored, z = sqrt(1 - x*x - y*y)
+};
+
+enum TextureCodec {
+    TEXTURE_CODEC_NONE,
+    TEXTURE_CODEC_BC1,          // RGB, 4 bpp
+    TEXTURE_CODEC_BC3,          // RGBA, 8 bpp
+    TEXTURE_CODEC_BC4,          // R, 4 bpp
+    TEXTURE_CODEC_BC5,          // RG, 8 bpp
+    TEXTURE_CODEC_BC7           // RGBA (mode 6), 8 bpp, needs BPTC
+};
+
+struct TextureCompressionSettings {
+    bool useCompressed = true;      // upload an up-to-date <image>.ktx (block-compressed or a plain mip chain) instead of decoding the image
+    bool compressOnDemand = false;  // encode and write <image>.ktx for images that have none while loading
+    bool allowBC7 = false;          // RGBA images go to BC7 instead of BC3 when the driver supports BPTC
+};
+
+struct CompressedFormatSupport {
+    bool queried = false;
+    bool s3tc = false;              // BC1, BC3
+    bool rgtc = false;              // BC4, BC5 (core since 3.0)
+    bool bptc = false;              // BC7
+};
+
+// MARK: - Functions
+// -----------------
+TextureCompressionSettings& textureCompressionSettings();
+// GL thread, asks the driver on the first call
+const CompressedFormatSupport& queryCompressedFormatSupport();
+// any thread, everything is unsupported until queryCompressedFormatSupport ran on the GL thread
+const CompressedFormatSupport& compressedFormatSupport();
+bool isKtxSupported(const KtxImage &image);
+
+TextureUsage textureUsageFromType(const string &typeName);
+TextureCodec chooseTextureCodec(TextureUsage usage, int components, bool allowBC7);
+string compressedTexturePath(const string &sourcePath);
+bool isCompressedTextureFresh(const string &sourcePath);
+// settings a .ktx is built with, stored in its key/value data so that changing one of them rebuilds the file
+string textureBuildKey(TextureUsage usage, int components, TextureCodec codec);
+bool isTextureBuildCurrent(const KtxImage &image, TextureUsage usage);
+
+// encodes an 8-bit image and its mip chain (filtered by MipGenerator), blocks are spread over the shared pool
+bool compressImage(const unsigned char *pixels, int width, int height, int components, TextureCodec codec, KtxImage &image, bool srgb = false);
+// encodes every level of a plain 8-bit chain as produced by generateMipChain
+bool compressMipChain(const KtxImage &chain, TextureCodec codec, KtxImage &image);
+// offline entry point: decodes sourcePath and writes <sourcePath>.ktx
+bool compressTextureFile(const string &sourcePath, TextureUsage usage, bool allowBC7);
+
+// single 4x4 block encoders, rgba holds 16 pixels in row order
+void encodeBlockBC1(const unsigned char rgba[64], unsigned char block[8]);
+void encodeBlockBC3(const unsigned char rgba[64], unsigned char block[16]);
+void encodeBlockBC4(const unsigned char values[16], unsigned char block[8]);
+void encodeBlockBC5(const unsigned char rgba[64], unsigned char block[16]);
+void encodeBlockBC7(const unsigned char rgba[64], unsigned char block[16]);
+
+// MARK: - Function realization
+// --------------------
+TextureCompressionSettings& textureCompressionSettings(){
+    static TextureCompressionSettings settings;
+    return settings;
+}
+
+static CompressedFormatSupport& compressedFormatSupportStorage(){
+    static CompressedFormatSupport support;
+    return support;
+}
+
+const CompressedFormatSupport& queryCompressedFormatSupport(){
+    CompressedFormatSupport &support = compressedFormatSupportStorage();
+    if(support.queried)
+        return support;
+
+    GLint major = 0, minor = 0, extensionCount = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+
+    support.rgtc = major >= 3;
+    support.bptc = major > 4 || (major == 4 && minor >= 2);
+    for(GLint i = 0; i < extensionCount; i++){
+        const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(!extension)
+            continue;
+        if(strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+            support.s3tc = true;
+        else if(strcmp(extension, "GL_ARB_texture_compression_rgtc") == 0)
+            support.rgtc = true;
+        else if(strcmp(extension, "GL_ARB_texture_compression_bptc") == 0)
+            support.bptc = true;
+    }
+    support.queried = true;
+    return support;
+}
+
+const CompressedFormatSupport& compressedFormatSupport(){
+    return compressedFormatSupportStorage();
+}
+
+bool isKtxSupported(const KtxImage &image){
+    if(!image.isCompressed())
+        return true;
+    const CompressedFormatSupport &support = compressedFormatSupport();
+    switch(image.glInternalFormat){
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return support.s3tc;
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            return support.rgtc;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return support.bptc;
+        default:
+            return false;
+    }
+}
+
+TextureUsage textureUsageFromType(const string &typeName){
+    if(typeName == "texture_normal")
+        return TEXTURE_USAGE_NORMAL;
+    if(typeName == "texture_diffuse")
+        return TEXTURE_USAGE_COLOR;
+    return TEXTURE_USAGE_DATA;
+}
+
+TextureCodec chooseTextureCodec(TextureUsage usage, int components, bool allowBC7){
+    if(usage == TEXTURE_USAGE_NORMAL || components == 2)
+        return TEXTURE_CODEC_BC5;
+    if(components == 1)
+        return TEXTURE_CODEC_BC4;
+    if(components == 4)
+        return allowBC7 ? TEXTURE_CODEC_BC7 : TEXTURE_CODEC_BC3;
+    return TEXTURE_CODEC_BC1;
+}
+
+string compressedTexturePath(const string &sourcePath){
+    return sourcePath + ".ktx";
+}
+
+// a .ktx counts as up to date when it is not older than its source (or the source is gone)
+bool isCompressedTextureFresh(const string &sourcePath){
+    std::error_code error;
+    filesystem::path compressed = compressedTexturePath(sourcePath);
+    if(!filesystem::exists(compressed, error))
+        return false;
+    if(!filesystem::exists(sourcePath, error))
+        return true;
+    return filesystem::last_write_time(compressed, error) >= filesystem::last_write_time(sourcePath, error);
+}
+
+string textureBuildKey(TextureUsage usage, int components, TextureCodec codec){
+    return "usage=" + to_string(usage) + " components=" + to_string(components) + " codec=" + to_string(codec) +
+           " srgb=" + to_string(usage == TEXTURE_USAGE_COLOR) + " filter=" + to_string(mipGenerationSettings().filter);
+}
+
+// built for usage with the current filter, as a plain chain or with the codec the settings choose
+// a file without a key (or from an older build) never matches
+bool isTextureBuildCurrent(const KtxImage &image, TextureUsage usage){
+    int components = 0;
+    if(sscanf(image.buildKey.c_str(), "usage=%*d components=%d", &components) != 1)
+        return false;
+    if(!image.isCompressed())
+        return image.buildKey == textureBuildKey(usage, components, TEXTURE_CODEC_NONE);
+
+    const TextureCompressionSettings &settings = textureCompressionSettings();
+    bool allowBC7 = settings.allowBC7 && compressedFormatSupport().bptc;
+    if(image.buildKey == textureBuildKey(usage, components, chooseTextureCodec(usage, components, allowBC7)))
+        return true;
+    // the offline tool may have made the other BC7 choice, only rebuilt when this run encodes on demand
+    return !settings.compressOnDemand && image.buildKey == textureBuildKey(usage, components, chooseTextureCodec(usage, components, !allowBC7));
+}
+
+// MARK: - Block encoders
+// -----------------------
+static int packColor565(float r, float g, float b){
+    int r5 = (int)(clamp(r, 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    int g6 = (int)(clamp(g, 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+    int b5 = (int)(clamp(b, 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    return (r5 << 11) | (g6 << 5) | b5;
+}
+
+static void unpackColor565(int color, float rgb[3]){
+    int r5 = (color >> 11) & 31, g6 = (color >> 5) & 63, b5 = color & 31;
+    rgb[0] = (float)((r5 << 3) | (r5 >> 2));
+    rgb[1] = (float)((g6 << 2) | (g6 >> 4));
+    rgb[2] = (float)((b5 << 3) | (b5 >> 2));
+}
+
+// principal axis of up to four channels (stored as 16-wide planes) by power iteration, returns false for flat blocks
+static bool principalAxis(const float *const planes[], int channelCount, float mean[4], float axis[4]){
+    const Float4 sixteenth = Float4::splat(1.0f / 16.0f);
+    Float4 centered[4][4];
+    for(int c = 0; c < channelCount; c++){
+        Float4 sum = Float4::load(planes[c]) + Float4::load(planes[c] + 4) + Float4::load(planes[c] + 8) + Float4::load(planes[c] + 12);
+        mean[c] = horizontalSum(sum * sixteenth);
+        Float4 m = Float4::splat(mean[c]);
+        for(int k = 0; k < 4; k++)
+            centered[c][k] = Float4::load(planes[c] + 4 * k) - m;
+    }
+
+    float covariance[4][4] = {};
+    float trace = 0.0f;
+    for(int i = 0; i < channelCount; i++){
+        for(int j = i; j < channelCount; j++){
+            Float4 sum = Float4::splat(0.0f);
+            for(int k = 0; k < 4; k++)
+                sum = sum + centered[i][k] * centered[j][k];
+            covariance[i][j] = covariance[j][i] = horizontalSum(sum);
+        }
+        trace += covariance[i][i];
+    }
+    if(trace < 1e-3f)
+        return false;
+
+    // start from the dominant diagonal direction, a few iterations are plenty for 16 points
+    for(int c = 0; c < 4; c++)
+        axis[c] = c < channelCount ? 1.0f : 0.0f;
+    for(int iteration = 0; iteration < 8; iteration++){
+        float next[4] = {};
+        float length = 0.0f;
+        for(int i = 0; i < channelCount; i++){
+            for(int j = 0; j < channelCount; j++)
+                next[i] += covariance[i][j] * axis[j];
+            length += next[i] * next[i];
+        }
+        if(length < 1e-12f)
+            break;
+        length = 1.0f / sqrt(length);
+        for(int i = 0; i < channelCount; i++)
+            axis[i] = next[i] * length;
+    }
+    return true;
+}
+
+// projects every pixel on the axis and returns the extreme parameters
+static void projectionRange(const float *const planes[], int channelCount, const float mean[4], const float axis[4], float &tMin, float &tMax){
+    Float4 low = Float4::splat(1e30f), high = Float4::splat(-1e30f);
+    for(int k = 0; k < 4; k++){
+        Float4 t = Float4::splat(0.0f);
+        for(int c = 0; c < channelCount; c++)
+            t = t + (Float4::load(planes[c] + 4 * k) - Float4::splat(mean[c])) * Float4::splat(axis[c]);
+        low = min4(low, t);
+        high = max4(high, t);
+    }
+    tMin = horizontalMin(low);
+    tMax = horizontalMax(high);
+}
+
+// nearest palette entry for each pixel, returns the summed squared error
+static float fitIndices(const float *const planes[], int channelCount, const float palette[][4], int paletteSize, int indices[16]){
+    float error = 0.0f;
+    for(int k = 0; k < 4; k++){
+        Float4 best = Float4::splat(1e30f), bestIndex = Float4::splat(0.0f);
+        for(int p = 0; p < paletteSize; p++){
+            Float4 distance = Float4::splat(0.0f);
+            for(int c = 0; c < channelCount; c++){
+                Float4 d = Float4::load(planes[c] + 4 * k) - Float4::splat(palette[p][c]);
+                distance = distance + d * d;
+            }
+            bestIndex = selectLess(distance, best, Float4::splat((float)p), bestIndex);
+            best = min4(distance, best);
+        }
+        float lanes[4];
+        bestIndex.store(lanes);
+        for(int i = 0; i < 4; i++)
+            indices[4 * k + i] = (int)lanes[i];
+        error += horizontalSum(best);
+    }
+    return error;
+}
+
+// least-squares endpoints for pixel ~= (1 - t) * e0 + t * e1 given the interpolation weight t of every pixel
+static bool refitEndpoints(const float *const planes[], int channelCount, const float t[16], float e0[4], float e1[4]){
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for(int i = 0; i < 16; i++){
+        float a = 1.0f - t[i], b = t[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(int c = 0; c < channelCount; c++){
+            ax[c] += a * planes[c][i];
+            bx[c] += b * planes[c][i];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if(fabs(determinant) < 1e-6f)
+        return false;
+    float inverse = 1.0f / determinant;
+    for(int c = 0; c < channelCount; c++){
+        e0[c] = clamp((bb * ax[c] - ab * bx[c]) * inverse, 0.0f, 255.0f);
+        e1[c] = clamp((aa * bx[c] - ab * ax[c]) * inverse, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// BC1 color block from 565 endpoints, always in 4-color mode
+static float evaluateBC1(const float *const planes[], int color0, int color1, int indices[16]){
+    float palette[4][4] = {};
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for(int c = 0; c < 3; c++){
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    return fitIndices(planes, 3, palette, 4, indices);
+}
+
+void encodeBlockBC1(const unsigned char rgba[64], unsigned char block[8]){
+    float r[16], g[16], b[16];
+    for(int i = 0; i < 16; i++){
+        r[i] = rgba[4 * i + 0];
+        g[i] = rgba[4 * i + 1];
+        b[i] = rgba[4 * i + 2];
+    }
+    const float *planes[3] = { r, g, b };
+
+    int color0, color1;
+    int indices[16] = {};
+    float mean[4], axis[4];
+    if(!principalAxis(planes, 3, mean, axis)){
+        color0 = color1 = packColor565(mean[0], mean[1], mean[2]);
+    }
+    else{
+        // extremes along the axis, inset by 1/16 of the range to reduce the error of the outer pixels
+        float tMin, tMax;
+        projectionRange(planes, 3, mean, axis, tMin, tMax);
+        float inset = (tMax - tMin) / 16.0f;
+        tMin += inset;
+        tMax -= inset;
+        color0 = packColor565(mean[0] + axis[0] * tMax, mean[1] + axis[1] * tMax, mean[2] + axis[2] * tMax);
+        color1 = packColor565(mean[0] + axis[0] * tMin, mean[1] + axis[1] * tMin, mean[2] + axis[2] * tMin);
+        float error = evaluateBC1(planes, color0, color1, indices);
+
+        // one least-squares refinement, kept only if it helps
+        static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        float t[16], e0[4], e1[4];
+        for(int i = 0; i < 16; i++)
+            t[i] = weights[indices[i]];
+        if(refitEndpoints(planes, 3, t, e0, e1)){
+            int refined0 = packColor565(e0[0], e0[1], e0[2]);
+            int refined1 = packColor565(e1[0], e1[1], e1[2]);
+            int refinedIndices[16];
+            if(evaluateBC1(planes, refined0, refined1, refinedIndices) < error){
+                color0 = refined0;
+                color1 = refined1;
+                memcpy(indices, refinedIndices, sizeof(indices));
+            }
+        }
+    }
+
+    // 4-color mode needs color0 > color1, equal endpoints must only use index 0
+    if(color0 < color1){
+        swap(color0, color1);
+        for(int i = 0; i < 16; i++)
+            indices[i] ^= 1;
+    }
+    else if(color0 == color1){
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for(int i = 0; i < 16; i++)
+        bits |= (uint32_t)indices[i] << (2 * i);
+    block[0] = (unsigned char)(color0 & 0xFF);
+    block[1] = (unsigned char)(color0 >> 8);
+    block[2] = (unsigned char)(color1 & 0xFF);
+    block[3] = (unsigned char)(color1 >> 8);
+    for(int i = 0; i < 4; i++)
+        block[4 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void encodeBlockBC4(const unsigned char values[16], unsigned char block[8]){
+    int low = 255, high = 0;
+    for(int i = 0; i < 16; i++){
+        low = min(low, (int)values[i]);
+        high = max(high, (int)values[i]);
+    }
+
+    // 8-value mode: index 0 = high, 1 = low, 2..7 step from high towards low in sevenths
+    uint64_t bits = 0;
+    if(high > low){
+        float scale = 7.0f / (float)(high - low);
+        for(int i = 0; i < 16; i++){
+            int step = (int)((high - values[i]) * scale + 0.5f);
+            int index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+            bits |= (uint64_t)index << (3 * i);
+        }
+    }
+    block[0] = (unsigned char)high;
+    block[1] = (unsigned char)low;
+    for(int i = 0; i < 6; i++)
+        block[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void encodeBlockBC3(const unsigned char rgba[64], unsigned char block[16]){
+    unsigned char alpha[16];
+    for(int i = 0; i < 16; i++)
+        alpha[i] = rgba[4 * i + 3];
+    encodeBlockBC4(alpha, block);
+    encodeBlockBC1(rgba, block + 8);
+}
+
+void encodeBlockBC5(const unsigned char rgba[64], unsigned char block[16]){
+    unsigned char red[16], green[16];
+    for(int i = 0; i < 16; i++){
+        red[i] = rgba[4 * i + 0];
+        green[i] = rgba[4 * i + 1];
+    }
+    encodeBlockBC4(red, block);
+    encodeBlockBC4(green, block + 8);
+}
+
+// BC7 mode 6: one subset, 7-bit RGBA endpoints with a shared p-bit each, 4-bit indices
+static void quantizeEndpointBC7(const float endpoint[4], int quantized[4], int &pBit){
+    float bestError = 1e30f;
+    for(int p = 0; p < 2; p++){
+        int candidate[4];
+        float error = 0.0f;
+        for(int c = 0; c < 4; c++){
+            candidate[c] = clamp((int)floor((endpoint[c] - p) / 2.0f + 0.5f), 0, 127);
+            float d = (float)(candidate[c] * 2 + p) - endpoint[c];
+            error += d * d;
+        }
+        if(error < bestError){
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static float evaluateBC7(const float *const planes[], const float e0[4], const float e1[4], int q0[4], int q1[4], int &p0, int &p1, int indices[16]){
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    quantizeEndpointBC7(e0, q0, p0);
+    quantizeEndpointBC7(e1, q1, p1);
+
+    float palette[16][4];
+    for(int c = 0; c < 4; c++){
+        int a = q0[c] * 2 + p0, b = q1[c] * 2 + p1;
+        for(int i = 0; i < 16; i++)
+            palette[i][c] = (float)(((64 - weights[i]) * a + weights[i] * b + 32) >> 6);
+    }
+    return fitIndices(planes, 4, palette, 16, indices);
+}
+
+void encodeBlockBC7(const unsigned char rgba[64], unsigned char block[16]){
+    float channels[4][16];
+    for(int i = 0; i < 16; i++)
+        for(int c = 0; c < 4; c++)
+            channels[c][i] = rgba[4 * i + c];
+    const float *planes[4] = { channels[0], channels[1], channels[2], channels[3] };
+
+    float mean[4], axis[4], e0[4], e1[4];
+    if(principalAxis(planes, 4, mean, axis)){
+        float tMin, tMax;
+        projectionRange(planes, 4, mean, axis, tMin, tMax);
+        for(int c = 0; c < 4; c++){
+            e0[c] = clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+            e1[c] = clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+        }
+    }
+    else{
+        memcpy(e0, mean, sizeof(e0));
+        memcpy(e1, mean, sizeof(e1));
+    }
+
+    int q0[4], q1[4], p0 = 0, p1 = 0, indices[16];
+    float error = evaluateBC7(planes, e0, e1, q0, q1, p0, p1, indices);
+
+    // one least-squares refinement, kept only if it helps
+    float t[16], r0[4], r1[4];
+    static const float weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for(int i = 0; i < 16; i++)
+        t[i] = weights[indices[i]] / 64.0f;
+    if(refitEndpoints(planes, 4, t, r0, r1)){
+        int rq0[4], rq1[4], rp0 = 0, rp1 = 0, refinedIndices[16];
+        if(evaluateBC7(planes, r0, r1, rq0, rq1, rp0, rp1, refinedIndices) < error){
+            memcpy(q0, rq0, sizeof(q0));
+            memcpy(q1, rq1, sizeof(q1));
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    // the anchor (first) index has an implicit zero top bit
+    if(indices[0] & 8){
+        for(int c = 0; c < 4; c++)
+            swap(q0[c], q1[c]);
+        swap(p0, p1);
+        for(int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(block, 0, 16);
+    int position = 0;
+    auto write = [block, &position](uint32_t value, int bitCount){
+        for(int i = 0; i < bitCount; i++, position++)
+            block[position >> 3] |= (unsigned char)(((value >> i) & 1) << (position & 7));
+    };
+    write(1 << 6, 7);                       // mode 6
+    for(int c = 0; c < 4; c++){
+        write(q0[c], 7);
+        write(q1[c], 7);
+    }
+    write(p0, 1);
+    write(p1, 1);
+    write(indices[0], 3);
+    for(int i = 1; i < 16; i++)
+        write(indices[i], 4);
+}
+
+// MARK: - Image encoder
+// ----------------------
+// expands one level of a plain mip chain (rows padded to 4 bytes) to RGBA the way GL would sample it (R, RG, RGB, RGBA)
+static vector<unsigned char> expandToRGBA(const unsigned char *pixels, int width, int height, int components, size_t rowPitch){
+    vector<unsigned char> rgba((size_t)width * height * 4);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            unsigned char *out = &rgba[((size_t)y * width + x) * 4];
+            const unsigned char *in = pixels + rowPitch * y + (size_t)x * components;
+            out[0] = in[0];
+            out[1] = components > 1 ? in[1] : 0;
+            out[2] = components > 2 ? in[2] : 0;
+            out[3] = components > 3 ? in[3] : 255;
+        }
+    }
+    return rgba;
+}
+
+static void encodeLevel(const vector<unsigned char> &rgba, int width, int height, TextureCodec codec, vector<unsigned char> &output){
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t blockSize = (codec == TEXTURE_CODEC_BC1 || codec == TEXTURE_CODEC_BC4) ? 8 : 16;
+    output.assign((size_t)blocksX * blocksY * blockSize, 0);
+
+    ThreadPool::shared().parallelFor((size_t)blocksY, [&](size_t begin, size_t end){
+        unsigned char pixels[64], values[16];
+        for(size_t by = begin; by < end; by++){
+            for(int bx = 0; bx < blocksX; bx++){
+                // gather the block, clamping at the right and bottom edges
+                for(int y = 0; y < 4; y++){
+                    int sy = min((int)by * 4 + y, height - 1);
+                    for(int x = 0; x < 4; x++){
+                        int sx = min(bx * 4 + x, width - 1);
+                        memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                    }
+                }
+                unsigned char *block = &output[((size_t)by * blocksX + bx) * blockSize];
+                switch(codec){
+                    case TEXTURE_CODEC_BC1: encodeBlockBC1(pixels, block); break;
+                    case TEXTURE_CODEC_BC3: encodeBlockBC3(pixels, block); break;
+                    case TEXTURE_CODEC_BC4:
+                        for(int i = 0; i < 16; i++)
+                            values[i] = pixels[4 * i];
+                        encodeBlockBC4(values, block);
+                        break;
+                    case TEXTURE_CODEC_BC5: encodeBlockBC5(pixels, block); break;
+                    case TEXTURE_CODEC_BC7: encodeBlockBC7(pixels, block); break;
+                    default: break;
+                }
+            }
+        }
+    });
+}
+
+bool compressImage(const unsigned char *pixels, int width, int height, int components, TextureCodec codec, KtxImage &image, bool srgb){
+    KtxImage chain;
+    return generateMipChain(pixels, width, height, components, mipGenerationSettings().filter, srgb, chain) && compressMipChain(chain, codec, image);
+}
+
+bool compressMipChain(const KtxImage &chain, TextureCodec codec, KtxImage &image){
+    int components = chain.componentCount();
+    if(chain.empty() || chain.isCompressed() || chain.glType != GL_UNSIGNED_BYTE || components == 0 || codec == TEXTURE_CODEC_NONE)
+        return false;
+
+    image = KtxImage();
+    image.glType = 0;
+    image.glTypeSize = 1;
+    image.glFormat = 0;
+    image.width = chain.width;
+    image.height = chain.height;
+    switch(codec){
+        case TEXTURE_CODEC_BC1: image.glInternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;  image.glBaseInternalFormat = GL_RGB;  break;
+        case TEXTURE_CODEC_BC3: image.glInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; image.glBaseInternalFormat = GL_RGBA; break;
+        case TEXTURE_CODEC_BC4: image.glInternalFormat = GL_COMPRESSED_RED_RGTC1;          image.glBaseInternalFormat = GL_RED;  break;
+        case TEXTURE_CODEC_BC5: image.glInternalFormat = GL_COMPRESSED_RG_RGTC2;           image.glBaseInternalFormat = GL_RG;   break;
+        case TEXTURE_CODEC_BC7: image.glInternalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;    image.glBaseInternalFormat = GL_RGBA; break;
+        default: return false;
+    }
+
+    for(size_t level = 0; level < chain.levels.size(); level++){
+        int width = (int)max(1u, chain.width >> level);
+        int height = (int)max(1u, chain.height >> level);
+        size_t rowPitch = mipRowPitch(width, components);
+        if(chain.levels[level].size() < rowPitch * height)
+            return false;
+        vector<unsigned char> rgba = expandToRGBA(chain.levels[level].data(), width, height, components, rowPitch);
+        image.levels.push_back(vector<unsigned char>());
+        encodeLevel(rgba, width, height, codec, image.levels.back());
+    }
+    return true;
+}
+
+bool compressTextureFile(const string &sourcePath, TextureUsage usage, bool allowBC7){
+    int width, height, components;
+    unsigned char *pixels = stbi_load(sourcePath.c_str(), &width, &height, &components, 0);
+    if(!pixels)
+        return false;
+
+    KtxImage image;
+    TextureCodec codec = chooseTextureCodec(usage, components, allowBC7);
+    bool compressed = compressImage(pixels, width, height, components, codec, image, usage == TEXTURE_USAGE_COLOR);
+    image.buildKey = textureBuildKey(usage, components, codec);
+    stbi_image_free(pixels);
+    return compressed && writeKtx(compressedTexturePath(sourcePath), image);
+}
+
+#endif /* TextureCompressor_h */
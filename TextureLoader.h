@@ -0,0 +1,241 @@
+#ifndef TextureLoader_h
+#define TextureLoader_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// other library
+#include "stb_image.h"
+
+// own library
+#include "Hash.h"
+#include "KtxFile.h"
+#include "MipGenerator.h"
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+// standard library
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// CPU staging copy of an image between decoding (any thread) and uploading (GL thread)
+struct DecodedImage {
+    string path;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char *pixels = nullptr;    // owned by stb_image, nullptr if decoding failed or a .ktx was used
+    KtxImage mipChain;                  // block-compressed or CPU-filtered mip chain, uploaded instead of pixels when present
+    uint64_t contentHash = 0;           // only filled in when requested from decodeImagesParallel
+    
+    bool valid() const { return pixels || !mipChain.empty(); }
+    size_t byteSize() const;
+};
+
+// timings of one batched texture load, decode runs on the pool and upload on the GL thread
+struct TextureLoadReport {
+    size_t textureCount = 0;
+    size_t failedCount = 0;
+    size_t preparedCount = 0;           // loaded from an up-to-date .ktx, neither decoded nor filtered
+    size_t decodedBytes = 0;
+    double decodeWallMs = 0.0;          // elapsed time of the whole parallel decode stage
+    double decodeThreadMs = 0.0;        // decode time summed over all threads
+    double uploadMs = 0.0;
+
+    void print(const string &name) const;
+};
+
+// MARK: - Functions
+// -----------------
+// thread-safe, never touches OpenGL: prefers an up-to-date <filename>.ktx, otherwise decodes the image, filters its mip chain
+// and writes it (block-compressed on demand) to <filename>.ktx for the next run
+bool decodeImage(const string &filename, DecodedImage &image, TextureUsage usage = TEXTURE_USAGE_COLOR);
+void freeImage(DecodedImage &image);
+// GL thread only, always returns a texture name (empty if the image failed to decode)
+// respecifies textureID instead of creating one when given, e.g. reloading an evicted texture under its old name
+unsigned int uploadImage(const DecodedImage &image, unsigned int textureID = 0);
+uint64_t hashImageContents(const DecodedImage &image);
+// decodes every file in parallel on the shared pool, the caller frees the images
+vector<DecodedImage> decodeImagesParallel(const vector<string> &filenames, const vector<TextureUsage> &usages, bool hashContents = false, TextureLoadReport *report = nullptr);
+// GL thread only, decode and upload of a single texture
+unsigned int loadTextureFile(const string &filename, TextureUsage usage = TEXTURE_USAGE_COLOR);
+
+// MARK: - Function realization
+// --------------------
+bool decodeImage(const string &filename, DecodedImage &image, TextureUsage usage){
+    image.path = filename;
+    const TextureCompressionSettings &settings = textureCompressionSettings();
+    const MipGenerationSettings &mipSettings = mipGenerationSettings();
+    const CompressedFormatSupport &support = compressedFormatSupport();
+
+    // 1. prepared chain next to the source, when it is newer than the source and was built with the current settings
+    bool prepared = false;              // such a .ktx exists, even if this driver cannot upload it
+    if((settings.useCompressed || mipSettings.persist) && isCompressedTextureFresh(filename) && readKtx(compressedTexturePath(filename), image.mipChain))
+        prepared = isTextureBuildCurrent(image.mipChain, usage);
+    if(settings.useCompressed && prepared && isKtxSupported(image.mipChain)){
+        image.width = (int)image.mipChain.width;
+        image.height = (int)image.mipChain.height;
+        image.components = image.mipChain.componentCount();
+
+        // a plain chain from an earlier run is encoded now that compression is wanted, no decode needed
+        if(settings.compressOnDemand && !image.mipChain.isCompressed()){
+            KtxImage compressed;
+            TextureCodec codec = chooseTextureCodec(usage, image.components, settings.allowBC7 && support.bptc);
+            if(compressMipChain(image.mipChain, codec, compressed)){
+                compressed.buildKey = textureBuildKey(usage, image.components, codec);
+                if(writeKtx(compressedTexturePath(filename), compressed) && isKtxSupported(compressed))
+                    image.mipChain = move(compressed);
+            }
+        }
+        return true;
+    }
+    image.mipChain = KtxImage();
+
+    // 2. the source image and its mip chain, filtered here on the worker instead of glGenerateMipmap on the GL thread
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if(!image.pixels)
+        return false;
+    if(mipSettings.enabled)
+        generateMipChain(image.pixels, image.width, image.height, image.components, mipSettings.filter, usage == TEXTURE_USAGE_COLOR, image.mipChain);
+
+    // 3. saved for the next run
+    if(settings.compressOnDemand){
+        KtxImage compressed;
+        TextureCodec codec = chooseTextureCodec(usage, image.components, settings.allowBC7 && support.bptc);
+        bool encoded = image.mipChain.empty() ? compressImage(image.pixels, image.width, image.height, image.components, codec, compressed, usage == TEXTURE_USAGE_COLOR)
+                                              : compressMipChain(image.mipChain, codec, compressed);
+        if(encoded){
+            compressed.buildKey = textureBuildKey(usage, image.components, codec);
+            writeKtx(compressedTexturePath(filename), compressed);
+            if(isKtxSupported(compressed))
+                image.mipChain = move(compressed);  // otherwise written for other machines, this driver keeps the plain chain
+        }
+    }
+    else if(mipSettings.persist && !image.mipChain.empty() && !prepared){     // never replace an up-to-date .ktx this driver cannot use
+        image.mipChain.buildKey = textureBuildKey(usage, image.components, TEXTURE_CODEC_NONE);
+        writeKtx(compressedTexturePath(filename), image.mipChain);
+    }
+    return true;
+}
+
+void freeImage(DecodedImage &image){
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.mipChain = KtxImage();
+}
+
+size_t DecodedImage::byteSize() const{
+    if(!mipChain.empty())
+        return mipChain.byteSize();
+    return (size_t)width * height * components * 4 / 3;     // base level plus mip chain
+}
+
+unsigned int uploadImage(const DecodedImage &image, unsigned int textureID){
+    if(!image.mipChain.empty())
+        return uploadKtx(image.mipChain, textureID);
+
+    if(textureID == 0)
+        glGenTextures(1, &textureID);
+
+    if (image.pixels)
+    {
+        GLenum format = GL_RGB;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 3)
+            format = GL_RGB;
+        else if (image.components == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        invalidateTextureBindings();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows of 1- and 3-channel images are not 4-byte aligned
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D);        // only when CPU mip generation is switched off
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    return textureID;
+}
+
+// 64-bit FNV-1a over the dimensions and pixels
+uint64_t hashImageContents(const DecodedImage &image){
+    int dimensions[3] = {image.width, image.height, image.components};
+    uint64_t hash = hashBytes(dimensions, sizeof(dimensions));
+    if(image.pixels)
+        hash = hashBytes(image.pixels, (size_t)image.width * image.height * image.components, hash);
+    else if(!image.mipChain.empty())
+        hash = hashBytes(image.mipChain.levels[0].data(), image.mipChain.levels[0].size(), hash);
+    return hash;
+}
+
+vector<DecodedImage> decodeImagesParallel(const vector<string> &filenames, const vector<TextureUsage> &usages, bool hashContents, TextureLoadReport *report){
+    typedef chrono::steady_clock Clock;
+    queryCompressedFormatSupport();     // on the GL thread, before any worker needs the answer
+    vector<DecodedImage> images(filenames.size());
+    vector<double> decodeMs(filenames.size(), 0.0);
+
+    // one image per chunk since file sizes vary a lot
+    Clock::time_point decodeStart = Clock::now();
+    ThreadPool::shared().parallelFor(filenames.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            Clock::time_point start = Clock::now();
+            TextureUsage usage = i < usages.size() ? usages[i] : TEXTURE_USAGE_COLOR;
+            if(decodeImage(filenames[i], images[i], usage) && hashContents)
+                images[i].contentHash = hashImageContents(images[i]);
+            decodeMs[i] = chrono::duration<double, milli>(Clock::now() - start).count();
+        }
+    });
+
+    if(report){
+        report->textureCount += filenames.size();
+        report->decodeWallMs += chrono::duration<double, milli>(Clock::now() - decodeStart).count();
+        for(size_t i = 0; i < images.size(); i++){
+            report->decodeThreadMs += decodeMs[i];
+            if(images[i].pixels)
+                report->decodedBytes += (size_t)images[i].width * images[i].height * images[i].components;
+            else if(!images[i].mipChain.empty())
+                report->preparedCount++;
+            else
+                report->failedCount++;
+        }
+    }
+    return images;
+}
+
+unsigned int loadTextureFile(const string &filename, TextureUsage usage){
+    queryCompressedFormatSupport();
+
+    DecodedImage image;
+    decodeImage(filename, image, usage);
+    unsigned int textureID = uploadImage(image);
+    freeImage(image);
+    return textureID;
+}
+
+void TextureLoadReport::print(const string &name) const{
+    cout << "TEXTURE::LOAD_REPORT::" << name << endl
+         << "    textures: " << textureCount << " (" << preparedCount << " from .ktx, " << failedCount << " failed), " << decodedBytes / (1024.0 * 1024.0) << " MiB decoded" << endl
+         << "    decode:   " << decodeWallMs << " ms wall, " << decodeThreadMs << " ms summed over " << ThreadPool::shared().size() + 1 << " threads" << endl
+         << "    upload:   " << uploadMs << " ms" << endl;
+}
+
+#endif /* TextureLoader_h */
@@ -0,0 +1,234 @@
+#ifndef TextureRegistry_h
+#define TextureRegistry_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// own library
+#include "GpuResource.h"
+#include "ResidencyManager.h"
+#include "TextureLoader.h"
+
+// standard library
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Class
+// ------------------
+// process-wide, reference-counted cache of GL textures shared by every Model
+// keyed by normalized absolute path, optionally also by decoded content so identical images under different names share one texture
+// GL thread only
+class TextureRegistry {
+public:
+    // Properties
+    // ----------
+    bool contentDeduplication = false;  // hash decoded pixels and reuse an identical texture loaded under another path
+
+    // Functions
+    // ----------
+    static TextureRegistry& instance();
+    static string normalizePath(const string &path);
+
+    // returns true and takes a reference if the texture is resident, counts a hit or a miss
+    bool acquire(const string &normalizedPath, unsigned int &textureID);
+    // decodes every (missed) path in parallel and uploads them, each returned texture holds one reference
+    vector<unsigned int> loadBatch(const vector<string> &normalizedPaths, const vector<TextureUsage> &usages, TextureLoadReport *report = nullptr);
+    // drops one reference, the texture goes to the GpuDeletionQueue with the last one
+    void release(unsigned int textureID);
+    // marks the texture drawn this frame for the ResidencyManager, reloads it from its file if it was evicted
+    bool touch(unsigned int textureID);
+
+    size_t getHitCount() const { return hits; }
+    size_t getMissCount() const { return misses; }
+    size_t getResidentBytes() const { return residentBytes; }
+    size_t getTextureCount() const { return resources.size(); }
+    void printStatistics() const;
+
+private:
+    // Structure
+    // ----------
+    struct Resource {
+        GpuTexture texture;
+        unsigned int refCount;
+        size_t bytes;
+        uint64_t contentHash;           // 0 when content deduplication was off at load time
+        vector<string> paths;           // every path resolving to this texture
+        TextureUsage usage;             // to decode it the same way again
+        int width;
+        int height;
+        unsigned int residency;         // ResidencyManager id
+        bool evicted;
+    };
+
+    // Properties
+    // ----------
+    unordered_map<string, unsigned int> idByPath;
+    unordered_map<unsigned int, Resource> resources;
+    unordered_map<uint64_t, unsigned int> idByContent;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t contentHits = 0;
+    size_t residentBytes = 0;
+
+    TextureRegistry() {}
+    // frees the storage but keeps the name, so every Texture referencing it stays valid
+    void evict(unsigned int textureID);
+    bool reload(unsigned int textureID);
+};
+
+// MARK: - Function realization
+// --------------------
+TextureRegistry& TextureRegistry::instance(){
+    static TextureRegistry registry;
+    return registry;
+}
+
+string TextureRegistry::normalizePath(const string &path){
+    std::error_code error;
+    filesystem::path absolutePath = filesystem::absolute(filesystem::path(path), error);
+    if(error)
+        return filesystem::path(path).lexically_normal().generic_string();
+    return absolutePath.lexically_normal().generic_string();
+}
+
+bool TextureRegistry::acquire(const string &normalizedPath, unsigned int &textureID){
+    unordered_map<string, unsigned int>::const_iterator found = idByPath.find(normalizedPath);
+    if(found == idByPath.end()){
+        misses++;
+        return false;
+    }
+    hits++;
+    textureID = found->second;
+    resources[textureID].refCount++;
+    return true;
+}
+
+vector<unsigned int> TextureRegistry::loadBatch(const vector<string> &normalizedPaths, const vector<TextureUsage> &usages, TextureLoadReport *report){
+    vector<DecodedImage> images = decodeImagesParallel(normalizedPaths, usages, contentDeduplication, report);
+
+    chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+    vector<unsigned int> textureIDs(images.size());
+    for(size_t i = 0; i < images.size(); i++){
+        const DecodedImage &image = images[i];
+
+        // the same path twice in one batch, or another batch loaded it meanwhile
+        unordered_map<string, unsigned int>::const_iterator byPath = idByPath.find(normalizedPaths[i]);
+        if(byPath != idByPath.end()){
+            textureIDs[i] = byPath->second;
+            resources[textureIDs[i]].refCount++;
+            freeImage(images[i]);
+            continue;
+        }
+
+        // identical pixels already resident under another name
+        if(contentDeduplication && image.valid()){
+            unordered_map<uint64_t, unsigned int>::const_iterator byContent = idByContent.find(image.contentHash);
+            if(byContent != idByContent.end()){
+                textureIDs[i] = byContent->second;
+                Resource &resource = resources[textureIDs[i]];
+                resource.refCount++;
+                resource.paths.push_back(normalizedPaths[i]);
+                idByPath[normalizedPaths[i]] = textureIDs[i];
+                contentHits++;
+                freeImage(images[i]);
+                continue;
+            }
+        }
+
+        textureIDs[i] = uploadImage(image);
+
+        Resource resource;
+        resource.texture.reset(textureIDs[i]);
+        resource.refCount = 1;
+        resource.bytes = image.byteSize();
+        resource.contentHash = contentDeduplication && image.valid() ? image.contentHash : 0;
+        resource.paths.push_back(normalizedPaths[i]);
+        resource.usage = i < usages.size() ? usages[i] : TEXTURE_USAGE_COLOR;
+        resource.width = image.width;
+        resource.height = image.height;
+        resource.residency = 0;
+        resource.evicted = false;
+        if(image.valid()){
+            unsigned int textureID = textureIDs[i];
+            resource.residency = ResidencyManager::instance().track(RESIDENCY_TEXTURE, resource.bytes,
+                                                                     [this, textureID](){ evict(textureID); },
+                                                                     [this, textureID](){ return reload(textureID); });
+        }
+        if(resource.contentHash)
+            idByContent[resource.contentHash] = textureIDs[i];
+        idByPath[normalizedPaths[i]] = textureIDs[i];
+        residentBytes += resource.bytes;
+        resources[textureIDs[i]] = move(resource);
+
+        freeImage(images[i]);
+    }
+    if(report)
+        report->uploadMs += chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
+    return textureIDs;
+}
+
+void TextureRegistry::release(unsigned int textureID){
+    unordered_map<unsigned int, Resource>::iterator found = resources.find(textureID);
+    if(found == resources.end() || --found->second.refCount > 0)
+        return;
+
+    for(const string &path : found->second.paths)
+        idByPath.erase(path);
+    if(found->second.contentHash)
+        idByContent.erase(found->second.contentHash);
+    if(!found->second.evicted)
+        residentBytes -= found->second.bytes;
+    ResidencyManager::instance().untrack(found->second.residency);
+    resources.erase(found);
+}
+
+bool TextureRegistry::touch(unsigned int textureID){
+    unordered_map<unsigned int, Resource>::const_iterator found = resources.find(textureID);
+    return found == resources.end() || ResidencyManager::instance().touch(found->second.residency);
+}
+
+void TextureRegistry::evict(unsigned int textureID){
+    unordered_map<unsigned int, Resource>::iterator found = resources.find(textureID);
+    if(found == resources.end() || found->second.evicted)
+        return;
+    // zero-sized levels release the storage of a mutable texture, every level of the full chain is respecified
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for(int size = max(found->second.width, found->second.height), level = 0; size > 0; size >>= 1, level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    invalidateTextureBindings();
+    residentBytes -= found->second.bytes;
+    found->second.evicted = true;
+}
+
+bool TextureRegistry::reload(unsigned int textureID){
+    unordered_map<unsigned int, Resource>::iterator found = resources.find(textureID);
+    if(found == resources.end())
+        return false;
+    DecodedImage image;
+    bool decoded = decodeImage(found->second.paths[0], image, found->second.usage) && image.valid();
+    if(decoded){
+        uploadImage(image, textureID);
+        residentBytes += found->second.bytes;
+        found->second.evicted = false;
+    }
+    freeImage(image);
+    return decoded;
+}
+
+void TextureRegistry::printStatistics() const{
+    cout << "TEXTURE::REGISTRY" << endl
+         << "    resident: " << resources.size() << " textures, " << residentBytes / (1024.0 * 1024.0) << " MiB" << endl
+         << "    lookups:  " << hits << " hits, " << misses << " misses, " << contentHits << " content duplicates" << endl;
+}
+
+#endif /* TextureRegistry_h */
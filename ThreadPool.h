@@ -0,0 +1,184 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+// MARK: - Library
+// -----------------
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Class
+// ------------------
+// fixed-size pool of worker threads for CPU-side asset work (decoding, mesh processing ...)
+// never touch OpenGL from a task, the context only lives on the main thread
+class ThreadPool {
+public:
+    // Functions
+    // ----------
+    // threadCount 0 uses every hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // queues a task, the future carries its result (or exception)
+    template<class F>
+    auto submit(F task) -> future<decltype(task())>;
+
+    // splits [0, count) into contiguous chunks and blocks until body(begin, end) ran for all of them, the caller thread helps
+    void parallelFor(size_t count, const function<void(size_t begin, size_t end)> &body, size_t minChunk = 1);
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    // process-wide pool shared by the loaders
+    static ThreadPool& shared();
+
+private:
+    // Properties
+    // ----------
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex tasksMutex;
+    condition_variable tasksCondition;
+    bool stopping;
+
+    // Functions
+    // ----------
+    void workerLoop();
+    void wait(future<void> &result);
+    bool runPendingTask();
+};
+
+// MARK: - Function realization
+// --------------------
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false){
+    if(threadCount == 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+    for(unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksCondition.notify_all();
+    for(thread &worker : workers)
+        worker.join();
+}
+
+template<class F>
+auto ThreadPool::submit(F task) -> future<decltype(task())>{
+    typedef decltype(task()) Result;
+    auto packaged = make_shared<packaged_task<Result()>>(std::move(task));
+    future<Result> result = packaged->get_future();
+    {
+        lock_guard<mutex> lock(tasksMutex);
+        tasks.push([packaged](){ (*packaged)(); });
+    }
+    tasksCondition.notify_one();
+    return result;
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t begin, size_t end)> &body, size_t minChunk){
+    if(count == 0)
+        return;
+
+    // a few chunks per thread keeps the load balanced when items differ in cost
+    size_t chunkCount = min(count / max<size_t>(minChunk, 1), (size_t)(workers.size() + 1) * 4);
+    if(chunkCount <= 1){
+        body(0, count);
+        return;
+    }
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    // chunks are claimed through a shared counter, so the calling thread can work on them too
+    auto next = make_shared<atomic<size_t>>(0);
+    auto runChunks = [next, count, chunkSize, &body](){
+        for(size_t begin = next->fetch_add(chunkSize); begin < count; begin = next->fetch_add(chunkSize))
+            body(begin, min(begin + chunkSize, count));
+    };
+
+    vector<future<void>> helpers;
+    size_t helperCount = min((size_t)workers.size(), chunkCount - 1);
+    for(size_t i = 0; i < helperCount; i++)
+        helpers.push_back(submit(runChunks));
+
+    // the helpers use body until they return, so a throwing chunk (here or on a helper) is rethrown only after all of them finished
+    exception_ptr failure;
+    try{
+        runChunks();
+    }
+    catch(...){
+        failure = current_exception();
+        next->store(count);             // no more chunks are handed out
+    }
+    for(future<void> &helper : helpers){
+        try{
+            wait(helper);
+        }
+        catch(...){
+            if(!failure)
+                failure = current_exception();
+        }
+    }
+    if(failure)
+        rethrow_exception(failure);
+}
+
+void ThreadPool::wait(future<void> &result){
+    // keep draining the queue while waiting, so nested parallelFor calls from inside a task cannot starve the pool
+    while(result.wait_for(chrono::seconds(0)) != future_status::ready){
+        if(!runPendingTask())
+            this_thread::yield();
+    }
+    result.get();
+}
+
+bool ThreadPool::runPendingTask(){
+    function<void()> task;
+    {
+        lock_guard<mutex> lock(tasksMutex);
+        if(tasks.empty())
+            return false;
+        task = std::move(tasks.front());
+        tasks.pop();
+    }
+    task();
+    return true;
+}
+
+ThreadPool& ThreadPool::shared(){
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop(){
+    for(;;){
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(tasksMutex);
+            tasksCondition.wait(lock, [this](){ return stopping || !tasks.empty(); });
+            if(stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,49 @@
+// MARK: - Offline texture compressor
+// -----------------------------------
+// encodes images to BC1/BC3/BC4/BC5/BC7 with a full mip chain and writes <image>.ktx next to each of them,
+// the loaders pick these files up instead of decoding the source image.
+//
+// build (from the repository root):
+//     c++ -std=c++17 -O2 -pthread -I. Tools/CompressTextures.cpp stb_image.cpp glad.c -o CompressTextures
+// usage:
+//     CompressTextures [--normal | --data | --color] [--bc7] image...
+//     the usage flags apply to every image after them, --normal encodes BC5
+
+// own library
+#include "../TextureCompressor.h"
+
+// standard library
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    TextureUsage usage = TEXTURE_USAGE_COLOR;
+    bool allowBC7 = false;
+    int failed = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--normal") == 0)
+            usage = TEXTURE_USAGE_NORMAL;
+        else if(strcmp(argv[i], "--data") == 0)
+            usage = TEXTURE_USAGE_DATA;
+        else if(strcmp(argv[i], "--color") == 0)
+            usage = TEXTURE_USAGE_COLOR;
+        else if(strcmp(argv[i], "--bc7") == 0)
+            allowBC7 = true;
+        else{
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bool compressed = compressTextureFile(argv[i], usage, allowBC7);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if(compressed){
+                cout << compressedTexturePath(argv[i]) << " (" << ms << " ms)" << endl;
+            }
+            else{
+                cout << "ERROR::COMPRESS_TEXTURES::FAILED::" << argv[i] << endl;
+                failed++;
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
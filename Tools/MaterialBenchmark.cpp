@@ -0,0 +1,120 @@
+// MARK: - Material binding benchmark
+// -----------------------------------
+// CPU time per draw of getting a mesh's textures bound: the original Mesh::draw (type string compares, std::to_string names,
+// glGetUniformLocation and every unit rebound on every draw) against Material::bind, once with the draws of a material
+// consecutive (what the RenderQueue and the BatchRenderer produce) and once with the material changing on every draw.
+// No draw call is issued, only the binding is timed.
+//
+// build (from the repository root):
+//     c++ -std=c++17 -O2 -I. Tools/MaterialBenchmark.cpp glad.c -lglfw -o MaterialBenchmark
+// usage:
+//     MaterialBenchmark [draws] [materials]      run from the repository root, compiles Shaders/VertexShader.glsl + FragmentShader.glsl
+
+// OpenGL API
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+// own library
+#include "../Material.h"
+#include "../Shader.h"
+
+// standard library
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Mesh::draw before materials, texture part only
+void bindTexturesByName(const Shader &shader, const vector<Texture> &textures)
+{
+    unsigned int diffuseNr = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr = 1;
+    unsigned int heightNr = 1;
+    for(unsigned int i = 0; i < textures.size(); i++){
+        glActiveTexture(GL_TEXTURE0 + i);
+        string number;
+        string name = textures[i].type;
+        if(name == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if(name == "texture_specular")
+            number = std::to_string(specularNr++);
+        else if(name == "texture_normal")
+            number = std::to_string(normalNr++);
+        else if(name == "texture_height")
+            number = std::to_string(heightNr++);
+        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// draw d uses material (d / run) % materialCount
+template<typename Bind>
+double nanosecondsPerDraw(unsigned int draws, size_t materialCount, unsigned int run, Bind bind)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned int draw = 0; draw < draws; draw++)
+        bind((draw / run) % materialCount);
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / draws;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int draws = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000000;
+    size_t materialCount = argc > 2 ? (size_t)max(atoi(argv[2]), 1) : 16;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "MaterialBenchmark", NULL, NULL);
+    if(window == NULL || (glfwMakeContextCurrent(window), !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))){
+        cout << "ERROR::MATERIAL_BENCHMARK::NO_GL_CONTEXT" << endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    Shader shader("Shaders/VertexShader.glsl", "Shaders/FragmentShader.glsl");
+    shader.use();
+
+    // a diffuse and a specular 1x1 texture per material, colors differ so no two materials are equal
+    vector<shared_ptr<const Material>> materials;
+    vector<GLuint> textureIDs(materialCount * 2);
+    glGenTextures((GLsizei)textureIDs.size(), textureIDs.data());
+    for(size_t i = 0; i < materialCount; i++){
+        vector<Texture> textures(2);
+        for(size_t t = 0; t < 2; t++){
+            unsigned char pixel[4] = { (unsigned char)i, (unsigned char)t, 0, 255 };
+            glBindTexture(GL_TEXTURE_2D, textureIDs[i * 2 + t]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+            textures[t].id = textureIDs[i * 2 + t];
+            textures[t].type = t == 0 ? "texture_diffuse" : "texture_specular";
+        }
+        MaterialBlock constants;
+        constants.glossy = 8.0f + (float)i;
+        materials.push_back(MaterialLibrary::shared().acquire(textures, constants));
+    }
+    invalidateTextureBindings();
+
+    const unsigned int run = 64;        // draws per material in the sorted order, about a model's meshes of one material
+    double byName = nanosecondsPerDraw(draws, materialCount, run, [&](size_t m){ bindTexturesByName(shader, materials[m]->getTextures()); });
+    double sorted = nanosecondsPerDraw(draws, materialCount, run, [&](size_t m){ materials[m]->bind(shader); });
+    double alternating = nanosecondsPerDraw(draws, materialCount, 1, [&](size_t m){ materials[m]->bind(shader); });
+
+    cout << "MATERIAL::BENCHMARK_REPORT::" << draws << " draws, " << materialCount << " materials ("
+         << MaterialLibrary::shared().size() << " in the library)" << endl
+         << "    names + glGetUniformLocation:     " << byName << " ns/draw" << endl
+         << "    Material::bind, " << run << " draws per run: " << sorted << " ns/draw (" << (1.0 - sorted / byName) * 100.0 << "% saved)" << endl
+         << "    Material::bind, every draw new:   " << alternating << " ns/draw (" << (1.0 - alternating / byName) * 100.0 << "% saved)" << endl;
+
+    glDeleteTextures((GLsizei)textureIDs.size(), textureIDs.data());
+    glfwTerminate();
+    return 0;
+}
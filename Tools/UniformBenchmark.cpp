@@ -0,0 +1,173 @@
+// MARK: - Uniform update benchmark
+// ---------------------------------
+// CPU time of the cube shader's per-frame uniform updates (the 36 scene uniforms main.cpp set before the uniform blocks)
+// through glGetUniformLocation with std::string names (the old Shader), the Shader's string API, "name"_u IDs and
+// cached handles, against filling and uploading the PerFrame and Lights blocks that replaced them.
+//
+// build (from the repository root):
+//     c++ -std=c++17 -O2 -I. Tools/UniformBenchmark.cpp glad.c -lglfw -o UniformBenchmark
+// usage:
+//     UniformBenchmark [frames]      run from the repository root, compiles Shaders/VertexShader.glsl + FragmentShader.glsl
+
+// OpenGL API
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+// own library
+#include "../Shader.h"
+
+// standard library
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// every policy gets the compile-time ID and the plain name of each uniform and uses one of them
+struct StringLookup {
+    const Shader &shader;
+    void set(UniformID, const std::string &name, float value) const { glUniform1f(glGetUniformLocation(shader.ID, name.c_str()), value); }
+    void set(UniformID, const std::string &name, const glm::vec3 &value) const { glUniform3fv(glGetUniformLocation(shader.ID, name.c_str()), 1, glm::value_ptr(value)); }
+    void set(UniformID, const std::string &name, const glm::mat4 &value) const { glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value)); }
+};
+
+struct ShaderStringAPI {
+    const Shader &shader;
+    void set(UniformID, const std::string &name, float value) const { shader.setFloat(name, value); }
+    void set(UniformID, const std::string &name, const glm::vec3 &value) const { shader.setVec3(name, value); }
+    void set(UniformID, const std::string &name, const glm::mat4 &value) const { shader.setMat4(name, value); }
+};
+
+struct HashedIDs {
+    const Shader &shader;
+    void set(UniformID id, const char *, float value) const { shader.setFloat(id, value); }
+    void set(UniformID id, const char *, const glm::vec3 &value) const { shader.setVec3(id, value); }
+    void set(UniformID id, const char *, const glm::mat4 &value) const { shader.setMat4(id, value); }
+};
+
+// Uniform<T> handles resolved in the first frame through Shader::uniform, then only their set() calls
+template<typename T>
+struct HandleCache {
+    vector<Uniform<T>> handles;
+    size_t cursor = 0;
+    const Uniform<T>& next(const Shader &shader, UniformID id) {
+        if(cursor == handles.size())
+            handles.push_back(shader.uniform<T>(id));
+        return handles[cursor++];
+    }
+};
+
+struct CachedHandles {
+    const Shader &shader;
+    HandleCache<float> &floats;
+    HandleCache<glm::vec3> &vec3s;
+    HandleCache<glm::mat4> &mat4s;
+    void set(UniformID id, const char *, float value) const { floats.next(shader, id).set(value); }
+    void set(UniformID id, const char *, const glm::vec3 &value) const { vec3s.next(shader, id).set(value); }
+    void set(UniformID id, const char *, const glm::mat4 &value) const { mat4s.next(shader, id).set(value); }
+};
+
+#define SET(policy, name, value) policy.set(name##_u, name, value)
+
+template<typename Policy>
+void setSceneUniforms(const Policy &shader, const glm::vec3 &eye, const glm::vec3 &front, const glm::mat4 &projection, const glm::mat4 &view)
+{
+    glm::vec3 lightColor(1.0f), pointLightColor(0.2f, 0.3f, 0.8f);
+    SET(shader, "viewPos", eye);
+    SET(shader, "material.specular", glm::vec3(0.5f));
+    SET(shader, "material.glossy", 64.0f);
+    SET(shader, "dirLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
+    SET(shader, "dirLight.ambient", lightColor * 0.2f);
+    SET(shader, "dirLight.diffuse", lightColor * 0.5f);
+    SET(shader, "dirLight.specular", lightColor);
+    SET(shader, "pointLight.ambient", pointLightColor * 0.2f);
+    SET(shader, "pointLight.diffuse", pointLightColor * 0.5f);
+    SET(shader, "pointLight.specular", pointLightColor);
+    SET(shader, "pointLight.position", glm::vec3(1.2f, 1.0f, 2.0f));
+    SET(shader, "pointLight.constant", 1.0f);
+    SET(shader, "pointLight.linear", 0.09f);
+    SET(shader, "pointLight.quadratic", 0.032f);
+    SET(shader, "spotLight.position", eye);
+    SET(shader, "spotLight.spotDirection", front);
+    SET(shader, "spotLight.ambient", glm::vec3(0.0f));
+    SET(shader, "spotLight.diffuse", glm::vec3(1.0f));
+    SET(shader, "spotLight.specular", glm::vec3(1.0f));
+    SET(shader, "spotLight.constant", 1.0f);
+    SET(shader, "spotLight.linear", 0.09f);
+    SET(shader, "spotLight.quadratic", 0.032f);
+    SET(shader, "spotLight.cutOff", 0.976f);
+    SET(shader, "spotLight.outerCutOff", 0.966f);
+    SET(shader, "projection", projection);
+    SET(shader, "view", view);
+    // the per-object part of a frame with ten cubes and the root one
+    for(int i = 0; i < 5; i++){
+        SET(shader, "model", view);
+        SET(shader, "dirLight.ambient", lightColor * 0.2f);
+    }
+}
+
+template<typename MakePolicy>
+double microsecondsPerFrame(unsigned int frames, MakePolicy makePolicy)
+{
+    glm::mat4 projection(1.0f), view(1.0f);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned int frame = 0; frame < frames; frame++){
+        glm::vec3 eye(0.0f, 0.0f, 3.0f + frame * 1e-6f);
+        setSceneUniforms(makePolicy(), eye, glm::vec3(0.0f, 0.0f, -1.0f), projection, view);
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / frames;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : 20000;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "UniformBenchmark", NULL, NULL);
+    if(window == NULL || (glfwMakeContextCurrent(window), !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))){
+        cout << "ERROR::UNIFORM_BENCHMARK::NO_GL_CONTEXT" << endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    Shader shader("Shaders/VertexShader.glsl", "Shaders/FragmentShader.glsl");
+    shader.use();
+    HandleCache<float> floats;
+    HandleCache<glm::vec3> vec3s;
+    HandleCache<glm::mat4> mat4s;
+
+    double strings = microsecondsPerFrame(frames, [&](){ return StringLookup{ shader }; });
+    double stringAPI = microsecondsPerFrame(frames, [&](){ return ShaderStringAPI{ shader }; });
+    double hashed = microsecondsPerFrame(frames, [&](){ return HashedIDs{ shader }; });
+    double handles = microsecondsPerFrame(frames, [&](){
+        floats.cursor = vec3s.cursor = mat4s.cursor = 0;
+        return CachedHandles{ shader, floats, vec3s, mat4s };
+    });
+
+    UniformBlocks &blocks = UniformBlocks::shared();
+    blocks.lights.dirLightCount = blocks.lights.pointLightCount = blocks.lights.spotLightCount = 1;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned int frame = 0; frame < frames; frame++){
+        blocks.perFrame.viewPos = glm::vec3(0.0f, 0.0f, 3.0f + frame * 1e-6f);
+        blocks.lights.spotLights[0].position = blocks.perFrame.viewPos;
+        blocks.upload();
+    }
+    double uniformBlocks = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / frames;
+
+    cout << "UNIFORM::BENCHMARK_REPORT::" << frames << " frames, " << shader.getUniformCount() << " reflected uniforms" << endl
+         << "    glGetUniformLocation + string: " << strings << " us/frame" << endl
+         << "    Shader string API (hashed):    " << stringAPI << " us/frame" << endl
+         << "    \"name\"_u IDs:                  " << hashed << " us/frame (" << (1.0 - hashed / strings) * 100.0 << "% saved)" << endl
+         << "    cached handles:                " << handles << " us/frame (" << (1.0 - handles / strings) * 100.0 << "% saved)" << endl
+         << "    uniform blocks, one upload:    " << uniformBlocks << " us/frame (" << (1.0 - uniformBlocks / strings) * 100.0 << "% saved)" << endl;
+
+    glfwTerminate();
+    return 0;
+}
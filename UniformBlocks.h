@@ -0,0 +1,212 @@
+#ifndef UniformBlocks_h
+#define UniformBlocks_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "GpuResource.h"
+
+// standard library
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// fixed binding points, Shader binds the blocks of every program to them by name after linking
+#define UNIFORM_BLOCK_PER_FRAME 0
+#define UNIFORM_BLOCK_LIGHTS 1
+#define UNIFORM_BLOCK_MATERIAL 2
+
+// array sizes of the Lights block, match FragmentShader.glsl
+#define MAX_DIR_LIGHTS 2
+#define MAX_POINT_LIGHTS 4
+#define MAX_SPOT_LIGHTS 2
+
+// C++ mirrors of the std140 blocks: vec3 + float share 16 bytes, every struct and array element is padded to 16
+struct PerFrameBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float time;                         // seconds since start
+};
+static_assert(sizeof(PerFrameBlock) == 144 && offsetof(PerFrameBlock, viewPos) == 128, "PerFrame must match its std140 layout");
+
+struct DirLightData {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+static_assert(sizeof(DirLightData) == 64 && offsetof(DirLightData, specular) == 48, "DirLight must match its std140 layout");
+
+struct PointLightData {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+static_assert(sizeof(PointLightData) == 64 && offsetof(PointLightData, quadratic) == 44, "PointLight must match its std140 layout");
+
+struct SpotLightData {
+    glm::vec3 position;
+    float cutOff;                       // cosines of the inner and outer cone angles
+    glm::vec3 spotDirection;
+    float outerCutOff;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+static_assert(sizeof(SpotLightData) == 80 && offsetof(SpotLightData, quadratic) == 76, "SpotLight must match its std140 layout");
+
+struct LightsBlock {
+    int32_t dirLightCount;
+    int32_t pointLightCount;
+    int32_t spotLightCount;
+    int32_t padding;
+    DirLightData dirLights[MAX_DIR_LIGHTS];
+    PointLightData pointLights[MAX_POINT_LIGHTS];
+    SpotLightData spotLights[MAX_SPOT_LIGHTS];
+};
+static_assert(offsetof(LightsBlock, dirLights) == 16 && offsetof(LightsBlock, pointLights) == 16 + 64 * MAX_DIR_LIGHTS
+              && offsetof(LightsBlock, spotLights) == 16 + 64 * (MAX_DIR_LIGHTS + MAX_POINT_LIGHTS)
+              && sizeof(LightsBlock) == 16 + 64 * (MAX_DIR_LIGHTS + MAX_POINT_LIGHTS) + 80 * MAX_SPOT_LIGHTS, "Lights must match its std140 layout");
+
+// the textures stay samplers (texture_diffuse1, texture_specular1), the block scales them
+// the layers pick the texture array layer instead when the model packed its textures (-1 samples the 2D texture), set by Material
+struct MaterialBlock {
+    glm::vec4 diffuseColor = glm::vec4(1.0f);
+    glm::vec4 specularColor = glm::vec4(1.0f);
+    float glossy = 32.0f;
+    float diffuseLayer = -1.0f;
+    float specularLayer = -1.0f;
+    float padding = 0.0f;
+};
+static_assert(sizeof(MaterialBlock) == 48 && offsetof(MaterialBlock, glossy) == 32 && offsetof(MaterialBlock, diffuseLayer) == 36,
+              "Material must match its std140 layout");
+
+// MARK: - Class
+// ------------------
+// the uniform buffers every program reads: PerFrame and Lights are filled by the frame and uploaded together
+// with one buffer upload, Material is rewritten only when a different one is set
+// GL thread only
+class UniformBlocks {
+public:
+    // Properties
+    // ----------
+    PerFrameBlock perFrame;
+    LightsBlock lights;
+
+    // Functions
+    // ----------
+    static UniformBlocks& shared();
+    // binding point of a block name (GL_INVALID_INDEX if it is not one of these) and the C++ size of its block
+    static GLuint bindingOf(const char *blockName);
+    static size_t sizeOf(GLuint binding);
+
+    // uploads perFrame and lights and binds them, once per frame before drawing
+    void upload();
+    void setMaterial(const MaterialBlock &material);
+
+private:
+    // Properties
+    // ----------
+    GpuBuffer frameBuffer;
+    GpuBuffer materialBuffer;
+    size_t lightsOffset = 0;            // PerFrame at 0, Lights at the first aligned offset after it
+    vector<unsigned char> staging;
+    MaterialBlock material;
+    bool materialValid = false;
+
+    UniformBlocks();
+};
+
+// MARK: - Function realization
+// --------------------
+UniformBlocks::UniformBlocks(){
+    memset((void*)&perFrame, 0, sizeof(perFrame));
+    memset((void*)&lights, 0, sizeof(lights));
+}
+
+UniformBlocks& UniformBlocks::shared(){
+    static UniformBlocks uniformBlocks;
+    return uniformBlocks;
+}
+
+GLuint UniformBlocks::bindingOf(const char *blockName){
+    if(strcmp(blockName, "PerFrame") == 0)
+        return UNIFORM_BLOCK_PER_FRAME;
+    if(strcmp(blockName, "Lights") == 0)
+        return UNIFORM_BLOCK_LIGHTS;
+    if(strcmp(blockName, "Material") == 0)
+        return UNIFORM_BLOCK_MATERIAL;
+    return GL_INVALID_INDEX;
+}
+
+size_t UniformBlocks::sizeOf(GLuint binding){
+    switch(binding){
+        case UNIFORM_BLOCK_PER_FRAME: return sizeof(PerFrameBlock);
+        case UNIFORM_BLOCK_LIGHTS: return sizeof(LightsBlock);
+        case UNIFORM_BLOCK_MATERIAL: return sizeof(MaterialBlock);
+        default: return 0;
+    }
+}
+
+void UniformBlocks::upload(){
+    if(!frameBuffer){
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = max(alignment, 1);
+        lightsOffset = (sizeof(PerFrameBlock) + alignment - 1) / alignment * alignment;
+        staging.assign(lightsOffset + sizeof(LightsBlock), 0);
+        frameBuffer = GpuBuffer::create();
+    }
+    memcpy(staging.data(), &perFrame, sizeof(perFrame));
+    memcpy(staging.data() + lightsOffset, &lights, sizeof(lights));
+
+    // new storage every frame (orphaning) like the InstanceBuffer, so the last frame's draws never stall it
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer.get());
+    glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_PER_FRAME, frameBuffer.get(), 0, sizeof(PerFrameBlock));
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS, frameBuffer.get(), lightsOffset, sizeof(LightsBlock));
+}
+
+void UniformBlocks::setMaterial(const MaterialBlock &newMaterial){
+    if(materialValid && memcmp(&material, &newMaterial, sizeof(MaterialBlock)) == 0)
+        return;
+    material = newMaterial;
+    materialValid = true;
+    if(!materialBuffer){
+        materialBuffer = GpuBuffer::create();
+        glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer.get());
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_MATERIAL, materialBuffer.get());
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer.get());
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialBlock), &material);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+#endif /* UniformBlocks_h */
@@ -0,0 +1,248 @@
+#ifndef VertexFormat_h
+#define VertexFormat_h
+
+// MARK: - Library
+// -----------------
+// OpenGL API
+#include "glad/glad.h"
+
+// glm library
+#include "glm/glm.hpp"
+
+// own library
+#include "VertexPacking.h"
+
+// standard library
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// per-mesh constants some attributes need while encoding (packed positions are relative to the mesh bounds)
+struct VertexEncodeContext {
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+};
+
+// type-erased handle of one VertexFormat, a single static instance per format so the pointer identifies the format
+struct VertexLayout {
+    GLsizei stride;
+    unsigned int attributeMask;         // bit per enabled attribute location
+    bool packed;                        // VertexShader.glsl has to decode it (packedVertex)
+    void (*setupAttributes)();          // enables and points every attribute at the bound GL_ARRAY_BUFFER
+};
+
+// compile-time description of one attribute, the concrete attributes below add encode(source, context, out)
+template<GLuint Location, typename ComponentType, GLint ComponentCount, GLenum GLType, GLboolean Normalized = GL_FALSE, bool Integer = false, bool Packed = false>
+struct VertexAttribute {
+    typedef ComponentType Component;
+    static constexpr GLuint location = Location;
+    static constexpr GLint components = ComponentCount;
+    static constexpr GLenum type = GLType;
+    static constexpr GLboolean normalized = Normalized;
+    static constexpr bool integer = Integer;            // glVertexAttribIPointer, read as ivec/uvec in GLSL
+    static constexpr bool packed = Packed;
+    static constexpr size_t size = sizeof(ComponentType) * ComponentCount;
+    static_assert(size % 4 == 0, "vertex attributes must keep 4-byte alignment");
+};
+
+constexpr unsigned int countVertexAttributeBits(unsigned int mask){
+    return mask ? (mask & 1u) + countVertexAttributeBits(mask >> 1) : 0;
+}
+
+// MARK: - Class
+// ------------------
+// a vertex layout generated from its attribute list: struct size, stride, offsets and the glVertexAttribPointer calls
+//   typedef VertexFormat<PositionAttribute, NormalAttribute> Format;
+//   Format::Vertex vertex;   vertex.get<NormalAttribute>()[2] = 1.0f;   Format::setupAttributes();
+template<typename... Attributes>
+class VertexFormat {
+public:
+    static_assert(sizeof...(Attributes) > 0, "a vertex format needs at least one attribute");
+
+    static constexpr size_t attributeCount = sizeof...(Attributes);
+    static constexpr size_t stride = (Attributes::size + ...);
+    static constexpr unsigned int attributeMask = ((1u << Attributes::location) | ...);
+    static constexpr bool packed = (Attributes::packed || ...);
+    static_assert(countVertexAttributeBits(attributeMask) == attributeCount, "two attributes share a location");
+
+    // byte offset of an attribute inside the vertex, a compile error if the format does not contain it
+    template<typename Attribute>
+    static constexpr size_t offsetOf();
+
+    struct Vertex {
+        typedef VertexFormat Format;
+        alignas(4) unsigned char bytes[stride];
+
+        template<typename Attribute>
+        typename Attribute::Component* get() { return (typename Attribute::Component*)(bytes + offsetOf<Attribute>()); }
+        template<typename Attribute>
+        const typename Attribute::Component* get() const { return (const typename Attribute::Component*)(bytes + offsetOf<Attribute>()); }
+    };
+    static_assert(sizeof(Vertex) == stride, "vertex struct must be tightly packed");
+
+    // enables every attribute of the format, or only the listed ones (e.g. a position-only pass over a shared buffer)
+    template<typename... Selected>
+    static void setupAttributes();
+    // fills one vertex from any source with the fields of Mesh's Vertex (Position, Normal, TexCoords, ...)
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &context, Vertex &vertex);
+    static const VertexLayout& layout();
+
+private:
+    template<typename Attribute>
+    static void setupAttribute();
+};
+
+// MARK: - Function realization
+// --------------------
+template<typename... Attributes>
+template<typename Attribute>
+constexpr size_t VertexFormat<Attributes...>::offsetOf(){
+    static_assert((is_same<Attribute, Attributes>::value || ...), "attribute is not part of this vertex format");
+    constexpr bool matches[] = { is_same<Attribute, Attributes>::value... };
+    constexpr size_t sizes[] = { Attributes::size... };
+    size_t offset = 0;
+    for(size_t i = 0; i < attributeCount && !matches[i]; i++)
+        offset += sizes[i];
+    return offset;
+}
+
+template<typename... Attributes>
+template<typename Attribute>
+void VertexFormat<Attributes...>::setupAttribute(){
+    glEnableVertexAttribArray(Attribute::location);
+    if(Attribute::integer)
+        glVertexAttribIPointer(Attribute::location, Attribute::components, Attribute::type, (GLsizei)stride, (void*)offsetOf<Attribute>());
+    else
+        glVertexAttribPointer(Attribute::location, Attribute::components, Attribute::type, Attribute::normalized, (GLsizei)stride, (void*)offsetOf<Attribute>());
+}
+
+template<typename... Attributes>
+template<typename... Selected>
+void VertexFormat<Attributes...>::setupAttributes(){
+    if constexpr(sizeof...(Selected) == 0)
+        (setupAttribute<Attributes>(), ...);
+    else
+        (setupAttribute<Selected>(), ...);
+}
+
+template<typename... Attributes>
+template<typename Source>
+void VertexFormat<Attributes...>::encode(const Source &source, const VertexEncodeContext &context, Vertex &vertex){
+    (Attributes::encode(source, context, vertex.template get<Attributes>()), ...);
+}
+
+template<typename... Attributes>
+const VertexLayout& VertexFormat<Attributes...>::layout(){
+    static const VertexLayout instance = { (GLsizei)stride, attributeMask, packed, &VertexFormat::setupAttributes<> };
+    return instance;
+}
+
+// MARK: - Attributes
+// -------------------
+// locations match VertexShader.glsl, the packed variants reuse them and are decoded there
+struct PositionAttribute : VertexAttribute<0, float, 3, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, &source.Position, size); }
+};
+
+struct NormalAttribute : VertexAttribute<1, float, 3, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, &source.Normal, size); }
+};
+
+struct TexCoordAttribute : VertexAttribute<2, float, 2, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, &source.TexCoords, size); }
+};
+
+struct TangentAttribute : VertexAttribute<3, float, 3, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, &source.Tangent, size); }
+};
+
+struct BitangentAttribute : VertexAttribute<4, float, 3, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, &source.Bitangent, size); }
+};
+
+struct BoneIDsAttribute : VertexAttribute<5, int32_t, 4, GL_INT, GL_FALSE, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, int32_t *out) {
+        for(int i = 0; i < 4; i++)
+            out[i] = source.m_Weights[i] > 0.0f ? source.m_BoneIDs[i] : 0;
+    }
+};
+
+struct BoneWeightsAttribute : VertexAttribute<6, float, 4, GL_FLOAT> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, float *out) { memcpy(out, source.m_Weights, size); }
+};
+
+// snorm16 inside the mesh bounds, w unused
+struct PackedPositionAttribute : VertexAttribute<0, int16_t, 4, GL_SHORT, GL_TRUE, false, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &context, int16_t *out) {
+        glm::vec3 normalized = (source.Position - context.positionOffset) / context.positionScale;
+        for(int i = 0; i < 3; i++)
+            out[i] = packSnorm16(normalized[i]);
+        out[3] = 0;
+    }
+};
+
+struct OctahedralNormalAttribute : VertexAttribute<1, int16_t, 2, GL_SHORT, GL_TRUE, false, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, int16_t *out) { packOctahedral(source.Normal, out); }
+};
+
+struct HalfTexCoordAttribute : VertexAttribute<2, uint16_t, 2, GL_HALF_FLOAT, GL_FALSE, false, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, uint16_t *out) {
+        uint32_t packed = glm::packHalf2x16(source.TexCoords);
+        memcpy(out, &packed, size);
+    }
+};
+
+struct TangentFrameAttribute : VertexAttribute<3, int16_t, 4, GL_SHORT, GL_TRUE, false, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, int16_t *out) { packTangentFrame(source.Normal, source.Tangent, source.Bitangent, out); }
+};
+
+// needs bone IDs below 256
+struct PackedBoneIDsAttribute : VertexAttribute<5, uint8_t, 4, GL_UNSIGNED_BYTE, GL_FALSE, true, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, uint8_t *out) {
+        for(int i = 0; i < 4; i++)
+            out[i] = source.m_Weights[i] > 0.0f ? (uint8_t)source.m_BoneIDs[i] : 0;
+    }
+};
+
+struct PackedBoneWeightsAttribute : VertexAttribute<6, uint8_t, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, true> {
+    template<typename Source>
+    static void encode(const Source &source, const VertexEncodeContext &, uint8_t *out) {
+        for(int i = 0; i < 4; i++)
+            out[i] = (uint8_t)round(clamp(source.m_Weights[i], 0.0f, 1.0f) * 255.0f);
+    }
+};
+
+// MARK: - Formats
+// ----------------
+typedef VertexFormat<PositionAttribute> PositionVertexFormat;                                                       // 12 bytes
+typedef VertexFormat<PositionAttribute, NormalAttribute, TexCoordAttribute> StaticVertexFormat;                     // 32 bytes
+typedef VertexFormat<PositionAttribute, NormalAttribute, TexCoordAttribute,
+                     TangentAttribute, BitangentAttribute> TangentVertexFormat;                                     // 56 bytes
+typedef VertexFormat<PositionAttribute, NormalAttribute, TexCoordAttribute,
+                     TangentAttribute, BitangentAttribute, BoneIDsAttribute, BoneWeightsAttribute> SkinnedVertexFormat;     // 88 bytes
+
+typedef VertexFormat<PackedPositionAttribute, OctahedralNormalAttribute, HalfTexCoordAttribute> PackedStaticVertexFormat;  // 16 bytes
+typedef VertexFormat<PackedPositionAttribute, OctahedralNormalAttribute, HalfTexCoordAttribute,
+                     TangentFrameAttribute> PackedTangentVertexFormat;                                              // 24 bytes
+typedef VertexFormat<PackedPositionAttribute, OctahedralNormalAttribute, HalfTexCoordAttribute,
+                     TangentFrameAttribute, PackedBoneIDsAttribute, PackedBoneWeightsAttribute> PackedSkinnedVertexFormat;  // 32 bytes
+
+#endif /* VertexFormat_h */
@@ -0,0 +1,115 @@
+#ifndef VertexPacking_h
+#define VertexPacking_h
+
+// MARK: - Library
+// -----------------
+// glm library
+#include "glm/glm.hpp"
+
+// standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// MARK: - Structure
+// ------------------
+// how a Mesh stores its vertices on the GPU, chosen per Model
+enum VertexEncoding {
+    VERTEX_ENCODING_FULL,       // struct Vertex as is, fp32 everywhere
+    VERTEX_ENCODING_PACKED      // quantized, the Packed*VertexFormat layouts in VertexFormat.h (encoded by Mesh::setupMeshAs)
+};
+
+// MARK: - Functions
+// -----------------
+int16_t packSnorm16(float value);
+// unit vector to two snorm16 values on the octahedron, decoded by decodeOctahedral in VertexShader.glsl
+void packOctahedral(const glm::vec3 &normal, int16_t encoded[2]);
+// normal, tangent and bitangent handedness as one snorm16 quaternion, w < 0 marks a mirrored bitangent
+void packTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent, int16_t encoded[4]);
+
+// MARK: - Function realization
+// --------------------
+int16_t packSnorm16(float value){
+    return (int16_t)round(clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+void packOctahedral(const glm::vec3 &normal, int16_t encoded[2]){
+    float sum = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+    if(sum == 0.0f){
+        encoded[0] = encoded[1] = 0;    // decodes to +z
+        return;
+    }
+    float x = normal.x / sum, y = normal.y / sum;
+    if(normal.z < 0.0f){
+        // fold the lower hemisphere over the diagonals
+        float foldedX = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = packSnorm16(x);
+    encoded[1] = packSnorm16(y);
+}
+
+void packTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent, int16_t encoded[4]){
+    // orthonormal frame, the tangent is Gram-Schmidt'ed against the normal
+    glm::vec3 n = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 t = tangent - n * glm::dot(n, tangent);
+    if(glm::length(t) < 1e-6f)
+        t = fabs(n.x) < 0.9f ? glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), n) : glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), n);
+    t = glm::normalize(t);
+    glm::vec3 b = glm::cross(n, t);
+    bool mirrored = glm::dot(b, bitangent) < 0.0f;
+
+    // rotation matrix with columns (t, b, n) to quaternion
+    float m[3][3] = { { t.x, t.y, t.z }, { b.x, b.y, b.z }, { n.x, n.y, n.z } };   // m[column][row]
+    float q[4];     // x, y, z, w
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    if(trace > 0.0f){
+        float s = sqrt(trace + 1.0f) * 2.0f;
+        q[3] = 0.25f * s;
+        q[0] = (m[1][2] - m[2][1]) / s;
+        q[1] = (m[2][0] - m[0][2]) / s;
+        q[2] = (m[0][1] - m[1][0]) / s;
+    }
+    else if(m[0][0] > m[1][1] && m[0][0] > m[2][2]){
+        float s = sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+        q[3] = (m[1][2] - m[2][1]) / s;
+        q[0] = 0.25f * s;
+        q[1] = (m[1][0] + m[0][1]) / s;
+        q[2] = (m[2][0] + m[0][2]) / s;
+    }
+    else if(m[1][1] > m[2][2]){
+        float s = sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+        q[3] = (m[2][0] - m[0][2]) / s;
+        q[0] = (m[1][0] + m[0][1]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (m[2][1] + m[1][2]) / s;
+    }
+    else{
+        float s = sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+        q[3] = (m[0][1] - m[1][0]) / s;
+        q[0] = (m[2][0] + m[0][2]) / s;
+        q[1] = (m[2][1] + m[1][2]) / s;
+        q[2] = 0.25f * s;
+    }
+
+    // q and -q are the same rotation: keep w positive and away from zero so its sign survives quantization
+    if(q[3] < 0.0f)
+        for(int i = 0; i < 4; i++)
+            q[i] = -q[i];
+    const float bias = 1.0f / 32767.0f;
+    if(q[3] < bias){
+        float scale = sqrt(1.0f - bias * bias) / sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+        q[0] *= scale;
+        q[1] *= scale;
+        q[2] *= scale;
+        q[3] = bias;
+    }
+    for(int i = 0; i < 4; i++)
+        encoded[i] = packSnorm16(mirrored ? -q[i] : q[i]);
+}
+
+#endif /* VertexPacking_h */
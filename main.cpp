@@ -11,13 +11,26 @@
 
 // own library
 #include "Shader.h"
+#include "BatchRenderer.h"
 #include "Camera.h"
+#include "GpuResource.h"
+#include "InstanceBuffer.h"
+#include "RenderQueue.h"
+#include "ResidencyManager.h"
+#include "SceneGraph.h"
+#include "ShaderPermutations.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
+#include "VertexFormat.h"
 
 // other library
 #include "stb_image.h"
 
 // standard library
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <numeric>
 
 // MARK: - function
 // ----------------------
@@ -25,8 +38,10 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 unsigned int loadTexture(const char* path);
+void buildCubeField(const SceneGraph& scene, const unsigned int* cubeNodes, unsigned int count, vector<InstanceData>& instances);
 
 // MARK: - settings
 // -----------------------
@@ -35,6 +50,7 @@ const unsigned int SCR_HEIGHT = 600;
 
 //get Shader from Shader Files
 const char* vertexShaderSource = "/Users/birdmito/University/OpenGL/OpenGL_test/OpenGL_test/Shaders/VertexShader.glsl";
+const char* batchVertexShaderSource = "/Users/birdmito/University/OpenGL/OpenGL_test/OpenGL_test/Shaders/BatchVertexShader.glsl";
 const char* fragmentShaderSource = "/Users/birdmito/University/OpenGL/OpenGL_test/OpenGL_test/Shaders/FragmentShader.glsl";
 const char* lightFragmentShaderSource = "/Users/birdmito/University/OpenGL/OpenGL_test/OpenGL_test/Shaders/LightFragmentShader.glsl";
 
@@ -54,6 +70,15 @@ bool rightButtonPressed = false;
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 glm::vec3 lightColor = glm::vec3(1.0f);
 
+//Cube field benchmark: I toggles instancing, B batching, O the sorted render queue, = and - scale the cube count by 10 (10 to 100000),
+//P switches the cube program between its lighting permutation and the generic one
+unsigned int cubeCount = 10;
+bool instancedCubes = true;
+bool batchedCubes = false;
+bool queuedCubes = false;
+bool specializedShaders = true;
+bool cubeFieldChanged = false;
+
 //MARK: - Main
 int main()
 {
@@ -85,6 +110,7 @@ int main()
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     
 
 
@@ -95,6 +121,10 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // multi-draw indirect is GL 4.3, past what glad loads
+    BatchRenderer::shared().initialize((GLADloadproc)glfwGetProcAddress);
+    // so are program binaries (4.1), the shaders below link from ShaderCache/ after the first launch
+    ProgramBinaryCache::shared().initialize((GLADloadproc)glfwGetProcAddress);
     
     // configure global opengl state
     // -----------------------------
@@ -108,8 +138,13 @@ int main()
     // MARK: - Vertex data
     // build and compile our shader program
     // ------------------------------------
-    Shader cubeShader(vertexShaderSource, fragmentShaderSource);
+    // the cube program per define set, compiled once the lights are known (TEXTURE below)
+    ShaderPermutations cubePermutations(vertexShaderSource, fragmentShaderSource);
     Shader lightShader(vertexShaderSource, lightFragmentShaderSource);
+    // the batched cubes read their transforms from a storage buffer, only compiled where the indirect path runs
+    unique_ptr<Shader> batchShader;
+    if (BatchRenderer::shared().isIndirect())
+        batchShader.reset(new Shader(batchVertexShaderSource, fragmentShaderSource));
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -170,6 +205,19 @@ int main()
     glm::vec3(-1.3f,  1.0f, -1.5f)
     };
 
+    // scene graph: the cubes and the light hang below one root, static nodes are computed once
+    SceneGraph scene;
+    unsigned int sceneRoot = scene.addNode(-1);
+    unsigned int cubeNodes[10];
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        float angle = 20.0f * i;
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), cubePositions[i]);
+        local = glm::rotate(local, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+        cubeNodes[i] = scene.addNode(sceneRoot, local);
+    }
+    unsigned int lightNode = scene.addNode(sceneRoot, glm::scale(glm::translate(glm::mat4(1.0f), lightPos), glm::vec3(0.2f)));   // a smaller cube
+
 #endif //VERTEX_DATA
     
 #ifndef BUFFER
@@ -183,24 +231,33 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    //texture coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // position, normal and texture coord attributes: 8 interleaved floats
+    static_assert(StaticVertexFormat::stride == 8 * sizeof(float), "cube vertices are laid out as StaticVertexFormat");
+    StaticVertexFormat::setupAttributes();
 
     unsigned int lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
     glBindVertexArray(lightCubeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // position attribute only, same buffer
+    StaticVertexFormat::setupAttributes<PositionAttribute>();
+
+    // per-instance model and normal matrices of the cube field on the cube VAO, filled before the attributes point at it
+    vector<InstanceData> cubeInstances;
+    scene.updateWorldMatrices();
+    buildCubeField(scene, cubeNodes, cubeCount, cubeInstances);
+    InstanceBuffer::shared().upload(cubeInstances.data(), cubeInstances.size());
+    glBindVertexArray(VAO);
+    InstanceBuffer::shared().setupAttributes();
+    glBindVertexArray(0);
+
+    // the same cube as a Mesh in the shared geometry buffers, what the BatchRenderer draws
+    vector<StaticVertexFormat::Vertex> cubeMeshVertices(36);
+    memcpy(cubeMeshVertices.data(), vertices, sizeof(vertices));
+    vector<unsigned int> cubeMeshIndices(36);
+    iota(cubeMeshIndices.begin(), cubeMeshIndices.end(), 0u);
+    Mesh cubeMesh(cubeMeshVertices, cubeMeshIndices, vector<Texture>());
     
 
 
@@ -214,13 +271,68 @@ int main()
 
     // shader configuration
     // --------------------
-    cubeShader.use();
-    cubeShader.setInt("material.diffuse", 0);
-    cubeShader.setInt("material.specular", 1);
+    if (batchShader)
+    {
+        batchShader->use();
+        batchShader->setInt("texture_diffuse1"_u, 0);
+        batchShader->setInt("texture_specular1"_u, 1);
+    }
+
+    // uniform blocks shared by every program: the material and the lights, only the spot light follows the camera
+    MaterialBlock material;
+    material.glossy = 64.0f;
+    UniformBlocks::shared().setMaterial(material);
+    // the batched and queued cubes bind it per draw, the maps also pick the cube's shader permutation
+    cubeMesh.textures = { Texture{ diffuseMap, "texture_diffuse", "" }, Texture{ specularMap, "texture_specular", "" } };
+    cubeMesh.setMaterial(material);
+
+    glm::vec3 pointLightColor = glm::vec3(0.2f, 0.3f, 0.8f);
+    LightsBlock& lights = UniformBlocks::shared().lights;
+    lights.dirLightCount = 1;
+    lights.dirLights[0].direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.dirLights[0].ambient = lightColor * 0.2f;
+    lights.dirLights[0].diffuse = lightColor * 0.5f;
+    lights.dirLights[0].specular = lightColor;
+
+    lights.pointLightCount = 1;
+    lights.pointLights[0].position = lightPos;
+    lights.pointLights[0].ambient = pointLightColor * 0.2f;
+    lights.pointLights[0].diffuse = pointLightColor * 0.5f;
+    lights.pointLights[0].specular = pointLightColor;
+    lights.pointLights[0].constant = 1.0f;
+    lights.pointLights[0].linear = 0.09f;
+    lights.pointLights[0].quadratic = 0.032f;
+
+    lights.spotLightCount = 1;
+    lights.spotLights[0].ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+    lights.spotLights[0].diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+    lights.spotLights[0].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    lights.spotLights[0].constant = 1.0f;
+    lights.spotLights[0].linear = 0.09f;
+    lights.spotLights[0].quadratic = 0.032f;
+    lights.spotLights[0].cutOff = glm::cos(glm::radians(12.5f));
+    lights.spotLights[0].outerCutOff = glm::cos(glm::radians(15.0f));
+
+    // no defines runs every light type up to its count in the Lights block and samples both maps,
+    // the lighting defines compile exactly these lights and the cube's maps in
+    ShaderDefines genericDefines;
+    ShaderDefines specializedDefines = ShaderPermutations::lightingDefines(lights, cubeMesh.material.get());
+    for (Shader* shader : { &cubePermutations.get(genericDefines), &cubePermutations.get(specializedDefines) })
+    {
+        shader->use();
+        shader->setInt("texture_diffuse1"_u, 0);
+        shader->setInt("texture_specular1"_u, 1);
+    }
+    ProgramBinaryCache::shared().printReport();
     
 
 #endif //TEXTURE
     
+    // frame report of the cube field, printed once a second
+    double reportStart = glfwGetTime();
+    double cpuSeconds = 0.0;
+    unsigned int reportFrames = 0;
+
     // MARK: - render loop
     // -------------------------------------------------------------------------------------------
     while (!glfwWindowShouldClose(window))
@@ -242,6 +354,8 @@ int main()
         // input
         // -----
         processInput(window);
+        double cpuStart = glfwGetTime();
+        unsigned int drawCalls = 0;
 
         // render
         // ------
@@ -255,102 +369,143 @@ int main()
         // bind specular map
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, specularMap);
+        invalidateTextureBindings();    // bound behind the materials' back
 
 
         // render objects
         // -------------------------------------------------------------------------------
-        // activate shader
-        cubeShader.use();
-        cubeShader.setVec3("viewPos", camera.Position);
-
-        // set material properties
-        cubeShader.setVec3("material.specular", glm::vec3(0.5f, 0.5f, 0.5f));
-        cubeShader.setFloat("material.glossy", 64.0f);
-
-        // set direction light properties
-        cubeShader.setVec3("dirLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-        cubeShader.setVec3("dirLight.ambient", lightColor * 0.2f);
-        cubeShader.setVec3("dirLight.diffuse", lightColor * 0.5f);
-        cubeShader.setVec3("dirLight.specular", lightColor);
-
-        // set point light properties
-        glm::vec3 pointLightColor = glm::vec3(0.2f, 0.3f, 0.8f);
-        cubeShader.setVec3("pointLight.ambient", pointLightColor * 0.2f);
-        cubeShader.setVec3("pointLight.diffuse", pointLightColor * 0.5f);
-        cubeShader.setVec3("pointLight.specular", pointLightColor);
-                
-        cubeShader.setVec3("pointLight.position", lightPos);
-        cubeShader.setFloat("pointLight.constant", 1.0f);
-        cubeShader.setFloat("pointLight.linear", 0.09f);
-        cubeShader.setFloat("pointLight.quadratic", 0.032f);
-        
-        // spotLight
-        cubeShader.setVec3("spotLight.position", camera.Position);
-        cubeShader.setVec3("spotLight.spotDirection", camera.Front);
-        
-        cubeShader.setVec3("spotLight.ambient", glm::vec3(0.0f, 0.0f, 0.0f));
-        cubeShader.setVec3("spotLight.diffuse", glm::vec3(1.0f, 1.0f, 1.0f));
-        cubeShader.setVec3("spotLight.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-        
-        cubeShader.setFloat("spotLight.constant", 1.0f);
-        cubeShader.setFloat("spotLight.linear", 0.09f);
-        cubeShader.setFloat("spotLight.quadratic", 0.032f);
-        
-        cubeShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        cubeShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-                
-        // pass projection matrix to shader
         glm::mat4 projection = glm::mat4(1.0f);
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        cubeShader.setMat4("projection", projection);
-                
-        // camera/view transformation
         glm::mat4 view = camera.getViewMatrix();
-        cubeShader.setMat4("view", view);
 
-        // model transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        cubeShader.setMat4("model", model);
+        // camera and lights for every program in one buffer upload
+        UniformBlocks& blocks = UniformBlocks::shared();
+        blocks.perFrame.view = view;
+        blocks.perFrame.projection = projection;
+        blocks.perFrame.viewPos = camera.Position;
+        blocks.perFrame.time = currentFrame;
+        blocks.lights.spotLights[0].position = camera.Position;
+        blocks.lights.spotLights[0].spotDirection = camera.Front;
+        blocks.upload();
+
+        // activate shader, its GPU time is measured while it is bound (other programs stop the measurement)
+        cubePermutations.beginFrame();
+        const ShaderDefines& cubeDefines = specializedShaders ? specializedDefines : genericDefines;
+        Shader& cubeShader = cubePermutations.use(cubeDefines);
+
+        // model transformation, only nodes moved since the last frame are recomputed
+        scene.updateWorldMatrices();
+        if (cubeFieldChanged)
+        {
+            buildCubeField(scene, cubeNodes, cubeCount, cubeInstances);
+            cubeFieldChanged = false;
+        }
+        cubeShader.setMat4("model"_u, scene.getWorldMatrix(sceneRoot));
+        cubeShader.setMat3("normalMatrix"_u, scene.getNormalMatrix(sceneRoot));
 
         glBindVertexArray(VAO);
-        for (unsigned int i = 0; i < 10; i++)
+        if (batchedCubes)
         {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            cubeShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            // every cube queued with its own record, then one multi-draw per bucket (one bucket here)
+            BatchRenderer& batch = BatchRenderer::shared();
+            batch.begin();
+            for (const InstanceData& cube : cubeInstances)
+                batch.addDraw(cubeMesh, batch.addRecord(cubeMesh, cube.model, cube.normalMatrix), 0, 36);
+            if (batchShader)
+            {
+                cubePermutations.stopTiming();
+                batchShader->use();
+            }
+            batch.flush(batchShader ? *batchShader : cubeShader);
+            cubePermutations.use(cubeDefines);
+            drawCalls += (unsigned int)batch.getStatistics().drawCalls;
+        }
+        else if (queuedCubes)
+        {
+            // every other cube is a lamp, submitted interleaved: the queue groups the two programs and draws each front to back
+            RenderQueue& queue = RenderQueue::shared();
+            queue.begin(camera.Position, camera.Front, 100.0f);
+            for (size_t i = 0; i < cubeInstances.size(); i++)
+            {
+                unsigned int transform = queue.addTransform(cubeInstances[i].model, cubeInstances[i].normalMatrix);
+                queue.submit(RENDER_PASS_OPAQUE, i % 2 ? lightShader : cubeShader, cubeMesh, transform, 0, 36);
+            }
+            // the queue switches between both programs, its draws are not part of the cube permutation's time
+            cubePermutations.stopTiming();
+            lightShader.use();
+            lightShader.setVec3("lightColor"_u, pointLightColor);
+            queue.flush();
+            cubePermutations.use(cubeDefines);
+            drawCalls += (unsigned int)queue.getStatistics().draws;
+        }
+        else if (instancedCubes)
+        {
+            // the whole field in one draw, the instance matrices are world matrices already (root included), so model is identity here
+            InstanceBuffer::shared().upload(cubeInstances.data(), cubeInstances.size());
+            cubeShader.setMat4("model"_u, glm::mat4(1.0f));
+            cubeShader.setMat3("normalMatrix"_u, glm::mat3(1.0f));
+            cubeShader.setBool("instanced"_u, true);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)cubeInstances.size());
+            cubeShader.setBool("instanced"_u, false);
+            drawCalls++;
+        }
+        else
+        {
+            for (const InstanceData& cube : cubeInstances)
+            {
+                // one draw per object with its world and normal matrix
+                cubeShader.setMat4("model"_u, cube.model);
+                cubeShader.setMat3("normalMatrix"_u, cube.normalMatrix);
+
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                drawCalls++;
+            }
         }
-
-//      // calculate normal matrix by model matrix
-//      glm::mat4 normalMatrix = glm::transpose(glm::inverse(model));
-//      cubeShader.setMat4("normalMatrix", normalMatrix);
                 
         // draw
+        cubeShader.setMat4("model"_u, scene.getWorldMatrix(sceneRoot));
+        cubeShader.setMat3("normalMatrix"_u, scene.getNormalMatrix(sceneRoot));
         glBindVertexArray(VAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        drawCalls++;
                 
         //Draw Light
         // -------------------------------------------------------------------------------
+        cubePermutations.endFrame();
         lightShader.use();
-        lightShader.setMat4("projection", projection);
-        lightShader.setMat4("view", view);
 
         // change the light's position values over time (can be done anywhere in the render loop actually, but try to do it at least before using the light source positions)
         //lightPos.x = 1.0f + sin(glfwGetTime()) * 2.0f;
         //lightPos.y = sin(glfwGetTime() / 2.0f) * 1.0f;
 
-        model = glm::translate(model, lightPos);
-        model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
-        lightShader.setMat4("model", model);
+        lightShader.setMat4("model"_u, scene.getWorldMatrix(lightNode));
+        lightShader.setMat3("normalMatrix"_u, scene.getNormalMatrix(lightNode));
 
-        lightShader.setVec3("lightColor", pointLightColor);
+        lightShader.setVec3("lightColor"_u, pointLightColor);
                 
         glBindVertexArray(lightCubeVAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        drawCalls++;
+
+        // CPU time of recording the frame against the cube count and draw calls
+        cpuSeconds += glfwGetTime() - cpuStart;
+        reportFrames++;
+        if (glfwGetTime() - reportStart >= 1.0)
+        {
+            cout << "RENDER::FRAME_REPORT::" << cubeCount << " cubes "
+                 << (batchedCubes ? (BatchRenderer::shared().isIndirect() ? "batched (indirect)" : "batched (fallback)") : queuedCubes ? "queued" : instancedCubes ? "instanced" : "individually") << ", "
+                 << drawCalls << " draw calls, " << cpuSeconds * 1000.0 / reportFrames << " ms CPU";
+            if (batchedCubes)
+                cout << " (" << BatchRenderer::shared().getStatistics().submitMs << " ms batch submission)";
+            else if (queuedCubes)
+                cout << " (" << RenderQueue::shared().getStatistics().sortMs << " ms sort, "
+                     << RenderQueue::shared().getStatistics().bindsAvoided << " binds avoided)";
+            cout << ", " << reportFrames / (glfwGetTime() - reportStart) << " fps" << endl;
+            cubePermutations.printReport(specializedShaders ? "cube (specialized)" : "cube (generic)");
+            reportStart = glfwGetTime();
+            cpuSeconds = 0.0;
+            reportFrames = 0;
+        }
         
         
 
@@ -358,6 +513,9 @@ int main()
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+        // GL objects released frames ago are no longer in flight
+        GpuDeletionQueue::instance().advanceFrame();
+        ResidencyManager::instance().advanceFrame();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -365,6 +523,7 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &VBO);
+    GpuDeletionQueue::instance().flush();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -445,45 +604,55 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.processMouseScroll(static_cast<float>(yoffset));
 }
 
+// glfw: single key presses of the cube field benchmark
+// ----------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_I)
+        instancedCubes = !instancedCubes;
+    else if (key == GLFW_KEY_B)
+        batchedCubes = !batchedCubes;
+    else if (key == GLFW_KEY_O)
+        queuedCubes = !queuedCubes;
+    else if (key == GLFW_KEY_P)
+        specializedShaders = !specializedShaders;
+    else if (key == GLFW_KEY_EQUAL && cubeCount < 100000)
+        cubeCount *= 10;
+    else if (key == GLFW_KEY_MINUS && cubeCount > 10)
+        cubeCount /= 10;
+    else
+        return;
+    cubeFieldChanged = true;
+}
+
 #endif //CALLBACK
 
 // utility function for loading a 2D texture from file
+// prefers an up-to-date precompressed <path>.ktx and falls back to decoding the image
 // ---------------------------------------------------
 unsigned int loadTexture(char const* path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    return loadTextureFile(path);
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+// the ten scene graph cubes, then a grid of count - 10 more cubes behind them
+// ---------------------------------------------------
+void buildCubeField(const SceneGraph& scene, const unsigned int* cubeNodes, unsigned int count, vector<InstanceData>& instances)
+{
+    instances.clear();
+    instances.reserve(count);
+    for (unsigned int i = 0; i < count && i < 10; i++)
+        instances.push_back(InstanceBuffer::makeInstance(scene.getWorldMatrix(cubeNodes[i])));
+
+    unsigned int side = (unsigned int)ceil(cbrt((double)max(count, 10u) - 10.0));
+    for (unsigned int i = 10; i < count; i++)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        unsigned int j = i - 10;
+        glm::vec3 position(2.0f * (j % side) - side, 2.0f * (j / side % side) - side, -20.0f - 2.0f * (j / (side * side)));
+        instances.push_back(InstanceBuffer::makeInstance(glm::translate(glm::mat4(1.0f), position)));
     }
-
-    return textureID;
 }
 
 // 材质修改：VAO/VBO、Texture、render loop、processInput、Shaders